@@ -0,0 +1,216 @@
+#include "bench_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <string>
+
+// Bench Utils: Helpers shared by the benchmark and soak tools (files, manager process, /proc readings)
+
+#define DATA_CHUNK (1024 * 1024)
+
+pid_t manager_pid = -1;
+static int fss_out_fd = -1;
+static char data_buffer[DATA_CHUNK];
+static bool data_ready = false;
+
+///// MAIN FUNCTIONS /////
+
+// Returns monotonic clock time in seconds
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Deterministic pseudo-random numbers (xorshift64), so every build gets the same trees
+uint64_t nextRandom(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Remove a directory tree (or a single file)
+void removeTree(const char* path) {
+    DIR* dir = opendir(path);
+    if (!dir) {
+        unlink(path);
+        return;
+    }
+
+    struct dirent* entry;
+    char child[PATH_MAX];
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        snprintf(child, PATH_MAX, "%s/%s", path, entry->d_name);
+        if (entry->d_type == DT_DIR) removeTree(child);
+        else unlink(child);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+// Create (or overwrite) a file of the given size with pseudo-random data
+bool writeFile(const char* path, long long size) {
+    if (!data_ready) {
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        for (size_t i = 0; i < sizeof(data_buffer); i++) data_buffer[i] = (char)nextRandom(&state);
+        data_ready = true;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    while (size > 0) {
+        size_t chunk = size < DATA_CHUNK ? (size_t)size : DATA_CHUNK;
+        if (write(fd, data_buffer, chunk) != (ssize_t)chunk) {
+            close(fd);
+            return false;
+        }
+        size -= chunk;
+    }
+    close(fd);
+    return true;
+}
+
+// Start the manager with a config file and connect to its output pipe
+bool startManager(const char* config_path, const char* log_path, int workers) {
+    // Stale pipes of a previous run would be opened before the manager recreates them
+    unlink("fss_in");
+    unlink("fss_out");
+
+    char workers_arg[16];
+    sprintf(workers_arg, "%d", workers);
+
+    manager_pid = fork();
+    if (manager_pid < 0) {
+        perror("fork");
+        return false;
+    }
+    if (manager_pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+        execl("./bin/fss_manager", "fss_manager", "-l", log_path, "-c", config_path, "-n", workers_arg, (char*)NULL);
+        perror("execl ./bin/fss_manager");
+        _exit(1);
+    }
+
+    // The manager blocks until the output pipe has a reader
+    for (int i = 0; i < 5000 && access("fss_out", F_OK) != 0; i++) usleep(1000);
+    fss_out_fd = open("fss_out", O_RDONLY);
+    if (fss_out_fd < 0) {
+        perror("fss_out");
+        return false;
+    }
+    fcntl(fss_out_fd, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+// Read the manager's console output until text was seen count times
+bool waitForOutput(const char* text, int count, double timeout_s) {
+    char buffer[4096];
+    std::string output;
+    double start = now();
+    int seen = 0;
+
+    while (seen < count) {
+        ssize_t bytes = fss_out_fd >= 0 ? read(fss_out_fd, buffer, sizeof(buffer)) : -1;
+        if (bytes > 0) {
+            output.append(buffer, bytes);
+
+            // Count complete lines only, keep the partial last line for the next read
+            size_t line_end;
+            while ((line_end = output.find('\n')) != std::string::npos) {
+                if (output.substr(0, line_end).find(text) != std::string::npos) seen++;
+                output.erase(0, line_end + 1);
+            }
+            continue;
+        }
+        if (now() - start > timeout_s) return false;
+        usleep(1000);
+    }
+    return true;
+}
+
+// Read and discard the manager's console output, so it never blocks on a full pipe
+void drainOutput() {
+    char buffer[4096];
+    while (fss_out_fd >= 0 && read(fss_out_fd, buffer, sizeof(buffer)) > 0) {}
+}
+
+// Send a command (ending with '\n') to the manager
+void sendCommand(const char* command) {
+    int fd = open("fss_in", O_WRONLY);
+    if (fd < 0) {
+        perror("fss_in");
+        return;
+    }
+    if (write(fd, command, strlen(command)) < 0) perror("write fss_in");
+    close(fd);
+}
+
+// Shut down the manager and wait for it
+void stopManager() {
+    sendCommand("shutdown\n");
+    int status;
+    while (waitpid(manager_pid, &status, WNOHANG) == 0) {
+        drainOutput();
+        usleep(10000);
+    }
+    close(fss_out_fd);
+    fss_out_fd = -1;
+    manager_pid = -1;
+}
+
+// CPU time of the manager and of its finished workers in seconds
+void readCpuTime(double* manager_s, double* workers_s) {
+    char path[64];
+    sprintf(path, "/proc/%d/stat", (int)manager_pid);
+    *manager_s = 0;
+    *workers_s = 0;
+
+    FILE* file = fopen(path, "r");
+    if (!file) return;
+    char line[1024];
+    if (fgets(line, sizeof(line), file)) {
+        // Fields after the command name (which may contain spaces): state is field 3, utime field 14
+        char* fields = strrchr(line, ')');
+        unsigned long long utime, stime;
+        long long cutime, cstime;
+        if (fields && sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %lld %lld",
+                             &utime, &stime, &cutime, &cstime) == 4) {
+            double ticks = (double)sysconf(_SC_CLK_TCK);
+            *manager_s = (utime + stime) / ticks;
+            *workers_s = (cutime + cstime) / ticks;
+        }
+    }
+    fclose(file);
+}
+
+// Read a "Vm...:  N kB" field of the manager's /proc/<pid>/status (e.g. "VmRSS")
+long readMemoryKb(const char* field) {
+    char path[64];
+    sprintf(path, "/proc/%d/status", (int)manager_pid);
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+
+    char line[256];
+    long value = 0;
+    size_t length = strlen(field);
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, field, length) == 0 && line[length] == ':') {
+            value = atol(line + length + 1);
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
\ No newline at end of file
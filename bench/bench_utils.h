@@ -0,0 +1,46 @@
+#ifndef BENCH_UTILS_H
+#define BENCH_UTILS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Bench Utils: Helpers shared by the benchmark and soak tools (files, manager process, /proc readings)
+// The tools run from the repository root, where the manager creates fss_in/fss_out and finds ./bin/worker
+
+// PID of the manager started by startManager() (-1 if not running)
+extern pid_t manager_pid;
+
+// Returns monotonic clock time in seconds
+double now();
+
+// Deterministic pseudo-random numbers (xorshift64), state must not be 0
+uint64_t nextRandom(uint64_t* state);
+
+// Remove a directory tree (or a single file)
+void removeTree(const char* path);
+
+// Create (or overwrite) a file of the given size with pseudo-random data
+bool writeFile(const char* path, long long size);
+
+// Start the manager with a config file and connect to its output pipe
+bool startManager(const char* config_path, const char* log_path, int workers);
+
+// Read the manager's console output until text was seen count times, returns false on timeout
+bool waitForOutput(const char* text, int count, double timeout_s);
+
+// Read and discard the manager's console output, so it never blocks on a full pipe
+void drainOutput();
+
+// Send a command (ending with '\n') to the manager
+void sendCommand(const char* command);
+
+// Shut down the manager and wait for it
+void stopManager();
+
+// CPU time of the manager and of its finished workers in seconds
+void readCpuTime(double* manager_s, double* workers_s);
+
+// Read a "Vm...:  N kB" field of the manager's /proc/<pid>/status (e.g. "VmRSS"), 0 if not found
+long readMemoryKb(const char* field);
+
+#endif // BENCH_UTILS_H
\ No newline at end of file
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "bench_utils.h"
+
+// fss_bench: Generates synthetic source trees, drives fss_manager and writes the results as JSON
+// Run from the repository root (the manager creates fss_in/fss_out there and starts ./bin/worker)
+//   ./bin/fss_bench [-d <work_dir>] [-o <results.json>] [-n <workers>] [-s <scenario>] [-e <events>] [-q]
+
+#define DEFAULT_WORK_DIR "/tmp/fss_bench"
+#define DEFAULT_WORKERS 5
+#define DEFAULT_EVENTS 200
+#define EVENT_FILE_SIZE 4096
+#define POLL_INTERVAL_US 1000           // How often targets are checked for the copied files
+#define SYNC_TIMEOUT_S 600              // Give up on a scenario after this long
+
+// A synthetic tree: pairs directories, each with files files (sizes between min_size and max_size)
+typedef struct {
+    const char* name;
+    const char* description;
+    int pairs;
+    int files;
+    long long min_size;
+    long long max_size;
+    bool nested;            // Each pair's source is a subdirectory of the previous one
+} scenario_t;
+
+// Scenarios (sizes for the quick run are divided by 10)
+static const scenario_t scenarios[] = {
+    {"small", "many small files",               1, 5000,       4096,       4096, false},
+    {"huge",  "few huge files",                 1,    4, 64LL << 20, 64LL << 20, false},
+    {"mixed", "small to large files",           4,  500,       1024,  1LL << 20, false},
+    {"deep",  "deep nesting, a pair per level", 32,  50,      16384,      16384, true},
+};
+
+// A generated pair
+typedef struct {
+    std::string source;
+    std::string target;
+    std::vector<long long> sizes;   // Size of f0, f1, ...
+} bench_pair;
+
+// Measurements of a scenario
+typedef struct {
+    int files;
+    long long bytes;
+    double full_sync_s;
+    double full_cpu_s;
+    double event_cpu_s;
+    double worker_cpu_s;
+    long peak_rss_kb;
+    long rss_kb;
+    std::vector<double> event_latency_ms;
+    bool timed_out;
+} bench_result;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+///// HELPER FUNCTIONS /////
+
+// Generate the source trees and empty targets of a scenario
+static bool generateTree(const scenario_t* scenario, const char* dir, bool quick, std::vector<bench_pair>* pairs) {
+    int files = quick ? std::max(1, scenario->files / 10) : scenario->files;
+    long long divisor = quick ? 10 : 1;
+
+    std::string source = std::string(dir) + "/src";
+    std::string target = std::string(dir) + "/trg";
+    for (int p = 0; p < scenario->pairs; p++) {
+        bench_pair pair;
+        if (scenario->nested) {
+            source += "/d" + std::to_string(p);
+            target += "/d" + std::to_string(p);
+        }
+        pair.source = scenario->nested ? source : source + "/p" + std::to_string(p);
+        pair.target = scenario->nested ? target : target + "/p" + std::to_string(p);
+
+        if (mkdir(pair.source.c_str(), 0755) < 0 || mkdir(pair.target.c_str(), 0755) < 0) {
+            perror("mkdir");
+            return false;
+        }
+
+        for (int f = 0; f < files; f++) {
+            long long range = (scenario->max_size - scenario->min_size) / divisor;
+            long long size = scenario->min_size / divisor + (range > 0 ? (long long)(nextRandom(&rng_state) % (range + 1)) : 0);
+            std::string path = pair.source + "/f" + std::to_string(f);
+            if (!writeFile(path.c_str(), size)) {
+                perror("write");
+                return false;
+            }
+            pair.sizes.push_back(size);
+        }
+        pairs->push_back(pair);
+    }
+    return true;
+}
+
+// Write the config file of the scenario's pairs
+static bool writeConfig(const char* dir, const std::vector<bench_pair>& pairs) {
+    std::string config = std::string(dir) + "/config";
+    FILE* file = fopen(config.c_str(), "w");
+    if (!file) {
+        perror("config");
+        return false;
+    }
+    for (const bench_pair& pair : pairs) {
+        fprintf(file, "%s %s\n", pair.source.c_str(), pair.target.c_str());
+    }
+    fclose(file);
+    return true;
+}
+
+// Check if every file of the pair has been copied with its full size
+static bool pairSynced(const bench_pair& pair, size_t* checked) {
+    char path[PATH_MAX];
+    struct stat st;
+    // Files already seen complete are not checked again
+    for (; *checked < pair.sizes.size(); (*checked)++) {
+        snprintf(path, PATH_MAX, "%s/f%zu", pair.target.c_str(), *checked);
+        if (stat(path, &st) < 0 || st.st_size != pair.sizes[*checked]) return false;
+    }
+    return true;
+}
+
+// Wait until the targets hold every source file, returns seconds waited or -1 on timeout
+static double waitForFullSync(const std::vector<bench_pair>& pairs, double start) {
+    std::vector<size_t> checked(pairs.size(), 0);
+    for (;;) {
+        bool synced = true;
+        for (size_t p = 0; p < pairs.size() && synced; p++) {
+            synced = pairSynced(pairs[p], &checked[p]);
+        }
+        if (synced) return now() - start;
+        if (now() - start > SYNC_TIMEOUT_S) return -1;
+
+        drainOutput();
+        usleep(POLL_INTERVAL_US);
+    }
+}
+
+// Write files one at a time into the first pair and time until each appears in the target
+static void measureEventLatency(const bench_pair& pair, int events, std::vector<double>* latencies) {
+    char source[PATH_MAX], target[PATH_MAX];
+    struct stat st;
+    for (int i = 0; i < events; i++) {
+        snprintf(source, PATH_MAX, "%s/event%d", pair.source.c_str(), i);
+        snprintf(target, PATH_MAX, "%s/event%d", pair.target.c_str(), i);
+
+        double start = now();
+        if (!writeFile(source, EVENT_FILE_SIZE)) break;
+        while (stat(target, &st) < 0 || st.st_size != EVENT_FILE_SIZE) {
+            if (now() - start > SYNC_TIMEOUT_S) return;
+            drainOutput();
+            usleep(100);
+        }
+        latencies->push_back((now() - start) * 1000);
+    }
+}
+
+// Value at the given percentile (0 - 100) of sorted values
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = (size_t)(p / 100 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Run one scenario
+static bool runScenario(const scenario_t* scenario, const char* work_dir, int workers, int events, bool quick,
+                        bench_result* result) {
+    std::string dir = std::string(work_dir) + "/" + scenario->name;
+    removeTree(dir.c_str());
+    if (mkdir(dir.c_str(), 0755) < 0 || mkdir((dir + "/src").c_str(), 0755) < 0 || mkdir((dir + "/trg").c_str(), 0755) < 0) {
+        perror("mkdir");
+        return false;
+    }
+
+    fprintf(stderr, "[%s] generating %s\n", scenario->name, scenario->description);
+    std::vector<bench_pair> pairs;
+    if (!generateTree(scenario, dir.c_str(), quick, &pairs)) return false;
+
+    result->files = 0;
+    result->bytes = 0;
+    for (const bench_pair& pair : pairs) {
+        result->files += (int)pair.sizes.size();
+        for (long long size : pair.sizes) result->bytes += size;
+    }
+
+    // Page cache is shared by both runs, flush the generated data so the sync reads from a settled state
+    sync();
+
+    fprintf(stderr, "[%s] full sync of %d files\n", scenario->name, result->files);
+    double start = now();
+    if (!writeConfig(dir.c_str(), pairs) ||
+        !startManager((dir + "/config").c_str(), (dir + "/manager.log").c_str(), workers)) return false;
+    result->full_sync_s = waitForFullSync(pairs, start);
+    result->timed_out = result->full_sync_s < 0;
+
+    double workers_s;
+    readCpuTime(&result->full_cpu_s, &workers_s);
+
+    if (!result->timed_out && events > 0) {
+        fprintf(stderr, "[%s] %d events\n", scenario->name, events);
+        measureEventLatency(pairs[0], events, &result->event_latency_ms);
+    }
+    readCpuTime(&result->event_cpu_s, &result->worker_cpu_s);
+    result->event_cpu_s -= result->full_cpu_s;
+    result->rss_kb = readMemoryKb("VmRSS");
+    result->peak_rss_kb = readMemoryKb("VmHWM");
+
+    stopManager();
+    removeTree(dir.c_str());
+    return true;
+}
+
+// Write the result of a scenario as a JSON object
+static void writeResult(FILE* out, const scenario_t* scenario, bench_result* result, bool last) {
+    std::vector<double>& latency = result->event_latency_ms;
+    std::sort(latency.begin(), latency.end());
+    double seconds = result->full_sync_s > 0 ? result->full_sync_s : 0;
+
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"name\": \"%s\",\n", scenario->name);
+    fprintf(out, "      \"pairs\": %d,\n", scenario->pairs);
+    fprintf(out, "      \"files\": %d,\n", result->files);
+    fprintf(out, "      \"bytes\": %lld,\n", result->bytes);
+    fprintf(out, "      \"timed_out\": %s,\n", result->timed_out ? "true" : "false");
+    fprintf(out, "      \"full_sync\": {\"seconds\": %.4f, \"mb_per_s\": %.2f, \"files_per_s\": %.1f},\n",
+            seconds,
+            seconds > 0 ? result->bytes / 1048576.0 / seconds : 0,
+            seconds > 0 ? result->files / seconds : 0);
+    fprintf(out, "      \"event_latency_ms\": {\"samples\": %zu, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+            latency.size(), percentile(latency, 50), percentile(latency, 90), percentile(latency, 99),
+            latency.empty() ? 0 : latency.back());
+    fprintf(out, "      \"manager\": {\"cpu_full_sync_s\": %.3f, \"cpu_events_s\": %.3f, \"rss_kb\": %ld, \"peak_rss_kb\": %ld},\n",
+            result->full_cpu_s, result->event_cpu_s, result->rss_kb, result->peak_rss_kb);
+    fprintf(out, "      \"workers\": {\"cpu_s\": %.3f}\n", result->worker_cpu_s);
+    fprintf(out, "    }%s\n", last ? "" : ",");
+}
+
+///// MAIN FUNCTION /////
+
+int main(int argc, char* argv[]) {
+    const char* work_dir = DEFAULT_WORK_DIR;
+    const char* output_path = NULL;
+    const char* only = NULL;
+    int workers = DEFAULT_WORKERS;
+    int events = DEFAULT_EVENTS;
+    bool quick = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:o:n:s:e:q")) != -1) {
+        switch (opt) {
+            case 'd': work_dir = optarg; break;
+            case 'o': output_path = optarg; break;
+            case 'n': workers = atoi(optarg); break;
+            case 's': only = optarg; break;
+            case 'e': events = atoi(optarg); break;
+            case 'q': quick = true; break;
+            default:
+                fprintf(stderr, "Usage: %s [-d <work_dir>] [-o <results.json>] [-n <workers>] [-s <scenario>] [-e <events>] [-q]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (access("./bin/fss_manager", X_OK) != 0 || access("./bin/worker", X_OK) != 0) {
+        fprintf(stderr, "Run from the repository root after building (make)\n");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    mkdir(work_dir, 0755);
+
+    // Run the scenarios first, results are written at the end
+    int count = sizeof(scenarios) / sizeof(scenarios[0]);
+    std::vector<const scenario_t*> selected;
+    for (int i = 0; i < count; i++) {
+        if (!only || strcmp(only, scenarios[i].name) == 0) selected.push_back(&scenarios[i]);
+    }
+    if (selected.empty()) {
+        fprintf(stderr, "Unknown scenario: %s\n", only);
+        return 1;
+    }
+
+    std::vector<bench_result> results(selected.size());
+    for (size_t i = 0; i < selected.size(); i++) {
+        if (!runScenario(selected[i], work_dir, workers, events, quick, &results[i])) {
+            if (manager_pid > 0) stopManager();
+            return 1;
+        }
+    }
+
+    FILE* out = output_path ? fopen(output_path, "w") : stdout;
+    if (!out) {
+        perror(output_path);
+        return 1;
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"timestamp\": %ld,\n", (long)time(NULL));
+    fprintf(out, "  \"work_dir\": \"%s\",\n", work_dir);
+    fprintf(out, "  \"workers\": %d,\n", workers);
+    fprintf(out, "  \"quick\": %s,\n", quick ? "true" : "false");
+    // Storage faults injected by the slowio shim, so results of slow-disk runs are not mistaken for normal ones
+    const char* preload = getenv("LD_PRELOAD");
+    if (preload && strstr(preload, "slowio")) {
+        const char* pattern = getenv("FSS_SLOWIO_PATTERN");
+        const char* latency = getenv("FSS_SLOWIO_LATENCY_US");
+        const char* jitter = getenv("FSS_SLOWIO_JITTER_US");
+        const char* bps = getenv("FSS_SLOWIO_BPS");
+        const char* error_rate = getenv("FSS_SLOWIO_ERROR_RATE");
+        fprintf(out, "  \"slowio\": {\"pattern\": \"%s\", \"latency_us\": %s, \"jitter_us\": %s, \"bps\": %s, \"error_rate\": %s},\n",
+                pattern ? pattern : "", latency ? latency : "0", jitter ? jitter : "0", bps ? bps : "0",
+                error_rate ? error_rate : "0");
+    }
+    fprintf(out, "  \"scenarios\": [\n");
+    for (size_t i = 0; i < selected.size(); i++) {
+        writeResult(out, selected[i], &results[i], i + 1 == selected.size());
+    }
+    fprintf(out, "  ]\n}\n");
+    if (output_path) fclose(out);
+    return 0;
+}
\ No newline at end of file
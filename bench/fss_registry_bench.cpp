@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "bench_utils.h"
+#include "../header/sync_database.h"
+
+// fss_registry_bench: Memory per pair and lookup cost of the pair registry (sync_database) at a large number of
+// pairs, next to the layout it replaced (unordered_map keyed by a std::string, strdup'd paths, formatted time)
+// Runs in-process on synthetic paths, no directories are created
+//   ./bin/fss_registry_bench [-n <pairs>] [-l <lookups>] [-o <results.json>]
+
+#define DEFAULT_PAIRS 1000000
+#define DEFAULT_LOOKUPS 1000000
+#define WATCH_SCANS 100                 // Lookups by watch of the old layout (each one scans every pair)
+
+// A pair as it was stored before the registry
+struct legacy_entry {
+    char* source_dir;
+    char* target_dir;
+    char last_sync_time[TIMESTAMP_SIZE];
+    int error_count;
+    int wd;
+    long long limit_bps;
+    long long limit_fps;
+    token_bucket fps_bucket;
+    long long throttled_ms;
+    int queued_tasks;
+    uint64_t collapse_task_id;
+    int rescan_count;
+    long long bytes_copied;
+    long long files_copied;
+    long long tasks_completed;
+    long long tasks_failed;
+    pair_latency* latency;
+};
+
+// Measurements of one layout
+typedef struct {
+    const char* name;
+    size_t heap_bytes;
+    double insert_s;
+    double lookup_ns;
+    double watch_lookup_ns;
+    double iterate_ns;      // Per pair
+} registry_result;
+
+///// HELPER FUNCTIONS /////
+
+// Bytes allocated with malloc (small allocations and mmap'd blocks)
+static size_t heapInUse() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// Source and target paths of pair i (typical depth and length of real trees)
+static void pairPaths(int i, char* source, char* target) {
+    sprintf(source, "/srv/data/tenant%04d/project%07d", i % 1000, i);
+    sprintf(target, "/backup/data/tenant%04d/project%07d", i % 1000, i);
+}
+
+// Build the old layout, look pairs up by source (find + operator[], as before) and by watch (a scan)
+static void runLegacy(const std::vector<std::string>& sources, const std::vector<int>& order, registry_result* result) {
+    char source[PATH_MAX], target[PATH_MAX];
+    size_t heap_start = heapInUse();
+    double start = now();
+    std::unordered_map<std::string, legacy_entry>* pairs = new std::unordered_map<std::string, legacy_entry>();
+    for (size_t i = 0; i < sources.size(); i++) {
+        pairPaths(i, source, target);
+        legacy_entry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.source_dir = strdup(source);
+        entry.target_dir = strdup(target);
+        strcpy(entry.last_sync_time, "Never");
+        entry.wd = i + 1;
+        (*pairs)[std::string(source)] = entry;
+    }
+    result->insert_s = now() - start;
+    result->heap_bytes = heapInUse() - heap_start;
+
+    long long found = 0;
+    start = now();
+    for (int index : order) {
+        const char* path = sources[index].c_str();
+        if (pairs->find(path) != pairs->end()) found += (*pairs)[path].wd;
+    }
+    result->lookup_ns = (now() - start) * 1e9 / order.size();
+
+    start = now();
+    for (int i = 0; i < WATCH_SCANS; i++) {
+        int wd = order[i] + 1;
+        for (auto& pair : *pairs) {
+            if (pair.second.wd == wd) {
+                found += pair.second.error_count;
+                break;
+            }
+        }
+    }
+    result->watch_lookup_ns = (now() - start) * 1e9 / WATCH_SCANS;
+
+    start = now();
+    for (auto& pair : *pairs) found += pair.second.queued_tasks;
+    result->iterate_ns = (now() - start) * 1e9 / sources.size();
+
+    for (auto& pair : *pairs) {
+        free(pair.second.source_dir);
+        free(pair.second.target_dir);
+    }
+    delete pairs;
+    if (found < 0) printf("%lld\n", found);    // Keep the loops
+}
+
+// Same with the registry
+static void runRegistry(const std::vector<std::string>& sources, const std::vector<int>& order, registry_result* result) {
+    char source[PATH_MAX], target[PATH_MAX];
+    size_t heap_start = heapInUse();
+    double start = now();
+    for (size_t i = 0; i < sources.size(); i++) {
+        pairPaths(i, source, target);
+        sync_info_entry* info = addSyncInfo(source, target);
+        if (info) setSyncWatch(info, i + 1);
+    }
+    result->insert_s = now() - start;
+    result->heap_bytes = heapInUse() - heap_start;
+
+    long long found = 0;
+    start = now();
+    for (int index : order) {
+        sync_info_entry* info = getSyncInfo(sources[index].c_str());
+        if (info) found += info->wd;
+    }
+    result->lookup_ns = (now() - start) * 1e9 / order.size();
+
+    start = now();
+    for (int index : order) {
+        sync_info_entry* info = getSyncInfoByWatch(index + 1);
+        if (info) found += info->error_count;
+    }
+    result->watch_lookup_ns = (now() - start) * 1e9 / order.size();
+
+    start = now();
+    for (const sync_info_entry& info : sync_info) found += info.queued_tasks;
+    result->iterate_ns = (now() - start) * 1e9 / sources.size();
+
+    cleanupAllSyncInfo();
+    if (found < 0) printf("%lld\n", found);
+}
+
+// Write the result of a layout as a JSON object
+static void writeResult(FILE* out, const registry_result* result, int pairs, bool last) {
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"name\": \"%s\",\n", result->name);
+    fprintf(out, "      \"heap_bytes\": %zu,\n", result->heap_bytes);
+    fprintf(out, "      \"bytes_per_pair\": %.1f,\n", (double)result->heap_bytes / pairs);
+    fprintf(out, "      \"insert_s\": %.3f,\n", result->insert_s);
+    fprintf(out, "      \"lookup_ns\": %.1f,\n", result->lookup_ns);
+    fprintf(out, "      \"watch_lookup_ns\": %.1f,\n", result->watch_lookup_ns);
+    fprintf(out, "      \"iterate_ns_per_pair\": %.2f\n", result->iterate_ns);
+    fprintf(out, "    }%s\n", last ? "" : ",");
+}
+
+///// MAIN FUNCTION /////
+
+int main(int argc, char* argv[]) {
+    const char* output_path = NULL;
+    int pairs = DEFAULT_PAIRS;
+    int lookups = DEFAULT_LOOKUPS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:l:o:")) != -1) {
+        switch (opt) {
+            case 'n': pairs = atoi(optarg); break;
+            case 'l': lookups = atoi(optarg); break;
+            case 'o': output_path = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n <pairs>] [-l <lookups>] [-o <results.json>]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (pairs <= WATCH_SCANS || lookups <= WATCH_SCANS) {
+        fprintf(stderr, "Pairs and lookups must be more than %d\n", WATCH_SCANS);
+        return 1;
+    }
+
+    // Paths and lookup order are made before measuring, so they are not counted
+    char source[PATH_MAX], target[PATH_MAX];
+    std::vector<std::string> sources(pairs);
+    for (int i = 0; i < pairs; i++) {
+        pairPaths(i, source, target);
+        sources[i] = source;
+    }
+    uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+    std::vector<int> order(lookups);
+    for (int i = 0; i < lookups; i++) order[i] = nextRandom(&rng_state) % pairs;
+
+    registry_result results[2];
+    memset(results, 0, sizeof(results));
+    results[0].name = "unordered_map";
+    results[1].name = "registry";
+    runLegacy(sources, order, &results[0]);
+    malloc_trim(0);
+    runRegistry(sources, order, &results[1]);
+
+    FILE* out = output_path ? fopen(output_path, "w") : stdout;
+    if (!out) {
+        perror(output_path);
+        return 1;
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"timestamp\": %ld,\n", (long)time(NULL));
+    fprintf(out, "  \"pairs\": %d,\n", pairs);
+    fprintf(out, "  \"lookups\": %d,\n", lookups);
+    fprintf(out, "  \"entry_size\": {\"unordered_map\": %zu, \"registry\": %zu},\n",
+            sizeof(legacy_entry), sizeof(sync_info_entry));
+    fprintf(out, "  \"layouts\": [\n");
+    writeResult(out, &results[0], pairs, false);
+    writeResult(out, &results[1], pairs, true);
+    fprintf(out, "  ]\n}\n");
+    if (output_path) fclose(out);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <signal.h>
+#include <limits.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include "bench_utils.h"
+
+// fss_soak: Hammers monitored directories with create/modify/delete/rename operations, then checks
+// that the targets converge to the sources and reports what was lost, the peak queue depth and memory
+// Run from the repository root:
+//   ./bin/fss_soak [-d <work_dir>] [-o <results.json>] [-p <pairs>] [-t <seconds>] [-j <concurrency>]
+//                  [-C <creates/s>] [-M <modifies/s>] [-D <deletes/s>] [-R <renames/s>]
+//                  [-s <min_size>] [-S <max_size>] [-f <max_files>] [-n <workers>] [-w <converge_timeout>]
+
+#define DEFAULT_WORK_DIR "/tmp/fss_soak"
+#define SAMPLE_INTERVAL_US 100000       // How often the manager's memory and queue depth are sampled
+
+// Operations of the generators
+enum soak_op { OP_CREATE, OP_MODIFY, OP_DELETE, OP_RENAME, OP_COUNT };
+static const char* op_names[OP_COUNT] = {"create", "modify", "delete", "rename"};
+
+// Soak options
+typedef struct {
+    const char* work_dir;
+    const char* output_path;
+    int pairs;
+    double duration_s;
+    int concurrency;
+    double rates[OP_COUNT];     // Operations per second of all generators together
+    long long min_size;
+    long long max_size;
+    int max_files;              // Files the generators keep at most (creates turn into modifies)
+    int workers;
+    double converge_timeout_s;
+} soak_options;
+
+// A load generator thread, it only touches the files it created itself
+typedef struct {
+    int id;
+    const soak_options* options;
+    const std::vector<std::string>* sources;
+    double end_time;
+    uint64_t random_state;
+    std::vector<std::string> files;     // Paths of the generator's live files
+    long long counts[OP_COUNT];
+    long long errors;
+    long long next_name;
+} soak_generator;
+
+// Differences between a source and its target
+typedef struct {
+    long long missing;      // In the source but not in the target
+    long long stale;        // In the target but no longer in the source
+    long long differing;    // In both, with different size or content
+} tree_diff;
+
+// Manager readings taken while the soak runs
+typedef struct {
+    long peak_rss_kb;
+    long long peak_queue_depth;
+    long long inotify_overflows;
+    long long tasks_enqueued;
+} manager_samples;
+
+///// HELPER FUNCTIONS /////
+
+// Random size between the limits
+static long long randomSize(soak_generator* generator) {
+    const soak_options* options = generator->options;
+    long long range = options->max_size - options->min_size;
+    return options->min_size + (range > 0 ? (long long)(nextRandom(&generator->random_state) % (range + 1)) : 0);
+}
+
+// New file name of a generator in a random source directory
+static std::string newFileName(soak_generator* generator) {
+    const std::vector<std::string>& sources = *generator->sources;
+    const std::string& dir = sources[nextRandom(&generator->random_state) % sources.size()];
+    return dir + "/g" + std::to_string(generator->id) + "_" + std::to_string(generator->next_name++);
+}
+
+// Pick the next operation, weighted by the configured rates
+static soak_op pickOperation(soak_generator* generator) {
+    const double* rates = generator->options->rates;
+    double total = 0;
+    for (int i = 0; i < OP_COUNT; i++) total += rates[i];
+
+    double point = (nextRandom(&generator->random_state) % 1000000) / 1000000.0 * total;
+    for (int i = 0; i < OP_COUNT; i++) {
+        if (point < rates[i]) return (soak_op)i;
+        point -= rates[i];
+    }
+    return OP_CREATE;
+}
+
+// Perform one operation
+static void runOperation(soak_generator* generator, soak_op op) {
+    int file_limit = generator->options->max_files / generator->options->concurrency;
+    if (op != OP_CREATE && generator->files.empty()) op = OP_CREATE;
+    if (op == OP_CREATE && (int)generator->files.size() >= std::max(1, file_limit)) op = OP_MODIFY;
+
+    size_t index = generator->files.empty() ? 0 : nextRandom(&generator->random_state) % generator->files.size();
+    bool ok = true;
+    switch (op) {
+        case OP_CREATE: {
+            std::string path = newFileName(generator);
+            ok = writeFile(path.c_str(), randomSize(generator));
+            if (ok) generator->files.push_back(path);
+            break;
+        }
+        case OP_MODIFY:
+            ok = writeFile(generator->files[index].c_str(), randomSize(generator));
+            break;
+        case OP_DELETE:
+            ok = unlink(generator->files[index].c_str()) == 0;
+            generator->files[index] = generator->files.back();
+            generator->files.pop_back();
+            break;
+        case OP_RENAME: {
+            // Rename within the same directory
+            std::string& old_path = generator->files[index];
+            std::string new_path = old_path.substr(0, old_path.rfind('/')) + "/g" +
+                                   std::to_string(generator->id) + "_" + std::to_string(generator->next_name++);
+            ok = rename(old_path.c_str(), new_path.c_str()) == 0;
+            if (ok) old_path = new_path;
+            break;
+        }
+        default:
+            break;
+    }
+
+    generator->counts[op]++;
+    if (!ok) generator->errors++;
+}
+
+// Generator thread: performs operations at its share of the configured rates until the end time
+static void* generatorThread(void* arg) {
+    soak_generator* generator = (soak_generator*)arg;
+    const soak_options* options = generator->options;
+
+    double total_rate = 0;
+    for (int i = 0; i < OP_COUNT; i++) total_rate += options->rates[i];
+    double interval = options->concurrency / total_rate;
+
+    double next = now();
+    while (next < generator->end_time) {
+        runOperation(generator, pickOperation(generator));
+
+        // Keep the schedule, if the generator falls behind it catches up without sleeping
+        next += interval;
+        double wait = next - now();
+        if (wait > 0) usleep((useconds_t)(wait * 1e6));
+    }
+    return NULL;
+}
+
+// Check if two files have the same content
+static bool sameContent(const char* path_a, const char* path_b) {
+    int fd_a = open(path_a, O_RDONLY);
+    int fd_b = open(path_b, O_RDONLY);
+    bool same = fd_a >= 0 && fd_b >= 0;
+
+    char buffer_a[65536], buffer_b[65536];
+    while (same) {
+        ssize_t bytes_a = read(fd_a, buffer_a, sizeof(buffer_a));
+        ssize_t bytes_b = read(fd_b, buffer_b, sizeof(buffer_b));
+        if (bytes_a != bytes_b || bytes_a < 0 || memcmp(buffer_a, buffer_b, bytes_a) != 0) same = false;
+        if (bytes_a <= 0) break;
+    }
+    if (fd_a >= 0) close(fd_a);
+    if (fd_b >= 0) close(fd_b);
+    return same;
+}
+
+// Sizes of the regular files of a directory
+static std::map<std::string, long long> listFiles(const std::string& dir) {
+    std::map<std::string, long long> files;
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) return files;
+
+    struct dirent* entry;
+    struct stat st;
+    while ((entry = readdir(handle)) != NULL) {
+        std::string path = dir + "/" + entry->d_name;
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) files[entry->d_name] = st.st_size;
+    }
+    closedir(handle);
+    return files;
+}
+
+// Compare every source with its target
+static tree_diff compareTrees(const std::vector<std::string>& sources, const std::vector<std::string>& targets) {
+    tree_diff diff = {0, 0, 0};
+    for (size_t i = 0; i < sources.size(); i++) {
+        std::map<std::string, long long> source_files = listFiles(sources[i]);
+        std::map<std::string, long long> target_files = listFiles(targets[i]);
+
+        for (auto& file : source_files) {
+            auto target = target_files.find(file.first);
+            if (target == target_files.end()) {
+                diff.missing++;
+            } else if (target->second != file.second ||
+                       !sameContent((sources[i] + "/" + file.first).c_str(), (targets[i] + "/" + file.first).c_str())) {
+                diff.differing++;
+            }
+        }
+        for (auto& file : target_files) {
+            if (source_files.find(file.first) == source_files.end()) diff.stale++;
+        }
+    }
+    return diff;
+}
+
+// Read a metric without labels from the OpenMetrics file of the manager (-1 if not found)
+static long long readMetric(const std::string& metrics_path, const char* name) {
+    FILE* file = fopen(metrics_path.c_str(), "r");
+    if (!file) return -1;
+
+    char line[512];
+    long long value = -1;
+    size_t length = strlen(name);
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, name, length) == 0 && line[length] == ' ') {
+            value = atoll(line + length + 1);
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+// Take a reading of the manager's memory and queue depth
+static void sampleManager(const std::string& metrics_path, manager_samples* samples) {
+    long rss = readMemoryKb("VmHWM");
+    if (rss > samples->peak_rss_kb) samples->peak_rss_kb = rss;
+
+    long long depth = readMetric(metrics_path, "fss_queue_depth");
+    if (depth > samples->peak_queue_depth) samples->peak_queue_depth = depth;
+}
+
+///// MAIN FUNCTION /////
+
+int main(int argc, char* argv[]) {
+    soak_options options = {DEFAULT_WORK_DIR, NULL, 2, 30, 4, {200, 200, 50, 20}, 0, 16384, 2000, 5, 60};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:o:p:t:j:C:M:D:R:s:S:f:n:w:")) != -1) {
+        switch (opt) {
+            case 'd': options.work_dir = optarg; break;
+            case 'o': options.output_path = optarg; break;
+            case 'p': options.pairs = atoi(optarg); break;
+            case 't': options.duration_s = atof(optarg); break;
+            case 'j': options.concurrency = atoi(optarg); break;
+            case 'C': options.rates[OP_CREATE] = atof(optarg); break;
+            case 'M': options.rates[OP_MODIFY] = atof(optarg); break;
+            case 'D': options.rates[OP_DELETE] = atof(optarg); break;
+            case 'R': options.rates[OP_RENAME] = atof(optarg); break;
+            case 's': options.min_size = atoll(optarg); break;
+            case 'S': options.max_size = atoll(optarg); break;
+            case 'f': options.max_files = atoi(optarg); break;
+            case 'n': options.workers = atoi(optarg); break;
+            case 'w': options.converge_timeout_s = atof(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-d <work_dir>] [-o <results.json>] [-p <pairs>] [-t <seconds>] [-j <concurrency>]\n"
+                                "       [-C <creates/s>] [-M <modifies/s>] [-D <deletes/s>] [-R <renames/s>]\n"
+                                "       [-s <min_size>] [-S <max_size>] [-f <max_files>] [-n <workers>] [-w <converge_timeout>]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+
+    double total_rate = 0;
+    for (int i = 0; i < OP_COUNT; i++) total_rate += options.rates[i];
+    if (options.pairs <= 0 || options.concurrency <= 0 || total_rate <= 0 || options.max_size < options.min_size) {
+        fprintf(stderr, "Invalid options\n");
+        return 1;
+    }
+    if (access("./bin/fss_manager", X_OK) != 0 || access("./bin/worker", X_OK) != 0) {
+        fprintf(stderr, "Run from the repository root after building (make)\n");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // Empty source and target directories, the manager exports its metrics every second
+    std::string dir = options.work_dir;
+    removeTree(dir.c_str());
+    mkdir(dir.c_str(), 0755);
+    std::vector<std::string> sources, targets;
+    std::string config_path = dir + "/config";
+    std::string metrics_path = dir + "/metrics.prom";
+    FILE* config = fopen(config_path.c_str(), "w");
+    if (!config) {
+        perror("config");
+        return 1;
+    }
+    fprintf(config, "@metrics_file=%s\n@metrics_interval=1\n", metrics_path.c_str());
+    for (int i = 0; i < options.pairs; i++) {
+        sources.push_back(dir + "/src" + std::to_string(i));
+        targets.push_back(dir + "/trg" + std::to_string(i));
+        mkdir(sources.back().c_str(), 0755);
+        mkdir(targets.back().c_str(), 0755);
+        fprintf(config, "%s %s\n", sources.back().c_str(), targets.back().c_str());
+    }
+    fclose(config);
+
+    if (!startManager(config_path.c_str(), (dir + "/manager.log").c_str(), options.workers)) return 1;
+    if (!waitForOutput("Monitoring started for", options.pairs, 10)) {
+        fprintf(stderr, "Manager did not start monitoring the directories\n");
+        stopManager();
+        return 1;
+    }
+
+    // Run the generators and sample the manager while they work
+    fprintf(stderr, "Soaking %d pairs for %.0f s (%.0f ops/s)\n", options.pairs, options.duration_s, total_rate);
+    manager_samples samples = {0, 0, 0, 0};
+    std::vector<soak_generator> generators(options.concurrency);
+    std::vector<pthread_t> threads(options.concurrency);
+    double start = now();
+    for (int i = 0; i < options.concurrency; i++) {
+        soak_generator* generator = &generators[i];
+        generator->id = i;
+        generator->options = &options;
+        generator->sources = &sources;
+        generator->end_time = start + options.duration_s;
+        generator->random_state = 0x9E3779B97F4A7C15ULL + i * 0x632BE59BD9B4E019ULL;
+        memset(generator->counts, 0, sizeof(generator->counts));
+        generator->errors = 0;
+        generator->next_name = 0;
+        pthread_create(&threads[i], NULL, generatorThread, generator);
+    }
+    while (now() < start + options.duration_s) {
+        drainOutput();
+        sampleManager(metrics_path, &samples);
+        usleep(SAMPLE_INTERVAL_US);
+    }
+    for (int i = 0; i < options.concurrency; i++) pthread_join(threads[i], NULL);
+    double load_end = now();
+
+    // Wait until the targets match the sources
+    fprintf(stderr, "Waiting for convergence\n");
+    tree_diff diff;
+    double convergence_s = -1;
+    for (;;) {
+        drainOutput();
+        sampleManager(metrics_path, &samples);
+        diff = compareTrees(sources, targets);
+        if (diff.missing == 0 && diff.stale == 0 && diff.differing == 0) {
+            convergence_s = now() - load_end;
+            break;
+        }
+        if (now() - load_end > options.converge_timeout_s) break;
+        usleep(SAMPLE_INTERVAL_US);
+    }
+
+    // Final readings (the metrics file is at most a second old)
+    usleep(1100000);
+    drainOutput();
+    sampleManager(metrics_path, &samples);
+    samples.inotify_overflows = readMetric(metrics_path, "fss_inotify_overflows_total");
+    samples.tasks_enqueued = readMetric(metrics_path, "fss_tasks_enqueued_total");
+    long rss_kb = readMemoryKb("VmRSS");
+    double manager_cpu_s, workers_cpu_s;
+    readCpuTime(&manager_cpu_s, &workers_cpu_s);
+    stopManager();
+
+    // Results
+    long long counts[OP_COUNT] = {0, 0, 0, 0};
+    long long errors = 0, operations = 0;
+    for (const soak_generator& generator : generators) {
+        for (int i = 0; i < OP_COUNT; i++) {
+            counts[i] += generator.counts[i];
+            operations += generator.counts[i];
+        }
+        errors += generator.errors;
+    }
+
+    FILE* out = options.output_path ? fopen(options.output_path, "w") : stdout;
+    if (!out) {
+        perror(options.output_path);
+        return 1;
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"config\": {\"pairs\": %d, \"duration_s\": %.1f, \"concurrency\": %d, \"workers\": %d, "
+                 "\"min_size\": %lld, \"max_size\": %lld, \"max_files\": %d,\n",
+            options.pairs, options.duration_s, options.concurrency, options.workers,
+            options.min_size, options.max_size, options.max_files);
+    fprintf(out, "             \"rates\": {");
+    for (int i = 0; i < OP_COUNT; i++) fprintf(out, "%s\"%s\": %.1f", i ? ", " : "", op_names[i], options.rates[i]);
+    fprintf(out, "}},\n");
+    fprintf(out, "  \"operations\": {");
+    for (int i = 0; i < OP_COUNT; i++) fprintf(out, "\"%s\": %lld, ", op_names[i], counts[i]);
+    fprintf(out, "\"errors\": %lld, \"ops_per_s\": %.1f},\n", errors, operations / (load_end - start));
+    fprintf(out, "  \"converged\": %s,\n", convergence_s >= 0 ? "true" : "false");
+    fprintf(out, "  \"convergence_s\": %.3f,\n", convergence_s);
+    fprintf(out, "  \"dropped_events\": {\"missing\": %lld, \"stale\": %lld, \"differing\": %lld},\n",
+            diff.missing, diff.stale, diff.differing);
+    fprintf(out, "  \"manager\": {\"peak_queue_depth\": %lld, \"tasks_enqueued\": %lld, \"inotify_overflows\": %lld, "
+                 "\"rss_kb\": %ld, \"peak_rss_kb\": %ld, \"cpu_s\": %.3f, \"workers_cpu_s\": %.3f}\n",
+            samples.peak_queue_depth, samples.tasks_enqueued, samples.inotify_overflows,
+            rss_kb, samples.peak_rss_kb, manager_cpu_s, workers_cpu_s);
+    fprintf(out, "}\n");
+    if (options.output_path) fclose(out);
+
+    // Keep the trees and the manager log if the targets did not converge
+    if (convergence_s < 0) {
+        fprintf(stderr, "Targets did not converge, see %s\n", dir.c_str());
+        return 2;
+    }
+    removeTree(dir.c_str());
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <vector>
+#include <algorithm>
+#include "bench_utils.h"
+#include "../header/worker_launch.h"
+
+// fss_spawn_bench: Worker launch latency (posix_spawn and fork + execv, as the manager starts workers) while the
+// process holds a growing heap, like a manager with a big sync_info and a deep queue
+// At every heap size each method launches the program -n times, one at a time, and measures:
+//   launch: the launchWorker() call, the time the manager loop is blocked
+//   exit:   from the call until the child closed its stdout (it exec'd, ran and exited)
+//   ./bin/fss_spawn_bench [-m <MB,MB,...>] [-n <launches>] [-w <program>] [-o <results.json>]
+
+#define DEFAULT_HEAP_SIZES "0,256,1024,4096"
+#define DEFAULT_LAUNCHES 200
+#define DEFAULT_PROGRAM "/bin/true"
+
+// Latencies of one method at one heap size (microseconds)
+typedef struct {
+    double launch_p50;
+    double launch_p99;
+    double launch_mean;
+    double exit_p50;
+    double exit_p99;
+    int failed;
+} spawn_result;
+
+///// HELPER FUNCTIONS /////
+
+// Resident memory of this process in MB
+static double residentMb() {
+    long pages = 0, resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file) {
+        if (fscanf(file, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        fclose(file);
+    }
+    return resident * (double)sysconf(_SC_PAGESIZE) / (1024 * 1024);
+}
+
+// Value at quantile q of sorted values
+static double quantile(const std::vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    size_t index = (size_t)(q * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+// Launch program count times with a method
+static void measureLaunches(const char* program, spawn_method method, int count, spawn_result* result) {
+    char* args[] = {(char*)program, NULL};
+    std::vector<double> launch_us, exit_us;
+    double launch_sum = 0;
+    memset(result, 0, sizeof(*result));
+
+    for (int i = 0; i < count; i++) {
+        int pipe_fds[2];
+        if (pipe2(pipe_fds, O_CLOEXEC) < 0) {
+            perror("pipe");
+            exit(1);
+        }
+
+        double start = now();
+        pid_t pid = launchWorker(program, args, pipe_fds[1], method);
+        double launched = now();
+        close(pipe_fds[1]);
+        if (pid < 0) {
+            close(pipe_fds[0]);
+            result->failed++;
+            continue;
+        }
+
+        // The child's stdout reaches end of file when it exits
+        char buffer[256];
+        while (read(pipe_fds[0], buffer, sizeof(buffer)) > 0) {}
+        double exited = now();
+        close(pipe_fds[0]);
+        waitpid(pid, NULL, 0);
+
+        launch_us.push_back((launched - start) * 1e6);
+        exit_us.push_back((exited - start) * 1e6);
+        launch_sum += (launched - start) * 1e6;
+    }
+
+    std::sort(launch_us.begin(), launch_us.end());
+    std::sort(exit_us.begin(), exit_us.end());
+    result->launch_p50 = quantile(launch_us, 0.5);
+    result->launch_p99 = quantile(launch_us, 0.99);
+    result->launch_mean = launch_us.empty() ? 0 : launch_sum / launch_us.size();
+    result->exit_p50 = quantile(exit_us, 0.5);
+    result->exit_p99 = quantile(exit_us, 0.99);
+}
+
+// Write the result of a method as a JSON object
+static void writeResult(FILE* out, const char* name, const spawn_result* result, bool last) {
+    fprintf(out, "        \"%s\": {\"launch_p50_us\": %.1f, \"launch_p99_us\": %.1f, \"launch_mean_us\": %.1f, "
+            "\"exit_p50_us\": %.1f, \"exit_p99_us\": %.1f, \"failed\": %d}%s\n", name, result->launch_p50,
+            result->launch_p99, result->launch_mean, result->exit_p50, result->exit_p99, result->failed,
+            last ? "" : ",");
+}
+
+///// MAIN FUNCTION /////
+
+int main(int argc, char* argv[]) {
+    const char* output_path = NULL;
+    const char* heap_sizes = DEFAULT_HEAP_SIZES;
+    const char* program = DEFAULT_PROGRAM;
+    int launches = DEFAULT_LAUNCHES;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:n:w:o:")) != -1) {
+        switch (opt) {
+            case 'm': heap_sizes = optarg; break;
+            case 'n': launches = atoi(optarg); break;
+            case 'w': program = optarg; break;
+            case 'o': output_path = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-m <MB,MB,...>] [-n <launches>] [-w <program>] [-o <results.json>]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (launches <= 0 || access(program, X_OK) != 0) {
+        fprintf(stderr, "Launches must be positive and %s executable\n", program);
+        return 1;
+    }
+
+    FILE* out = output_path ? fopen(output_path, "w") : stdout;
+    if (!out) {
+        perror(output_path);
+        return 1;
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"timestamp\": %ld,\n", (long)time(NULL));
+    fprintf(out, "  \"program\": \"%s\",\n", program);
+    fprintf(out, "  \"launches\": %d,\n", launches);
+    fprintf(out, "  \"results\": [\n");
+
+    // The heap only grows, every size adds to what the previous ones allocated (touched, so it is resident)
+    std::vector<char*> heap;
+    long long allocated_mb = 0;
+    const char* size = heap_sizes;
+    while (*size) {
+        long long target_mb = atoll(size);
+        for (; allocated_mb < target_mb; allocated_mb++) {
+            char* block = (char*)malloc(1024 * 1024);
+            if (!block) {
+                perror("malloc");
+                return 1;
+            }
+            memset(block, (int)allocated_mb, 1024 * 1024);
+            heap.push_back(block);
+        }
+
+        spawn_result posix_result, fork_result;
+        measureLaunches(program, SPAWN_POSIX, launches, &posix_result);
+        measureLaunches(program, SPAWN_FORK, launches, &fork_result);
+        fprintf(stderr, "heap %lld MB: posix_spawn %.1f us, fork %.1f us (p50 launch)\n", target_mb,
+                posix_result.launch_p50, fork_result.launch_p50);
+
+        size = strchr(size, ',');
+        size = size ? size + 1 : "";
+        fprintf(out, "    {\n");
+        fprintf(out, "      \"heap_mb\": %lld,\n", target_mb);
+        fprintf(out, "      \"rss_mb\": %.1f,\n", residentMb());
+        fprintf(out, "      \"methods\": {\n");
+        writeResult(out, "posix_spawn", &posix_result, false);
+        writeResult(out, "fork", &fork_result, true);
+        fprintf(out, "      }\n");
+        fprintf(out, "    }%s\n", *size ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+
+    for (char* block : heap) free(block);
+    if (output_path) fclose(out);
+    return 0;
+}
\ No newline at end of file
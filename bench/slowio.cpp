@@ -0,0 +1,279 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// slowio: LD_PRELOAD shim that makes storage slow and unreliable for paths matching a pattern
+// Built as bin/libfss_slowio.so (make slowio), configured with environment variables:
+//   FSS_SLOWIO_PATTERN     fnmatch() pattern of the affected paths ('*' also matches '/', empty = all paths)
+//   FSS_SLOWIO_OPS         Affected calls, comma separated: open,read,write,unlink,copy_file_range (default all)
+//                          write also covers writev
+//   FSS_SLOWIO_LATENCY_US  Delay added to every affected call
+//   FSS_SLOWIO_JITTER_US   Extra random delay, 0 - N microseconds
+//   FSS_SLOWIO_BPS         Bandwidth cap of read/write/copy_file_range in bytes/s (per thread)
+//   FSS_SLOWIO_ERROR_RATE  Probability (0 - 1) that an affected call fails
+//   FSS_SLOWIO_ERRNO       errno of the injected failures (default EIO)
+//   FSS_SLOWIO_SEED        Seed of the random delays and failures (default 1), the same seed gives the same sequence
+// read/write/copy_file_range are affected when their file descriptor was opened with a matching path
+
+#define FD_LIMIT 65536      // Descriptors above this are never affected
+
+// Affected calls
+#define OP_OPEN             (1 << 0)
+#define OP_READ             (1 << 1)
+#define OP_WRITE            (1 << 2)
+#define OP_UNLINK           (1 << 3)
+#define OP_COPY_FILE_RANGE  (1 << 4)
+#define OP_ALL              0x1f
+
+// Configuration read from the environment
+static bool initialized = false;
+static bool enabled = false;
+static const char* pattern = NULL;
+static int ops = OP_ALL;
+static long long latency_ns = 0;
+static long long jitter_ns = 0;
+static long long bytes_per_s = 0;
+static double error_rate = 0;
+static int error_number = EIO;
+static uint64_t seed = 1;
+
+// Descriptors opened with a matching path
+static unsigned char slow_fds[FD_LIMIT];
+
+// Per-thread state
+static __thread uint64_t random_state = 0;
+static __thread uint64_t bandwidth_free_ns = 0;   // When the bandwidth cap allows the next transfer
+
+// Real functions
+static int (*real_open)(const char*, int, ...) = NULL;
+static int (*real_open64)(const char*, int, ...) = NULL;
+static int (*real_openat)(int, const char*, int, ...) = NULL;
+static int (*real_close)(int) = NULL;
+static ssize_t (*real_read)(int, void*, size_t) = NULL;
+static ssize_t (*real_write)(int, const void*, size_t) = NULL;
+static ssize_t (*real_writev)(int, const struct iovec*, int) = NULL;
+static int (*real_unlink)(const char*) = NULL;
+static ssize_t (*real_copy_file_range)(int, off_t*, int, off_t*, size_t, unsigned int) = NULL;
+
+///// HELPER FUNCTIONS /////
+
+// Read the configuration and look up the real functions (runs before main, or at the first call
+// if another library's constructor does I/O first)
+__attribute__((constructor))
+static void initSlowIO() {
+    real_open = (int (*)(const char*, int, ...))dlsym(RTLD_NEXT, "open");
+    real_open64 = (int (*)(const char*, int, ...))dlsym(RTLD_NEXT, "open64");
+    real_openat = (int (*)(int, const char*, int, ...))dlsym(RTLD_NEXT, "openat");
+    real_close = (int (*)(int))dlsym(RTLD_NEXT, "close");
+    real_read = (ssize_t (*)(int, void*, size_t))dlsym(RTLD_NEXT, "read");
+    real_write = (ssize_t (*)(int, const void*, size_t))dlsym(RTLD_NEXT, "write");
+    real_writev = (ssize_t (*)(int, const struct iovec*, int))dlsym(RTLD_NEXT, "writev");
+    real_unlink = (int (*)(const char*))dlsym(RTLD_NEXT, "unlink");
+    real_copy_file_range = (ssize_t (*)(int, off_t*, int, off_t*, size_t, unsigned int))dlsym(RTLD_NEXT, "copy_file_range");
+
+    const char* value;
+    pattern = getenv("FSS_SLOWIO_PATTERN");
+    if (pattern && !*pattern) pattern = NULL;
+
+    if ((value = getenv("FSS_SLOWIO_OPS")) && *value) {
+        ops = 0;
+        if (strstr(value, "open")) ops |= OP_OPEN;
+        if (strstr(value, "read")) ops |= OP_READ;
+        if (strstr(value, "write")) ops |= OP_WRITE;
+        if (strstr(value, "unlink")) ops |= OP_UNLINK;
+        if (strstr(value, "copy_file_range")) ops |= OP_COPY_FILE_RANGE;
+    }
+    if ((value = getenv("FSS_SLOWIO_LATENCY_US"))) latency_ns = atoll(value) * 1000;
+    if ((value = getenv("FSS_SLOWIO_JITTER_US"))) jitter_ns = atoll(value) * 1000;
+    if ((value = getenv("FSS_SLOWIO_BPS"))) bytes_per_s = atoll(value);
+    if ((value = getenv("FSS_SLOWIO_ERROR_RATE"))) error_rate = atof(value);
+    if ((value = getenv("FSS_SLOWIO_ERRNO"))) error_number = atoi(value);
+    if ((value = getenv("FSS_SLOWIO_SEED"))) seed = strtoull(value, NULL, 10);
+    if (seed == 0) seed = 1;
+
+    enabled = latency_ns > 0 || jitter_ns > 0 || bytes_per_s > 0 || error_rate > 0;
+    initialized = true;
+}
+
+// Returns monotonic clock time in nanoseconds
+static uint64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Sleep for the given nanoseconds (restarted if interrupted)
+static void sleepNs(uint64_t ns) {
+    struct timespec ts = {(time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL)};
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {}
+}
+
+// Deterministic pseudo-random numbers (xorshift64) of the calling thread
+static uint64_t nextRandom() {
+    if (random_state == 0) random_state = seed;
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+// Check if a path is affected
+static bool matchesPath(const char* path) {
+    return path && (!pattern || fnmatch(pattern, path, 0) == 0);
+}
+
+// Check if a descriptor was opened with an affected path
+static bool isSlowFd(int fd) {
+    return fd >= 0 && fd < FD_LIMIT && slow_fds[fd];
+}
+
+// Add latency to an affected call, returns false if the call should fail instead
+static bool injectFault(int op) {
+    if (!(ops & op)) return true;
+
+    uint64_t delay = latency_ns;
+    if (jitter_ns > 0) delay += nextRandom() % (uint64_t)(jitter_ns + 1);
+    if (delay > 0) sleepNs(delay);
+
+    if (error_rate > 0 && (nextRandom() % 1000000) < (uint64_t)(error_rate * 1000000)) {
+        errno = error_number;
+        return false;
+    }
+    return true;
+}
+
+// Hold the caller back so that its transfers stay under the bandwidth cap
+static void limitBandwidth(int op, ssize_t bytes) {
+    if (!(ops & op) || bytes_per_s <= 0 || bytes <= 0) return;
+
+    uint64_t now = monotonicNs();
+    uint64_t start = bandwidth_free_ns > now ? bandwidth_free_ns : now;
+    bandwidth_free_ns = start + (uint64_t)((double)bytes * 1e9 / bytes_per_s);
+    if (bandwidth_free_ns > now) sleepNs(bandwidth_free_ns - now);
+}
+
+// Remember if a new descriptor belongs to an affected path
+static void trackFd(int fd, const char* path) {
+    if (fd >= 0 && fd < FD_LIMIT) slow_fds[fd] = matchesPath(path);
+}
+
+// Common part of open/open64/openat
+static int openPath(int (*real)(const char*, int, ...), int (*real_at)(int, const char*, int, ...),
+                    int dir_fd, const char* path, int flags, mode_t mode) {
+    if (!initialized) initSlowIO();
+    if (enabled && matchesPath(path) && !injectFault(OP_OPEN)) return -1;
+
+    int fd = real_at ? real_at(dir_fd, path, flags, mode) : real(path, flags, mode);
+    if (enabled) trackFd(fd, path);
+    return fd;
+}
+
+///// INTERPOSED FUNCTIONS /////
+
+extern "C" {
+
+int open(const char* path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    return openPath(real_open, NULL, AT_FDCWD, path, flags, mode);
+}
+
+int open64(const char* path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    return openPath(real_open64 ? real_open64 : real_open, NULL, AT_FDCWD, path, flags, mode);
+}
+
+int openat(int dir_fd, const char* path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    return openPath(NULL, real_openat, dir_fd, path, flags, mode);
+}
+
+int close(int fd) {
+    if (!initialized) initSlowIO();
+    if (fd >= 0 && fd < FD_LIMIT) slow_fds[fd] = 0;
+    return real_close(fd);
+}
+
+ssize_t read(int fd, void* buffer, size_t count) {
+    if (!initialized) initSlowIO();
+    if (!enabled || !isSlowFd(fd)) return real_read(fd, buffer, count);
+    if (!injectFault(OP_READ)) return -1;
+
+    ssize_t bytes = real_read(fd, buffer, count);
+    limitBandwidth(OP_READ, bytes);
+    return bytes;
+}
+
+ssize_t write(int fd, const void* buffer, size_t count) {
+    if (!initialized) initSlowIO();
+    if (!enabled || !isSlowFd(fd)) return real_write(fd, buffer, count);
+    if (!injectFault(OP_WRITE)) return -1;
+
+    ssize_t bytes = real_write(fd, buffer, count);
+    limitBandwidth(OP_WRITE, bytes);
+    return bytes;
+}
+
+ssize_t writev(int fd, const struct iovec* iov, int count) {
+    if (!initialized) initSlowIO();
+    if (!enabled || !isSlowFd(fd)) return real_writev(fd, iov, count);
+    if (!injectFault(OP_WRITE)) return -1;
+
+    ssize_t bytes = real_writev(fd, iov, count);
+    limitBandwidth(OP_WRITE, bytes);
+    return bytes;
+}
+
+int unlink(const char* path) {
+    if (!initialized) initSlowIO();
+    if (enabled && matchesPath(path) && !injectFault(OP_UNLINK)) return -1;
+    return real_unlink(path);
+}
+
+ssize_t copy_file_range(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t length, unsigned int flags) {
+    if (!initialized) initSlowIO();
+    if (!real_copy_file_range) {
+        errno = ENOSYS;
+        return -1;
+    }
+    if (!enabled || (!isSlowFd(fd_in) && !isSlowFd(fd_out))) {
+        return real_copy_file_range(fd_in, off_in, fd_out, off_out, length, flags);
+    }
+    if (!injectFault(OP_COPY_FILE_RANGE)) return -1;
+
+    ssize_t bytes = real_copy_file_range(fd_in, off_in, fd_out, off_out, length, flags);
+    limitBandwidth(OP_COPY_FILE_RANGE, bytes);
+    return bytes;
+}
+
+}
\ No newline at end of file
@@ -8,10 +8,11 @@ command=""
 usage() {
     echo "Usage: $0 -p <path> -c <command>"
     echo "Commands:"
-    echo "  purge - Deletes the file or directory at path"
+    echo "  purge - Deletes the file or directory at path (for a log also its rotated segments and index)"
     echo "  listAll - Lists all directories with last sync time and status"
     echo "  listMonitored - Lists all directories that are currently being monitored"
     echo "  listStopped   - Lists all directories that are no longer being monitored"
+    echo "  snapshot - Shows the live state of every directory (path = the manager's @state_file)"
     exit 1
 }
 
@@ -29,6 +30,17 @@ if [ -z "$path" ] || [ -z "$command" ]; then
     usage
 fi
 
+# Print the whole log: the rotated segments <log>.<N> (oldest first), then the current log
+readLog() {
+    for segment in "$path".*; do
+        number="${segment##*.}"
+        [[ "$number" =~ ^[0-9]+$ ]] && echo "$number"
+    done | sort -n | while read -r number; do
+        cat "$path.$number"
+    done
+    cat "$path"
+}
+
 # ListAll Command
 if [ "$command" = "listAll" ]; then
     if [ ! -f "$path" ]; then
@@ -36,9 +48,16 @@ if [ "$command" = "listAll" ]; then
         exit 1
     fi
 
+    # The manager keeps a summary of the log in <log>.index, one line per source:
+    # Format: SOURCE_DIR<TAB>TARGET_DIR<TAB>DATE TIME<TAB>STATUS<TAB>MONITORING (1/0/-)
+    if [ -f "$path.index" ]; then
+        awk -F'\t' '$4 != "" { print $1, "->", $2, "[Last Sync:", $3 "]", "[" $4 "]" }' "$path.index"
+        exit 0
+    fi
+
     # Format: [DATE TIME] [SOURCE_DIR] [TARGET_DIR] [WORKER_PID] [OPERATION] [STATUS] [DETAILS]
     # Field:   1    2      3            4            5            6           7        8+
-    awk '
+    readLog | awk '
     {
         # Check if it is a sync output message, if yes store the info we need
         if ($7 ~ /^\[(SUCCESS|PARTIAL|ERROR)\]$/) {
@@ -57,7 +76,7 @@ if [ "$command" = "listAll" ]; then
             print src_path[s], "->", trg_path[s], "[Last Sync:", date[s], time[s] "]", status[s]
         }
     }
-    ' "$path"
+    '
 
 # listMonitored and listStopped Commands
 elif [ "$command" = "listMonitored" ] || [ "$command" = "listStopped" ]; then
@@ -66,6 +85,18 @@ elif [ "$command" = "listMonitored" ] || [ "$command" = "listStopped" ]; then
         exit 1
     fi
 
+    # Served from the summary index when there is one (same format as in listAll)
+    if [ -f "$path.index" ]; then
+        awk -F'\t' -v command="$command" '
+        $4 != "" && ((command == "listMonitored" && $5 == "1") || (command == "listStopped" && $5 == "0")) {
+            print $1, "->", $2, "[Last Sync:", $3 "]"
+            foundResults = 1
+        }
+        END { if (!foundResults) print "No directories found for this command." }
+        ' "$path.index"
+        exit 0
+    fi
+
     # Get monitoring status from messages of this format:
     # Format: [DATE TIME] Monitoring started/stopped for <source_dir>
     # Field:   1    2     3          4               5    6
@@ -73,7 +104,7 @@ elif [ "$command" = "listMonitored" ] || [ "$command" = "listStopped" ]; then
     # Get latest sync info from messages of this format:
     # Format: [DATE TIME] [SOURCE_DIR] [TARGET_DIR] [WORKER_PID] [OPERATION] [STATUS] [DETAILS]
     # Field:   1    2      3            4            5            6           7        8+
-    awk -v command="$command" '
+    readLog | awk -v command="$command" '
     {
         # Check if it is a monitoring status message
         if ($3 == "Monitoring") {
@@ -104,7 +135,21 @@ elif [ "$command" = "listMonitored" ] || [ "$command" = "listStopped" ]; then
         }
         if (foundResults == 0) print "No directories found for this command."
     }
-    ' "$path"
+    '
+
+# Snapshot Command: read the state file the manager keeps in shared memory (no log parsing)
+elif [ "$command" = "snapshot" ]; then
+    if [ ! -f "$path" ]; then
+        echo "Error: State file not found at $path"
+        exit 1
+    fi
+
+    reader="$(dirname "$0")/bin/fss_state"
+    if [ ! -x "$reader" ]; then
+        echo "Error: $reader not found (run make)"
+        exit 1
+    fi
+    "$reader" -f "$path" || exit 1
 
 # Purge Command
 elif [ "$command" = "purge" ]; then
@@ -120,6 +165,13 @@ elif [ "$command" = "purge" ]; then
         rm -rf "$path"      # delete directory and its contents (recursively)
     else
         rm -f "$path"       # just delete file
+
+        # A log also has rotated segments <log>.<N> and a summary index, which would answer for the deleted log
+        for segment in "$path".*; do
+            number="${segment##*.}"
+            [[ "$number" =~ ^[0-9]+$ ]] && rm -f "$segment"
+        done
+        rm -f "$path.index" "$path.index.tmp"
     fi
     
     echo "Purge complete."
@@ -2,23 +2,50 @@
 #define COMMANDS_H
 
 // Commands: These functions handle the commands sent to the manager (+ custom delete command to remove directory data from memory)
+// Each returns a result code that framed requests get back in their END frame (see protocol.h)
+
+#define CMD_OK 0        // Done
+#define CMD_FAILED 1    // Valid command that could not be done (e.g. directory not monitored)
+#define CMD_INVALID 2   // Unknown command or wrong arguments
+
+// Parse a command line ("add <source> <target>", "cancel <source>", ...) and run it
+// shutdown is set when the command shut the manager down
+int executeCommand(const char* line, int fss_out, int log_fd, int inotify_fd, bool* shutdown);
 
 // Add pair to sync_info and start monitoring it
-void commandAdd(const char* source, const char* target, int fss_out, int log_fd, int inotify_fd);
+int commandAdd(const char* source, const char* target, int fss_out, int log_fd, int inotify_fd);
+
+// Add every pair of a file (config format, global options are ignored) and start monitoring them
+// Sends one summary, the initial full syncs are staggered (see scheduleFullSync())
+int commandAddFile(const char* path, int fss_out, int log_fd, int inotify_fd);
+
+// Apply the pairs of the config file again (SIGHUP): add new pairs, cancel removed ones and update changed targets
+// Unchanged pairs keep their watch, queue and limits. Nothing changes if the file has an invalid line
+int commandReload(const char* config_path, int fss_out, int log_fd, int inotify_fd);
+
+// Start monitoring a pair without a full sync (its pending tasks were recovered from the task journal)
+int commandResume(const char* source, int fss_out, int log_fd, int inotify_fd);
 
 // Stop monitoring directory 
-void commandCancel(const char* source, int fss_out, int log_fd, int inotify_fd);
+int commandCancel(const char* source, int fss_out, int log_fd, int inotify_fd);
 
 // Show status of directory (use "all" to print all directories)
-void commandStatus(const char* source, int fss_out);
+int commandStatus(const char* source, int fss_out);
+
+// Show metrics of directory (use "all" for the metrics of the whole manager)
+int commandStats(const char* source, int fss_out);
 
 // Sync directory
-void commandSync(const char* source, int fss_out, int log_fd, int inotify_fd);
+int commandSync(const char* source, int fss_out, int log_fd, int inotify_fd);
 
 // Delete directory from sync_info (only if inactive)
-void commandDelete(const char* source, int fss_out, int log_fd);
+int commandDelete(const char* source, int fss_out, int log_fd);
+
+// Set bytes/s and files/s limits of a directory (use "global" for the limits of all workers)
+int commandThrottle(const char* source, const char* bps, const char* fps, int fss_out, int log_fd);
 
 // Shutdown the manager and clean up resources
-void commandShutdown(int fss_out, int log_fd);
+// Fast shutdown only waits for the active workers and leaves the queued tasks in the task journal
+int commandShutdown(int fss_out, int log_fd, bool fast);
 
 #endif // COMMANDS_H
\ No newline at end of file
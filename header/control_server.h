@@ -0,0 +1,28 @@
+#ifndef CONTROL_SERVER_H
+#define CONTROL_SERVER_H
+
+#include <poll.h>
+
+// Control Server: UNIX socket (SOCK_SEQPACKET) where many clients can send commands at the same time (@control_socket)
+// Each client has its own session: requests use the protocol of fss_in/fss_out (protocol.h, request lines in packets)
+// and its responses go only to it, one frame per packet. Responses are queued per client and sent when its socket
+// is writable, so a slow client never blocks the manager loop
+// Messages that belong to no request (e.g. "Sync completed") are only sent to fss_out
+
+#define CONTROL_MAX_CLIENTS 32
+#define CONTROL_OUTPUT_MAX (8 * 1024 * 1024)    // Queued response bytes after which a client is disconnected
+
+// Create the socket and start accepting clients, returns false on error
+bool openControlServer(const char* path);
+
+// Fill fds for the listening socket and the sessions, returns how many were used (at most CONTROL_MAX_CLIENTS + 1)
+int addControlPollFds(struct pollfd* fds);
+
+// Accept clients, run the commands they sent and send their queued responses
+// shutdown is set when a command shut the manager down
+void handleControlEvents(const struct pollfd* fds, int count, int log_fd, int inotify_fd, bool* shutdown);
+
+// Send what is still queued (waiting at most a second), close the sessions and remove the socket
+void closeControlServer();
+
+#endif // CONTROL_SERVER_H
\ No newline at end of file
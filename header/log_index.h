@@ -0,0 +1,24 @@
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+// Log Index: Summary of the log kept next to it as <log>.index, so fss_script does not have to read the whole log
+// One tab separated line per source: <source> <target> <last sync time> <status> <monitoring (1/0/-)>
+// It holds what a scan of the log would find: the latest sync result and the latest "Monitoring started/stopped"
+// Sources of earlier runs stay in the index (the log is appended to, not truncated)
+
+// Load the index of the log (if a previous run left one), returns false on error
+bool openLogIndex(const char* log_path);
+
+// Record the result of a finished task (time as "YYYY-MM-DD HH:MM:SS", status SUCCESS/PARTIAL/ERROR)
+void indexSyncResult(const char* source, const char* target, const char* time, const char* status);
+
+// Record that monitoring of a source started or stopped
+void indexMonitoring(const char* source, bool monitoring);
+
+// Write the index file if it changed and a second has passed since the last write (force = write if changed)
+void flushLogIndex(bool force);
+
+// Write the index file and free the index
+void closeLogIndex();
+
+#endif // LOG_INDEX_H
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Logger: Asynchronous writer of the manager's log file
+// forwardMessage() copies log messages into a lock-free ring buffer (single producer: the manager loop)
+// and a background thread writes them out in batches with writev(), so slow log storage never stalls the loop
+// When the ring is full, messages are dropped (counted, and reported in the log) or the loop waits (@log_full=block)
+// The flusher also rotates the log: the full file becomes segment <log>.<N> (N counts up) and a new file is started
+
+// Default ring size
+#define LOG_BUFFER_DEFAULT (1024 * 1024)
+
+// Default number of rotated segments kept
+#define LOG_KEEP_DEFAULT 10
+
+// Rotate the log at path when it reaches max_size bytes or is interval_s seconds old (0 = no limit)
+// keep = segments kept, older ones are deleted; call before openLogger()
+void setLogRotation(const char* path, long long max_size, int interval_s, int keep);
+
+// Start the flusher thread for log_fd, returns false on error (messages are then written directly)
+// capacity is rounded up to a power of two, block = wait for space instead of dropping messages
+bool openLogger(int log_fd, size_t capacity, bool block);
+
+// Queue a message for the log file, returns false if it was dropped
+bool logMessage(const char* msg, size_t length);
+
+// Messages dropped because the ring was full
+uint64_t getLogDropped();
+
+// Write out everything queued and stop the flusher thread
+void closeLogger();
+
+#endif // LOGGER_H
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <limits.h>  // For PATH_MAX
 #include <sys/types.h>
+#include "../header/str_builder.h"
 
 // message_utils: Functions to handle timestamp generation, message formatting and buffering
 
@@ -10,16 +11,37 @@
 #define TIMESTAMP_SIZE 23
 #define COMMAND_BUF_S (16 + 2*PATH_MAX) // ((SOURCE & TARGET PATHS) + COMMAND)
 
-// Returns timestamp string in [YYYY/MM/DD HH:MM:SS] format
-char* getTimestamp();
+// Writer that takes over the log file writes of forwardMessage() (e.g. the asynchronous logger)
+typedef bool (*log_writer_t)(const char* msg, size_t length);
 
-// Add timestamp to the beginning of a message, returns the new exapnded message
-char* addTimestampToMessage(char* msg, const char* custom_timestamp);
+// Writer that takes over the console writes of its own descriptors (e.g. the control socket sessions)
+// Gets one frame (header may be empty), returns false if fd is not one of its descriptors
+typedef bool (*console_writer_t)(int fd, const char* header, size_t header_len, const char* msg, size_t msg_len);
 
-// Concatenate a message to an existing dynamically allocated buffer
-// If the buffer is NULL, a new buffer is created
-// Returns the new or expanded buffer
-char* appendToBuffer(char* existing_buffer, const char* msg);
+// Largest payload of a response frame (a frame is sent as one packet on the control socket)
+#define FRAME_PAYLOAD_MAX (60 * 1024)
+
+// Returns the current timestamp in [YYYY-MM-DD HH:MM:SS] format (static buffer, formatted once per second)
+const char* currentTimestamp();
+
+// Append the current timestamp (or custom_timestamp if not NULL) to a message
+void appendTimestamp(str_builder* msg, const char* custom_timestamp);
+
+// Start a message with the current timestamp (free it with sbFree())
+void startMessage(str_builder* msg);
+
+// Route the writes to log_fd through writer (NULL = write directly)
+void setLogWriter(int log_fd, log_writer_t writer);
+
+// Frame the messages sent to the console as output of request id (0 = no request, -1 = plain text, see protocol.h)
+void setResponseId(long long id);
+long long getResponseId();
+
+// Route the console writes of the writer's own descriptors through it (NULL = write directly)
+void setConsoleWriter(console_writer_t writer);
+
+// Send one frame (header + message) to a console
+void writeConsole(int fss_out, const char* header, size_t header_len, const char* msg, size_t msg_len);
 
 // Sends buffered messages to the log file (if log_fd > 0) and to the console's terminal (if fss_out > 0)
 void forwardMessage(const char* msg, int fss_out, int log_fd);
@@ -0,0 +1,118 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <sys/resource.h>
+#include "../header/str_builder.h"
+#include "../header/task_manager.h"     // for task_op
+
+struct sync_info_entry;     // see sync_database.h
+
+// Metrics: Counters and latency histograms of the manager, shown by the stats command and exported as OpenMetrics text
+
+// Number of histogram buckets (upper bounds in metrics.cpp, last one is +Inf)
+#define HISTOGRAM_BUCKETS 14
+
+// Latency histogram with fixed buckets (values in seconds)
+typedef struct {
+    uint64_t buckets[HISTOGRAM_BUCKETS];   // Count of values <= bound of each bucket (not cumulative)
+    uint64_t count;
+    double sum;
+    double max;
+} latency_histogram;
+
+// Log-linear (HDR style) histogram of microsecond values
+// Values below 2*HDR_SUB_BUCKETS are exact, above that every power of two is split into HDR_SUB_BUCKETS buckets (~6% precision)
+#define HDR_SUB_BUCKETS 16
+#define HDR_MAX_SHIFT 32    // Values are capped at about 19 hours
+#define HDR_BUCKETS ((HDR_MAX_SHIFT + 2) * HDR_SUB_BUCKETS)
+
+typedef struct {
+    uint32_t counts[HDR_BUCKETS];
+    uint64_t count;
+    uint64_t max;
+} hdr_histogram;
+
+// Stages of a task that are timed for each pair
+enum latency_stage {
+    LATENCY_QUEUED,     // Enqueue -> dispatch to a worker
+    LATENCY_STARTUP,    // Dispatch -> worker starts copying
+    LATENCY_COPY,       // Copy start -> copy end
+    LATENCY_REPORT,     // Copy end -> report parsed by the manager
+    LATENCY_TOTAL,      // Inotify event (or enqueue) -> copy end, i.e. how long until the change is in the target
+    LATENCY_STAGES
+};
+
+// Latency histograms of a pair
+typedef struct {
+    hdr_histogram stages[LATENCY_STAGES];
+} pair_latency;
+
+// Timestamps of a finished task (monotonic clock, ns), copy times are 0 if the worker did not report them
+typedef struct {
+    uint64_t event_ns;
+    uint64_t enqueued_ns;
+    uint64_t dispatched_ns;
+    uint64_t copy_start_ns;
+    uint64_t copy_end_ns;
+    uint64_t parsed_ns;
+} task_timing;
+
+// Resources used by finished workers (wait4() rusage), summed over tasks
+typedef struct {
+    uint64_t tasks;
+    uint64_t user_us;           // CPU time
+    uint64_t sys_us;
+    uint64_t max_rss_kb;        // Largest peak RSS of a single worker
+    uint64_t in_blocks;         // Blocks read from / written to storage (512 byte units, page cache hits not counted)
+    uint64_t out_blocks;
+    uint64_t voluntary_cs;      // Context switches while waiting (e.g. for I/O)
+    uint64_t involuntary_cs;    // Context switches because the worker was preempted
+} task_usage;
+
+// Counters of the manager
+struct manager_metrics {
+    uint64_t tasks_enqueued;
+    uint64_t tasks_dispatched;
+    uint64_t tasks_completed;
+    uint64_t tasks_failed;                  // Completed with PARTIAL or ERROR status
+    uint64_t queue_collapses;               // Backlogs of a pair replaced by a full sync (@collapse_limit)
+    latency_histogram spawn_latency;        // Time to create the worker process
+    latency_histogram completion_latency;   // Time from enqueue until the worker's report is processed
+    task_usage op_usage[TASK_OPS];          // Resources used by the workers of each operation
+};
+
+extern manager_metrics metrics;
+
+// Add a value (in seconds) to a histogram
+void observeLatency(latency_histogram* histogram, double seconds);
+
+// Add the stage intervals of a finished task to the histograms of its pair (allocated on first use)
+void recordTaskLatency(sync_info_entry* entry, const task_timing* timing);
+
+// Add the resources used by a finished worker to its pair (allocated on first use) and to its operation
+// task is set to the resources of this worker alone
+void recordTaskUsage(sync_info_entry* entry, task_op op, const struct rusage* rusage, task_usage* task);
+
+// Append resource usage to a message: " (cpu <user>+<sys> ms, rss <KB> KB, io <in>/<out> blocks, cs <vol>/<invol>)"
+// Used at the end of a worker's log line
+void appendTaskUsage(str_builder* msg, const task_usage* usage);
+
+// Append the resources used by the pair's workers to a message (nothing if no task of the pair has finished yet)
+void appendPairUsage(str_builder* msg, const sync_info_entry* entry);
+
+// Append the resources used by the workers of each operation to a message
+void appendOpUsage(str_builder* msg);
+
+// Append p50/p99/p999 of the pair's stage histograms to a message (nothing if no task of the pair has finished yet)
+void appendPairLatency(str_builder* msg, const sync_info_entry* entry);
+
+// Append metrics of a directory (or of the whole manager if source is "all") to a message
+// Returns false if the directory is not found
+bool appendStats(str_builder* msg, const char* source);
+
+// Write metrics to the OpenMetrics text file (@metrics_file) if the export interval has passed
+// The file is replaced atomically, force writes it regardless of the interval
+void exportMetrics(bool force);
+
+#endif // METRICS_H
\ No newline at end of file
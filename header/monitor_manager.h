@@ -3,6 +3,9 @@
 
 // Monitor Manager: Using inotify, the following functions manage directory monitoring
 
+// Number of times the kernel's inotify queue overflowed (see /proc/sys/fs/inotify/max_queued_events)
+extern long long inotify_overflow_count;
+
 // Initialize monitor manager (inotify), returns file descriptor
 int initMonitorManager();
 
@@ -13,6 +16,8 @@ int addDirToMonitor(int inotify_fd, const char* dir_path);
 int rmvDirFromMonitor(int inotify_fd, int wd);
 
 // Handle changes in one of the monitoring directories (process inotify events)
+// Drains the inotify queue (up to 1 MB of events per call, the rest is left for the next loop),
+// on overflow or lost watches the affected pairs are rescanned
 void handleDirChange(int inotify_fd, int fss_out, int log_fd);
 
 // Shutdown and clean up resources used by the monitor manager
@@ -0,0 +1,57 @@
+#ifndef PRIORITY_H
+#define PRIORITY_H
+
+// Priority: CPU and I/O priority of the workers (shared by the manager and the worker)
+// Options, global (@key=value) or per pair, optionally prefixed with event_ (ADDED, MODIFIED and DELETED tasks)
+// or bulk_ (FULL and SYNC tasks):
+//   nice=<-20..19>                         Nice level
+//   ioprio=<idle | be[:0-7] | rt[:0-7]>    I/O scheduling class and level (see ioprio_set(2), rt needs CAP_SYS_ADMIN)
+//   cpus=<list>                            CPU affinity, e.g. 0-3,6
+// A task takes each value from the most specific place that sets it: pair + class, pair, global + class, global
+// The manager passes the values as worker arguments and the worker applies them to itself before it starts copying
+
+#define PRIORITY_CPUS_MAX 64    // Longest CPU list
+#define PRIORITY_ARG_MAX 80     // Longest worker argument made by formatPriorityArgs()
+#define PRIORITY_ARGS 3         // Worker arguments made by formatPriorityArgs() at most
+
+// Operation classes with their own priority
+enum priority_class {
+    PRIORITY_ALL,       // Options without prefix
+    PRIORITY_EVENT,     // event_ options
+    PRIORITY_BULK,      // bulk_ options
+    PRIORITY_CLASSES
+};
+
+// Priority values, all zero = nothing set
+typedef struct {
+    bool has_nice;
+    bool has_ioprio;
+    int nice;
+    int io_class;               // IOPRIO_CLASS_RT (1), IOPRIO_CLASS_BE (2) or IOPRIO_CLASS_IDLE (3)
+    int io_level;               // 0 (highest) - 7, not used by the idle class
+    char cpus[PRIORITY_CPUS_MAX];   // CPU list (empty = not set)
+} worker_priority;
+
+// Returns true if key is a priority option (with or without event_/bulk_ prefix)
+bool isPriorityOption(const char* key);
+
+// Set a priority option in the priorities of each class, returns false if the value is invalid
+bool setPriorityOption(worker_priority priorities[PRIORITY_CLASSES], const char* key, const char* value);
+
+// Returns true if both set the same values
+bool samePriority(const worker_priority* a, const worker_priority* b);
+
+// Fill the values that are not set in priority with those of fallback
+void mergePriority(worker_priority* priority, const worker_priority* fallback);
+
+// Format the values that are set as worker arguments ("nice=N", "ioprio=<class>:<level>", "cpus=<list>")
+// Returns the number of arguments written
+int formatPriorityArgs(const worker_priority* priority, char args[PRIORITY_ARGS][PRIORITY_ARG_MAX]);
+
+// Parse a worker argument made by formatPriorityArgs(), returns false if arg is not one
+bool parsePriorityArg(worker_priority* priority, const char* arg);
+
+// Apply the values that are set to the calling process, failures are reported on stderr
+void applyPriority(const worker_priority* priority);
+
+#endif // PRIORITY_H
\ No newline at end of file
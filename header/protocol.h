@@ -0,0 +1,52 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <limits.h>
+#include <sys/types.h>
+
+// Protocol: Framing of the commands sent to the manager and of its responses
+//   Request:   #<id> <command> [args]\n     (id > 0, any number of requests can be sent without waiting)
+//   Response:  #<id> <length>\n<payload>    (output of the request, any number of frames)
+//              #<id> END <rc>\n             (last frame of the request, rc = CMD_* code from commands.h)
+// Messages that belong to no request (e.g. "Sync completed") use id 0
+// A command without "#<id> " is answered with plain text, as before the framing (old consoles and scripts)
+
+#define REQUEST_MAX (4 * PATH_MAX)  // Longest request line, longer ones are rejected
+
+// Bytes read from a pipe that were not consumed yet
+typedef struct {
+    char* data;
+    size_t start;       // First byte not consumed
+    size_t length;      // End of the data
+    size_t capacity;
+} frame_buffer;
+
+// A parsed response frame (payload points into the frame_buffer and is valid until the next read)
+typedef struct {
+    long long id;           // -1 = plain text (not framed)
+    bool end;               // END frame
+    int rc;                 // Result code of an END frame
+    const char* payload;
+    size_t length;
+} response_frame;
+
+// Empty buffer / free its memory
+void initFrameBuffer(frame_buffer* buffer);
+void freeFrameBuffer(frame_buffer* buffer);
+
+// Append what fd has without blocking, returns bytes read, 0 at end of file or -1 on error (errno set, EAGAIN = nothing)
+ssize_t readFrameBuffer(int fd, frame_buffer* buffer);
+
+// Take the next complete request out of the buffer, returns false if there is none yet
+// id = -1 for a plain command; command is NUL terminated inside the buffer and valid until the next read
+// A plain command without a newline is taken as complete (old clients do not send one)
+bool nextRequest(frame_buffer* buffer, long long* id, char** command);
+
+// Take the next complete response frame out of the buffer, returns false if there is none yet
+bool nextResponse(frame_buffer* buffer, response_frame* frame);
+
+// Send the END frame of a request (nothing for plain commands)
+void sendResponseEnd(int fss_out, long long id, int rc);
+
+#endif // PROTOCOL_H
\ No newline at end of file
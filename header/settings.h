@@ -0,0 +1,44 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <limits.h>
+#include "../header/sync_database.h"    // for sync_info_entry
+
+// Settings: Global and per-pair options given in the config file
+//   Global option:   @key=value                       (one per line)
+//   Pair options:    <source> <target> key=value ...  (after the two directories)
+
+// Global options of the manager
+struct manager_settings {
+    long long global_bps;   // Bytes/s limit for all workers together (0 = unlimited)
+    long long global_fps;   // Files/s limit for all workers together (0 = unlimited)
+    char journal_path[PATH_MAX];    // Task journal file (empty = no journal)
+    long long journal_compact_size; // Journal size that triggers compaction (0 = default)
+    long long queue_memory;         // Memory cap of the in-memory task queue (0 = default)
+    char queue_spill_path[PATH_MAX];// File that holds the tasks that do not fit in memory
+    int collapse_limit;             // Queued tasks of a pair after which they become one full sync (0 = default)
+    char metrics_path[PATH_MAX];    // OpenMetrics text file (empty = no export)
+    int metrics_interval;           // Seconds between metrics file updates (0 = default)
+    char trace_path[PATH_MAX];      // Chrome trace-event JSON file (empty = tracing disabled)
+    long long log_buffer;           // Size of the log ring buffer (0 = default)
+    bool log_block;                 // Wait for space in a full log buffer instead of dropping messages
+    long long log_rotate_size;      // Log size that starts a new segment (0 = no size limit)
+    int log_rotate_interval;        // Seconds after which a new segment is started (0 = no time limit)
+    int log_keep;                   // Rotated segments to keep (0 = default)
+    char state_path[PATH_MAX];      // Memory mapped live state file (empty = no export)
+    int stagger;                    // Full syncs of pairs added in bulk started per second (0 = default)
+    char control_socket[108];       // UNIX socket for control clients (empty = fss_in/fss_out only, sun_path size)
+    bool spawn_fork;                // Start workers with fork + execv instead of posix_spawn
+    worker_priority priority[PRIORITY_CLASSES];    // Worker priority of all pairs, per priority_class
+};
+
+extern manager_settings settings;
+
+// Parse a number with an optional K/M/G suffix (e.g. "10M"), returns -1 if invalid
+long long parseSizeValue(const char* value);
+
+// Apply a single key=value option to a pair (or to the global settings if entry is NULL)
+// Returns false if the key is unknown or the value is invalid
+bool applySetting(const char* key, const char* value, sync_info_entry* entry);
+
+#endif // SETTINGS_H
\ No newline at end of file
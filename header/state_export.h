@@ -0,0 +1,63 @@
+#ifndef STATE_EXPORT_H
+#define STATE_EXPORT_H
+
+#include <stdint.h>
+#include "../header/message_utils.h"    // for TIMESTAMP_SIZE
+
+struct sync_info_entry;     // see sync_database.h
+
+// State Export: Live copy of sync_info in a memory mapped file (@state_file) for external tools (fss_state)
+// The manager updates it in place at most every STATE_INTERVAL_MS, readers map the file and copy it out:
+//   state_header | state_entry + source + target | state_entry + source + target | ...
+// Only the entries of pairs that changed since the last update are written (see markStateDirty()). A pair whose
+// entry became too small, or that was removed, leaves a removed entry behind; the entries are written again
+// from scratch once removed entries take more space than the others
+// Consistency uses a seqlock: sequence is odd while the manager writes, a reader retries until it read
+// the same even sequence before and after copying. The file only grows, so a mapping never becomes invalid
+
+#define STATE_MAGIC 0x53535346      // "FSSS"
+#define STATE_VERSION 3             // Changed whenever the layout changes
+#define STATE_INTERVAL_MS 100
+
+struct state_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sequence;          // Seqlock counter, odd while an update is in progress
+    uint64_t generation;        // Number of updates since the manager started
+    uint64_t file_size;         // Mapped size (readers remap when it is larger than theirs)
+    uint64_t data_length;       // Bytes of entries after the header
+    int64_t updated;            // time() of the last update
+    int32_t manager_pid;        // 0 once the manager has shut down
+    uint32_t count;             // Number of entries (without the removed ones)
+    int32_t queued_tasks;       // Tasks waiting in the queue (all pairs)
+    int32_t active_workers;
+};
+
+// One pair, followed by the source and target directories (NUL terminated)
+struct state_entry {
+    uint32_t length;            // Size of the entry including the strings, multiple of 8 (the strings may not fill it)
+    uint32_t source_length;     // Without the NUL
+    uint32_t target_length;
+    int32_t error_count;
+    int32_t queued_tasks;       // Tasks of the pair waiting in the queue
+    int16_t active;             // 1 = monitored
+    int16_t removed;            // 1 = left behind by a removed or moved pair, readers skip it
+    int64_t last_sync;          // Time of the last finished task (0 = never)
+};
+
+// Create (or reuse) the state file, returns false on error
+bool openStateExport(const char* path);
+
+// Record that the exported fields of a pair changed (or that it was added), written by the next exportState()
+void markStateDirty(const sync_info_entry* info);
+
+// Record that a pair is being removed (before its index can be reused)
+void markStateRemoved(const sync_info_entry* info);
+
+// Write the changed pairs into the state file if STATE_INTERVAL_MS has passed (force = now)
+void exportState(bool force);
+
+// Write the final state, mark the manager as stopped and unmap the file
+void closeStateExport();
+
+#endif // STATE_EXPORT_H
\ No newline at end of file
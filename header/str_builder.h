@@ -0,0 +1,53 @@
+#ifndef STR_BUILDER_H
+#define STR_BUILDER_H
+
+#include <stddef.h>
+
+// str_builder: String builder for messages, backed by a buffer inside the builder (on the caller's stack)
+// A message that does not fit moves to a block of a small arena that is kept for reuse after sbFree(),
+// so once the arena has grown to the largest message there are no more heap allocations
+// Not thread safe (the arena is shared), meant for the manager's loop and the console
+
+// Size of the buffer inside the builder
+#define SB_STACK_SIZE 512
+
+struct str_builder {
+    char* data;             // stack, an arena block or (if the arena is in use) malloc'd memory
+    size_t length;
+    size_t capacity;
+    int block;              // Arena block in use (-1 = stack, -2 = malloc'd)
+    char stack[SB_STACK_SIZE];
+};
+
+// Start an empty builder
+void sbInit(str_builder* sb);
+
+// Give back the arena block (or heap memory) of the builder, it can be used again after sbInit()
+void sbFree(str_builder* sb);
+
+// Empty the builder, keeping its memory
+void sbReset(str_builder* sb);
+
+// The built string (always NUL terminated)
+const char* sbString(const str_builder* sb);
+
+// Length of the built string
+size_t sbLength(const str_builder* sb);
+
+// Append text (NULL appends nothing)
+void sbAppend(str_builder* sb, const char* text);
+
+// Append length bytes of text
+void sbAppendLength(str_builder* sb, const char* text, size_t length);
+
+// Append a single character
+void sbAppendChar(str_builder* sb, char c);
+
+// Append a number in decimal
+void sbAppendInt(str_builder* sb, long long value);
+void sbAppendUnsigned(str_builder* sb, unsigned long long value);
+
+// Append printf-style formatted text (for floating point and padded numbers)
+void sbAppendFormat(str_builder* sb, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+#endif // STR_BUILDER_H
\ No newline at end of file
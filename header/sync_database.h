@@ -3,39 +3,137 @@
 
 #include <limits.h>
 #include <stdbool.h>
-#include <unordered_map>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include <vector>
 #include <string>
 #include "../header/message_utils.h"    // for TIMESTAMP_SIZE
+#include "../header/throttle.h"         // for token_bucket
+#include "../header/metrics.h"          // for pair_latency
+#include "../header/priority.h"         // for worker_priority
 
-// sync database: Manages synchronization information for directories using unordered map (stl)
+// sync database: Manages synchronization information for directories in a compact registry
+// Entries live in fixed chunks (pointers stay valid until the pair is removed), the paths are interned in an arena
+// and an open addressing table finds a pair by its source (or by its inotify watch) with a single probe
 
 #define CONFIG_BUF_S (2*PATH_MAX+8)
 
+// Results of parseConfigLine()
+#define CONFIG_PAIR 1       // A pair was added
+#define CONFIG_SKIPPED 0    // Empty line, comment or global option
+#define CONFIG_ERROR -1     // Directory does not exist or is not accessible
+#define CONFIG_REJECTED -2  // Invalid format or duplicate source
+
+// Progress of a running full sync, from the PROGRESS lines of its worker
+struct sync_progress {
+    pid_t pid;                  // Worker that reports it
+    uint64_t started_ns;        // When the worker was started (monotonic clock)
+    uint64_t updated_ns;        // When the last PROGRESS line was read
+    long long files_done;       // Files copied or skipped so far
+    long long files_total;      // Files in the source directory (counted by the worker before it starts copying)
+    long long bytes_done;       // Bytes copied so far
+    long long bytes_total;      // Size of those files
+};
+
 struct sync_info_entry {
-    char* source_dir;
+    char* source_dir;           // Key of the pair (interned, see setSyncTarget() to change the target)
     char* target_dir;
-    char* last_sync_time;
+    time_t last_sync;           // Time of the last finished task (0 = never), see formatSyncTime()
+    uint32_t index;             // Position in the registry, the id of the pair (reused once the pair is removed)
+    int wd;                     // Inotify watch (-1 = inactive), changed with setSyncWatch()
+    bool from_config;           // Pair of the config file (not added with add/addfile), removed by a reload without it
+    uint64_t options_hash;      // Options of the pair's config line (see hashConfigOptions()), 0 = none
     int error_count;
-    int wd;
+    int queued_tasks;           // Tasks of this pair waiting in the queue (or spill file)
+    int rescan_count;           // Full syncs queued because inotify events were lost
+    long long limit_bps;        // Bytes/s limit for this pair (0 = unlimited)
+    long long limit_fps;        // Files/s limit for this pair (0 = unlimited)
+    token_bucket fps_bucket;    // Files/s bucket used when dispatching tasks
+    long long throttled_ms;     // Total time tasks of this pair spent throttled
+    uint64_t collapse_task_id;  // Full sync that replaced the pair's backlog (0 = none)
+    long long bytes_copied;     // Bytes copied by the workers of this pair
+    long long files_copied;     // Files copied by the workers of this pair
+    long long tasks_completed;  // Tasks of this pair that finished
+    long long tasks_failed;     // Tasks of this pair that finished with PARTIAL or ERROR status
+    pair_latency* latency;      // Stage latency histograms (allocated when the first task finishes)
+    task_usage* usage;          // Resources used by the pair's workers (allocated when the first task finishes)
+    worker_priority* priority;  // Worker priority per priority_class (allocated when a priority option is set)
+    sync_progress* progress;    // Progress of the running full sync (NULL = none running)
 };
 
-extern std::unordered_map<std::string, sync_info_entry> sync_info;
+// The registry of all pairs, iterated with: for (sync_info_entry& info : sync_info)
+// Pairs must not be added or removed while iterating
+struct sync_registry {
+    struct iterator {
+        uint32_t index;
+        sync_info_entry& operator*() const;
+        iterator& operator++();
+        bool operator!=(const iterator& other) const { return index != other.index; }
+    };
+    iterator begin() const;
+    iterator end() const;
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+};
+
+// A pair line of the config file (see readConfigPairs())
+struct config_pair {
+    std::string source;
+    std::string target;
+    std::string options;    // key=value options after the directories
+    int line_num;
+};
+
+extern sync_registry sync_info;
+
+// Parse a single config line ("<source> <target> [key=value ...]" or "@key=value") and add its pair to the map
+// Global options are only applied if global_options is set, added is set to the new entry (if not NULL)
+int parseConfigLine(char* line, int line_num, bool global_options, sync_info_entry** added);
 
 // Insert directories from config file into the map
 int readConfig(const char* config_path);
 
-// Add source directory to map
-void addSyncInfo(const char* source, const char* target);
+// Read the pairs of a config file without changing the map (global options are skipped)
+// Returns the number of invalid lines (wrong format, missing directory, duplicate source) or -1 if it cannot be read
+int readConfigPairs(const char* config_path, std::vector<config_pair>* pairs);
+
+// Apply the key=value options of a config line to a pair (or to the global settings if entry is NULL)
+void applyLineSettings(char* options, sync_info_entry* entry, int line_num);
+
+// Hash of the options of a config line, the same for lines that only differ in spacing (0 = no options)
+uint64_t hashConfigOptions(const char* options);
+
+// Add source directory to map, returns the new entry (NULL if source is already there or memory ran out)
+sync_info_entry* addSyncInfo(const char* source, const char* target);
 
 // Get directory info
 sync_info_entry* getSyncInfo(const char* directory);
 
+// Get the pair that owns an inotify watch
+sync_info_entry* getSyncInfoByWatch(int wd);
+
+// Get a pair by its index (the id tasks refer to it with), NULL if the pair was removed
+sync_info_entry* getSyncInfoById(uint32_t index);
+
+// Set the inotify watch of a pair (-1 = inactive)
+void setSyncWatch(sync_info_entry* entry, int wd);
+
+// Change the target directory of a pair, returns false if memory ran out
+bool setSyncTarget(sync_info_entry* entry, const char* target);
+
 // Remove directory from map
 void rmvSyncInfo(const char* directory);
 
-// Pass information of a single entry into dynamically allocated buffer
-// Returns NULL if entry not found
-char* copySyncInfo(const char* directory);
+// Give back the arena space of removed and changed paths once it is more than the paths in use
+// Moves the paths, so it must be called where no source_dir/target_dir pointers are kept (e.g. the manager loop)
+void compactSyncInfo();
+
+// Format a last sync time for output ("Never" if 0), buffer must hold TIMESTAMP_SIZE bytes
+void formatSyncTime(time_t when, char* buffer);
+
+// Append the information of a single entry to a message
+void appendSyncInfo(str_builder* msg, const sync_info_entry* info);
 
 // Print content of all entries in sync_info
 void printAllSyncInfo();
@@ -0,0 +1,38 @@
+#ifndef TASK_JOURNAL_H
+#define TASK_JOURNAL_H
+
+#include <stdint.h>
+#include "../header/task_manager.h"     // for task_t
+
+// Task Journal: Append-only log of enqueued and completed tasks, used to rebuild the pending work after a crash
+// Records (one per line, fields separated by tabs):
+//   E <id> <operation> <source> <target> <filename>    task was added to the queue
+//   D <id>                                             task was completed (or dropped)
+// Records are buffered and committed together (write + fdatasync) once per loop of the manager
+
+// Open the journal, re-enqueue the tasks that were still pending in it and compact it
+// The replayed tasks are counted in the queued_tasks of their pairs, write errors are reported to log_fd
+// Returns number of tasks replayed or -1 on error
+int openTaskJournal(const char* path, int log_fd);
+
+// Returns true if the journal is open
+bool isTaskJournalOpen();
+
+// Record that a task was added to the queue
+void journalTaskAdded(const task_t* task);
+
+// Record that a task was completed or dropped
+void journalTaskDone(uint64_t task_id);
+
+// Commit buffered records to disk and compact the journal if it grew too big
+// If the commit fails the journal is cut back to its last complete record and the records are kept for the next
+// commit, after repeated failures in a row the journal is disabled (both are written to the log)
+void flushTaskJournal();
+
+// Rewrite the journal so that it only contains the tasks still pending
+void compactTaskJournal();
+
+// Commit, compact and close the journal
+void closeTaskJournal();
+
+#endif // TASK_JOURNAL_H
\ No newline at end of file
@@ -1,8 +1,9 @@
 #ifndef TASK_MANAGER_H
 #define TASK_MANAGER_H
 
-#include <queue>
+#include <deque>
 #include <string>
+#include <stdint.h>
 #include <unistd.h>
 #include <limits.h>
 #include <signal.h>
@@ -10,42 +11,104 @@
 
 // Task Manager: Functions related to managing the task queue and worker processes
 
-// Sync operation structure
+struct sync_info_entry;     // see sync_database.h
+
+// Operation of a task (the worker gets it by name, see taskOpName())
+enum task_op : uint8_t {
+    OP_ADDED,
+    OP_MODIFIED,
+    OP_DELETED,
+    OP_FULL,        // Full sync of the pair
+    OP_SYNC,        // Full sync requested with the sync command (reports "Sync completed")
+    TASK_OPS
+};
+
+// Sync operation structure (copied by value, the filename belongs to the task pool)
 typedef struct {
-    char* source;       // Source directory path
-    char* target;       // Target directory path
-    char* filename;     // File to synchronize (empty for full sync)
-    char* operation;    // Operation type: ADDED, MODIFIED, DELETED, FULL or SYNC
+    uint64_t id;        // Unique id of the task (used by the task journal)
+    uint32_t pair;      // Pair of the task (sync_info_entry::index, see getSyncInfoById())
+    task_op op;
+    uint8_t name_class; // Size class of filename in the task pool
+    char* filename;     // File to synchronize ("ALL" for full sync)
+    uint64_t throttled_since;   // When the task was first held back by a files/s limit (0 = never)
+    uint64_t event_ns;          // When the inotify event that caused the task was read (= enqueued_ns for other tasks)
+    uint64_t enqueued_ns;       // When the task was queued (monotonic clock)
 } task_t;
 
-// Worker process structure
+// Worker process structure (a slot of the active worker table)
 typedef struct {
-    pid_t pid;           // Process ID of worker
+    pid_t pid;           // Process ID of worker (0 = free slot)
     int pipe_fd;         // File descriptor for reading worker output
+    int limits_fd;       // File descriptor for sending the worker new limits (its stdin)
+    double bps, fps;     // Limits the worker was given last (0 = unlimited)
     task_t task;         // The task this worker is processing
+    char* target_dir;    // Target the worker copies to (in the task pool, the pair's target may change meanwhile)
+    uint8_t target_class;    // Size class of target_dir in the task pool
+    uint64_t dispatched_ns;  // When the worker was started (monotonic clock)
+    int position;        // Index of the slot in the list of running workers
 } worker_info_t;
 
 extern volatile sig_atomic_t worker_finished_flag;
 
-// Initialize worker management system
-void initWorkerManager(int max_workers);
+// Initialize worker management system (queue events like collapsed backlogs are written to log_fd)
+void initWorkerManager(int max_workers, int log_fd);
+
+// Name of an operation ("ADDED", "MODIFIED", "DELETED", "FULL" or "SYNC")
+const char* taskOpName(task_op op);
+
+// Operation of a name, returns false if it is not one
+bool parseTaskOp(const char* name, task_op* op);
+
+// Add a new task for a pair to the queue
+// event_ns is the time of the inotify event that caused the task (0 = now)
+bool addTaskToQueue(sync_info_entry* info, const char* filename, task_op op, bool checkExistingTask, uint64_t event_ns);
+
+// Set the filename of a task (copied into the task pool), returns false if memory ran out
+bool setTaskFilename(task_t* task, const char* filename, size_t length);
+
+// Free all memory allocated for a task
+void freeTaskMemory(task_t* task);
+
+// Queue a full sync that replaces the queued tasks of this pair (used when events were lost)
+// Returns false if such a full sync is already queued
+bool queueRescan(sync_info_entry* info);
 
-// Add a new task to the queue
-bool addTaskToQueue(const char* source, const char* target, const char* filename,
-                    const char* operation, bool checkExistingTask);
+#define STAGGER_RATE 20     // Default of @stagger
 
-// Check if any task is already queued or in progress for this directory
-bool isTaskQueued(const char* directory);
+// Queue the initial full sync of a pair once the stagger rate allows it (@stagger full syncs per second)
+// Used when many pairs are added at once, so their full syncs do not all start together
+void scheduleFullSync(sync_info_entry* info);
+
+// Check if any task is already queued or in progress for this pair
+bool isTaskQueued(const sync_info_entry* info);
 
 // Start worker processes to handle tasks in the queue
 void startWorker();
 
+// Set bytes/s and files/s limits of a pair (or global limits if entry is NULL), 0 = unlimited
+void setThrottleLimits(sync_info_entry* entry, long long bps, long long fps);
+
+// Read the output of the running workers so far (keeps the progress of full syncs up to date)
+void readWorkerOutput();
+
 // Process finished workers and handle their output
 void processFinishedWorker(int fss_out, int log_fd);
     
+// Wait for the active workers to terminate (queued tasks are not started)
+void finishActiveTasks(int fss_out, int log_fd);
+
 // Wait for all active workers to terminate
 void finishTasks(int fss_out, int log_fd);
 
+// Returns number of tasks waiting in the queue (including the spilled and staggered ones)
+int getQueuedTaskCount();
+
+// Returns number of running workers
+int getActiveWorkerCount();
+
+// Call callback for every task that is running or queued (oldest first)
+void forEachPendingTask(void (*callback)(const task_t* task, void* arg), void* arg);
+
 // Free allocated memory for active workers
 void shutdownWorkerManager();
 
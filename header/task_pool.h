@@ -0,0 +1,26 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Task Pool: Storage for the filenames of queued and running tasks
+// Names are kept in blocks of a few fixed sizes (16 to 256 bytes) carved from large chunks and reused through free
+// lists, so queuing a task does not call malloc. Longer names (never from inotify, NAME_MAX is 255) use malloc
+
+#define TASK_NAME_HEAP 0xFF     // Size class of a name allocated with malloc
+
+// Copy name into a pooled block, size_class is set to the block's size class (pass it to freeTaskName())
+// Returns NULL if memory ran out
+char* allocTaskName(const char* name, size_t length, uint8_t* size_class);
+
+// Give a block back to its free list
+void freeTaskName(char* name, uint8_t size_class);
+
+// Bytes used by a name of this class (for the queue memory estimate)
+size_t taskNameSize(const char* name, uint8_t size_class);
+
+// Free every chunk (all names must have been freed)
+void releaseTaskPool();
+
+#endif // TASK_POOL_H
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef TASK_SPILL_H
+#define TASK_SPILL_H
+
+#include "../header/task_manager.h"     // for task_t
+
+// Task Spill: On-disk segment that holds the tail of the task queue when the in-memory queue is full
+// Tasks are written and read back in the same order (FIFO), the file is removed once it is drained
+
+// Append a task to the spill file, returns false on error
+bool spillTask(const task_t* task, const char* spill_path);
+
+// Read the oldest spilled task into task (its filename is allocated, free it with freeTaskMemory())
+// Returns false if there are no spilled tasks
+bool readSpilledTask(task_t* task);
+
+// Returns number of tasks in the spill file
+int getSpilledTaskCount();
+
+// Call callback for every spilled task (oldest first)
+void forEachSpilledTask(void (*callback)(const task_t* task, void* arg), void* arg);
+
+// Close and remove the spill file
+void closeTaskSpill();
+
+#endif // TASK_SPILL_H
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <stdint.h>
+
+// Throttle: Token buckets used to limit bytes/s and files/s (shared by the manager and the worker)
+
+// Token bucket structure (rate 0 means unlimited)
+typedef struct {
+    double rate;            // Tokens added per second
+    double burst;           // Maximum tokens that can be stored
+    double tokens;          // Currently available tokens (negative means debt)
+    uint64_t last_refill;   // Monotonic time of last refill (ns)
+} token_bucket;
+
+// Returns monotonic clock time in nanoseconds
+uint64_t getMonotonicNs();
+
+// Initialize bucket with a rate (tokens/s, may be a fraction), burst is one second worth of tokens
+void initTokenBucket(token_bucket* bucket, double rate);
+
+// Change rate of an existing bucket (keeps the tokens already stored)
+void setTokenBucketRate(token_bucket* bucket, double rate);
+
+// Take n tokens only if they are available right now, returns false otherwise
+bool tryConsumeTokens(token_bucket* bucket, double n);
+
+// Take n tokens without waiting (the bucket goes into debt if they are not there)
+void chargeTokens(token_bucket* bucket, double n);
+
+// Take n tokens and sleep until the debt is paid back, or until wake_fd is readable (-1 = never)
+// After a wake up the bucket may still be in debt, call again with n = 0 to wait for the rest
+// Returns the time spent sleeping in nanoseconds
+uint64_t consumeTokens(token_bucket* bucket, double n, int wake_fd);
+
+#endif // THROTTLE_H
\ No newline at end of file
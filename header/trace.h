@@ -0,0 +1,26 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Trace: Optional Chrome/Perfetto trace-event JSON of the manager's loop and task lifecycle (@trace_file)
+// Spans of the manager loop are on the manager's track, spans of a task are on the track of its worker (tid = worker PID)
+// Callers check trace_enabled before taking timestamps, so a disabled trace costs one branch
+
+extern bool trace_enabled;
+
+// Open the trace file and enable tracing, returns false on error
+bool openTrace(const char* path);
+
+// Write a complete span (timestamps from getMonotonicNs()), tid 0 = manager track
+// arg_name/arg_value add a single string argument to the span (arg_name NULL = none)
+void traceSpan(const char* name, const char* category, int tid, uint64_t start_ns, uint64_t end_ns,
+               const char* arg_name, const char* arg_value);
+
+// Name the track of a worker
+void traceTrackName(int tid, const char* name);
+
+// Finish the JSON array and close the trace file
+void closeTrace();
+
+#endif // TRACE_H
\ No newline at end of file
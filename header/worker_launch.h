@@ -0,0 +1,22 @@
+#ifndef WORKER_LAUNCH_H
+#define WORKER_LAUNCH_H
+
+#include <sys/types.h>
+
+// Worker Launch: Starts worker processes with their stdin and stdout connected to pipes
+// posix_spawn (the default) starts the child with vfork semantics: it borrows the manager's memory until it execs,
+// so the launch does not copy page tables and its cost does not grow with the manager's heap (sync_info, queue)
+// fork + execv is kept for comparison (@spawn=fork)
+
+enum spawn_method { SPAWN_POSIX, SPAWN_FORK };
+
+// Absolute path of the worker executable, next to the running binary (/proc/self/exe)
+// Falls back to ./bin/worker if it is not found there, resolved once and valid for the whole run
+const char* resolveWorkerPath();
+
+// Start path with args (args[0] = path, NULL terminated), stdin_fd becomes the child's stdin and stdout_fd its stdout
+// Both should be close-on-exec (e.g. pipe2(O_CLOEXEC)), so the child only keeps its own pipes
+// Returns the pid or -1 on error (errno set, e.g. ENOENT if the worker cannot be executed with posix_spawn)
+pid_t launchWorker(const char* path, char* const args[], int stdin_fd, int stdout_fd, spawn_method method);
+
+#endif // WORKER_LAUNCH_H
\ No newline at end of file
@@ -3,375 +3,549 @@
 #include "../header/message_utils.h"
 #include "../header/monitor_manager.h"
 #include "../header/task_manager.h"
+#include "../header/settings.h"
+#include "../header/task_journal.h"
+#include "../header/metrics.h"
+#include "../header/log_index.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <limits.h>
+#include <vector>
+#include <string>
+#include <unordered_set>
+
+///// HELPER FUNCTIONS /////
+
+// Print a message on the manager's terminal, send it to the console (and to the log if log_fd > 0) and free it
+static void sendMessage(str_builder* msg, int fss_out, int log_fd) {
+    printf("%s", sbString(msg));
+    forwardMessage(sbString(msg), fss_out, log_fd);
+    sbFree(msg);
+}
+
+// Reply "<text><source>" to the console only
+static void sendNotice(const char* text, const char* source, int fss_out) {
+    str_builder msg;
+    startMessage(&msg);
+    sbAppend(&msg, text);
+    sbAppend(&msg, source);
+    sbAppendChar(&msg, '\n');
+    sendMessage(&msg, fss_out, -1);
+}
+
+// Start the "Added directory" and "Monitoring started" lines of a pair
+static void startMonitoringMessage(str_builder* msg, const char* source, const char* target) {
+    startMessage(msg);
+    sbAppend(msg, "Added directory: ");
+    sbAppend(msg, source);
+    sbAppend(msg, " -> ");
+    sbAppend(msg, target);
+    sbAppendChar(msg, '\n');
+    appendTimestamp(msg, NULL);
+    sbAppend(msg, "Monitoring started for ");
+    sbAppend(msg, source);
+    sbAppendChar(msg, '\n');
+}
+
+// Report a pair whose monitoring started ("Added directory" and "Monitoring started" lines)
+static void sendMonitoringStarted(const char* source, const char* target, int fss_out, int log_fd) {
+    str_builder msg;
+    startMonitoringMessage(&msg, source, target);
+    sendMessage(&msg, fss_out, log_fd);
+    indexMonitoring(source, true);
+}
+
+// Write a message to the log only and free it
+static void logMessage(str_builder* msg, int log_fd) {
+    forwardMessage(sbString(msg), -1, log_fd);
+    sbFree(msg);
+}
+
+// Start monitoring a pair added in bulk: its lines only go to the log and its full sync is staggered
+// Returns false (and removes the pair) if it cannot be monitored
+static bool startBulkPair(sync_info_entry* info, int log_fd, int inotify_fd) {
+    setSyncWatch(info, addDirToMonitor(inotify_fd, info->source_dir));
+    if (info->wd < 0) {
+        rmvSyncInfo(info->source_dir);
+        return false;
+    }
+
+    str_builder msg;
+    startMonitoringMessage(&msg, info->source_dir, info->target_dir);
+    logMessage(&msg, log_fd);
+    indexMonitoring(info->source_dir, true);
+    scheduleFullSync(info);
+    return true;
+}
+
+// Apply the options of a reloaded config line to a pair if they changed, options no longer on the line go back to
+// their defaults. A pair whose line did not change keeps its limits as they are (e.g. set with throttle)
+// Returns true if the options of the line changed
+static bool reloadPairOptions(config_pair& pair, sync_info_entry* info) {
+    uint64_t options_hash = hashConfigOptions(pair.options.c_str());
+    if (options_hash == info->options_hash) return false;
+    info->options_hash = options_hash;
+
+    // The options alone, on a pair that is not registered
+    sync_info_entry options = {};
+    initTokenBucket(&options.fps_bucket, 0);
+    applyLineSettings(&pair.options[0], &options, pair.line_num);
+
+    // Limits are only set if they differ, setting them refills the files/s bucket
+    if (options.limit_bps != info->limit_bps || options.limit_fps != info->limit_fps) {
+        setThrottleLimits(info, options.limit_bps, options.limit_fps);
+    }
+
+    const worker_priority none = {};
+    bool same_priority = true;
+    for (int i = 0; i < PRIORITY_CLASSES && same_priority; i++) {
+        same_priority = samePriority(info->priority ? &info->priority[i] : &none,
+                                     options.priority ? &options.priority[i] : &none);
+    }
+    if (same_priority) {
+        free(options.priority);
+    } else {
+        free(info->priority);
+        info->priority = options.priority;
+    }
+    return true;
+}
+
+///// MAIN FUNCTIONS /////
 
 // Add pair to sync_info and start monitoring it
-void commandAdd(const char* source, const char* target, int fss_out, int log_fd, int inotify_fd) {
-    char* message_buffer = NULL;
+int commandAdd(const char* source, const char* target, int fss_out, int log_fd, int inotify_fd) {
     sync_info_entry* info = getSyncInfo(source);
 
     // Special case for syncCommand():
     // User wants to sync directory but it's inactive -> we reactivate it and do a full
     // sync using "SYNC" operation, to get sync completion message
     if (target == NULL) {
-        info->wd = addDirToMonitor(inotify_fd, source);
+        setSyncWatch(info, addDirToMonitor(inotify_fd, source));
         if (info->wd >= 0) {
-            // Create message about activating/reactivating directory
-            message_buffer = (char*)malloc(strlen(source) + strlen(info->target_dir) + 50);
-            if (message_buffer) {
-                sprintf(message_buffer, "Added directory: %s -> %s\n", source, info->target_dir);
-                message_buffer = addTimestampToMessage(message_buffer, NULL);
-                printf("%s", message_buffer);
-                
-                char* monitor_msg = (char*)malloc(strlen(source) + 40);
-                if (monitor_msg) {
-                    sprintf(monitor_msg, "Monitoring started for %s\n", source);
-                    monitor_msg = addTimestampToMessage(monitor_msg, NULL);
-                    printf("%s", monitor_msg);
-                    if (monitor_msg && message_buffer) {
-                        message_buffer = appendToBuffer(message_buffer, monitor_msg);
-                    }
-                    free(monitor_msg);
-                }
-                
-                // Send messages to console and log
-                forwardMessage(message_buffer, fss_out, log_fd);
-                free(message_buffer);
-            }
-
-            addTaskToQueue(source, info->target_dir, "ALL", "SYNC", false);
-        } else {
-            // Failed to set up monitoring
-            message_buffer = (char*)malloc(strlen(source) + 50);
-            if (message_buffer) {
-                sprintf(message_buffer, "Failed to set up monitoring for %s\n", source);
-                message_buffer = addTimestampToMessage(message_buffer, NULL);
-                printf("%s", message_buffer);
-                if (message_buffer) {
-                    forwardMessage(message_buffer, fss_out, -1);
-                    free(message_buffer);
-                }
-            }
+            // Send messages about activating/reactivating directory to console and log
+            sendMonitoringStarted(source, info->target_dir, fss_out, log_fd);
+            addTaskToQueue(info, "ALL", OP_SYNC, false, 0);
+            return CMD_OK;
         }
-        return;
+        sendNotice("Failed to set up monitoring for ", source, fss_out);
+        return CMD_FAILED;
     }
 
     // Check if directory data exists
     if (info != NULL) {
         // Check if it's already active OR if target directory is different
         if (info->wd >= 0 || strcmp(info->target_dir, target) != 0) {
-            message_buffer = (char*)malloc(strlen(source) + 40);
-            if (message_buffer) {
-                sprintf(message_buffer, "Already in queue: %s\n", source);
-                message_buffer = addTimestampToMessage(message_buffer, NULL);
-                printf("%s", message_buffer);
-                if (message_buffer) {
-                    forwardMessage(message_buffer, fss_out, -1);
-                    free(message_buffer);
-                }
-            }
-            return;
+            sendNotice("Already in queue: ", source, fss_out);
+            return CMD_FAILED;
         }
     } else {
         // New directory - add to map
-        addSyncInfo(source, target);
-        info = getSyncInfo(source);
-        if (!info) return;  // Should never happen, but just in case
+        info = addSyncInfo(source, target);
+        if (!info) return CMD_FAILED;  // Out of memory
     }
     
     // Set up inotify watch
-    info->wd = addDirToMonitor(inotify_fd, source);
+    setSyncWatch(info, addDirToMonitor(inotify_fd, source));
     if (info->wd >= 0) {
-        message_buffer = (char*)malloc(strlen(source) + strlen(target) + 100);
-        if (message_buffer) {
-            sprintf(message_buffer, "Added directory: %s -> %s\n", source, target);
-            message_buffer = addTimestampToMessage(message_buffer, NULL);
-            printf("%s", message_buffer);
-            
-            char* monitor_msg = (char*)malloc(strlen(source) + 40);
-            if (monitor_msg) {
-                sprintf(monitor_msg, "Monitoring started for %s\n", source);
-                monitor_msg = addTimestampToMessage(monitor_msg, NULL);
-                printf("%s", monitor_msg);
-                
-                if (monitor_msg && message_buffer) {
-                    message_buffer = appendToBuffer(message_buffer, monitor_msg);
-                }
-                free(monitor_msg);
-            }
-            
-            if (message_buffer) {
-                forwardMessage(message_buffer, fss_out, log_fd);
-                free(message_buffer);
-            }
-        }
+        sendMonitoringStarted(source, target, fss_out, log_fd);
         
         // Queue a full sync task for the newly added directory
-        addTaskToQueue(source, target, "ALL", "FULL", false);
-    } else {
-        // Failed to set up monitoring
-        message_buffer = (char*)malloc(strlen(source) + 50);
-        if (message_buffer) {
-            sprintf(message_buffer, "Failed to set up monitoring for %s\n", source);
-            message_buffer = addTimestampToMessage(message_buffer, NULL);
-            printf("%s", message_buffer);
-            if (message_buffer) {
-                forwardMessage(message_buffer, fss_out, -1);
-                free(message_buffer);
-            }
+        addTaskToQueue(info, "ALL", OP_FULL, false, 0);
+        return CMD_OK;
+    }
+    sendNotice("Failed to set up monitoring for ", source, fss_out);
+    return CMD_FAILED;
+}
+
+// Add every pair of a file (config format) and start monitoring them, with one summary instead of a reply per pair
+int commandAddFile(const char* path, int fss_out, int log_fd, int inotify_fd) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        sendNotice("Cannot open pair file: ", path, fss_out);
+        return CMD_FAILED;
+    }
+
+    int added = 0, rejected = 0, unmonitored = 0;
+    int line_num = 0;
+    char line[CONFIG_BUF_S];
+    while (fgets(line, sizeof(line), file)) {
+        line_num++;
+        sync_info_entry* info = NULL;
+        int result = parseConfigLine(line, line_num, false, &info);
+        if (result == CONFIG_ERROR || result == CONFIG_REJECTED) rejected++;
+        if (result != CONFIG_PAIR) continue;
+
+        // The log (and its index) still get the lines of every pair, the console only the summary
+        if (startBulkPair(info, log_fd, inotify_fd)) added++;
+        else unmonitored++;
+    }
+    fclose(file);
+
+    str_builder msg;
+    startMessage(&msg);
+    sbAppendFormat(&msg, "Added %d directories from %s", added, path);
+    if (rejected || unmonitored) {
+        sbAppendFormat(&msg, " (%d lines rejected, %d could not be monitored)", rejected, unmonitored);
+    }
+    sbAppendFormat(&msg, ", full syncs staggered at %d/s\n", settings.stagger > 0 ? settings.stagger : STAGGER_RATE);
+    sendMessage(&msg, fss_out, log_fd);
+    return rejected || unmonitored ? CMD_FAILED : CMD_OK;
+}
+
+// Apply the pairs of the config file again: add new pairs, cancel removed ones and update changed targets
+int commandReload(const char* config_path, int fss_out, int log_fd, int inotify_fd) {
+    str_builder msg;
+
+    // Nothing changes unless the whole file is valid (a missing line would cancel its pair)
+    std::vector<config_pair> pairs;
+    int invalid = readConfigPairs(config_path, &pairs);
+    if (invalid != 0) {
+        startMessage(&msg);
+        if (invalid < 0) sbAppendFormat(&msg, "Config not reloaded, cannot read %s\n", config_path);
+        else sbAppendFormat(&msg, "Config not reloaded, %d invalid lines in %s\n", invalid, config_path);
+        sendMessage(&msg, fss_out, log_fd);
+        return CMD_FAILED;
+    }
+
+    int added = 0, retargeted = 0, removed = 0, kept = 0, updated = 0, unchanged = 0, unmonitored = 0;
+    std::unordered_set<std::string> configured;
+    for (config_pair& pair : pairs) {
+        const char* source = pair.source.c_str();
+        const char* target = pair.target.c_str();
+        configured.insert(pair.source);
+
+        // New pair, started like the pairs of addfile
+        sync_info_entry* info = getSyncInfo(source);
+        if (!info) {
+            info = addSyncInfo(source, target);
+            if (!info) continue;
+            info->from_config = true;
+            info->options_hash = hashConfigOptions(pair.options.c_str());   // Before applyLineSettings() splits them
+            applyLineSettings(&pair.options[0], info, pair.line_num);
+            if (startBulkPair(info, log_fd, inotify_fd)) added++;
+            else unmonitored++;
+            continue;
         }
+
+        // A pair added with add/addfile that is now in the file belongs to the config from now on
+        info->from_config = true;
+
+        // Same pair, its watch and queue are left as they are, its options are applied again if its line changed
+        bool options_changed = reloadPairOptions(pair, info);
+        if (strcmp(info->target_dir, target) == 0) {
+            if (options_changed) updated++;
+            else unchanged++;
+            continue;
+        }
+
+        // New target, queued tasks are copied to it (running workers finish on the old one and are logged with it)
+        if (!setSyncTarget(info, target)) {
+            perror("Memory allocation failed in commandReload");
+            continue;
+        }
+
+        startMessage(&msg);
+        sbAppend(&msg, "Target changed: ");
+        sbAppend(&msg, source);
+        sbAppend(&msg, " -> ");
+        sbAppend(&msg, target);
+        sbAppendChar(&msg, '\n');
+        logMessage(&msg, log_fd);
+        if (info->wd >= 0) addTaskToQueue(info, "ALL", OP_FULL, false, 0);
+        retargeted++;
+    }
+
+    // Pairs of the previous config that are no longer in it (pairs added with add/addfile stay)
+    std::vector<std::string> missing;
+    for (const sync_info_entry& info : sync_info) {
+        if (info.from_config && !configured.count(info.source_dir)) missing.push_back(info.source_dir);
     }
+    for (const std::string& source : missing) {
+        sync_info_entry* info = getSyncInfo(source.c_str());
+        if (info->wd >= 0 && rmvDirFromMonitor(inotify_fd, info->wd) >= 0) {
+            setSyncWatch(info, -1);
+            startMessage(&msg);
+            sbAppend(&msg, "Monitoring stopped for ");
+            sbAppend(&msg, info->source_dir);
+            sbAppendChar(&msg, '\n');
+            logMessage(&msg, log_fd);
+            indexMonitoring(info->source_dir, false);
+        }
+
+        // A pair with tasks left stays (inactive) until the next reload or a delete
+        if (info->wd < 0 && !isTaskQueued(info)) {
+            rmvSyncInfo(source.c_str());
+            startMessage(&msg);
+            sbAppend(&msg, "Directory deleted: ");
+            sbAppend(&msg, source.c_str());
+            sbAppendChar(&msg, '\n');
+            logMessage(&msg, log_fd);
+            removed++;
+        } else {
+            kept++;
+        }
+    }
+
+    startMessage(&msg);
+    sbAppendFormat(&msg, "Config reloaded from %s: %d added, %d removed, %d targets changed, %d options updated, "
+                   "%d unchanged", config_path, added, removed, retargeted, updated, unchanged);
+    if (kept) sbAppendFormat(&msg, ", %d removed pairs kept until their tasks finish", kept);
+    if (unmonitored) sbAppendFormat(&msg, " (%d could not be monitored)", unmonitored);
+    sbAppendChar(&msg, '\n');
+    sendMessage(&msg, fss_out, log_fd);
+    return unmonitored ? CMD_FAILED : CMD_OK;
+}
+
+// Start monitoring a pair without a full sync (its pending tasks were recovered from the task journal)
+int commandResume(const char* source, int fss_out, int log_fd, int inotify_fd) {
+    sync_info_entry* info = getSyncInfo(source);
+    if (!info) return CMD_FAILED;
+
+    setSyncWatch(info, addDirToMonitor(inotify_fd, source));
+    if (info->wd >= 0) {
+        sendMonitoringStarted(source, info->target_dir, fss_out, log_fd);
+        return CMD_OK;
+    }
+    sendNotice("Failed to set up monitoring for ", source, fss_out);
+    return CMD_FAILED;
 }
 
 // Stop monitoring directory 
-void commandCancel(const char* source, int fss_out, int log_fd, int inotify_fd) {
-    char* message_buffer = NULL;
-    
+int commandCancel(const char* source, int fss_out, int log_fd, int inotify_fd) {
     sync_info_entry* info = getSyncInfo(source);
     if (info == NULL || info->wd < 0) {  // If NOT found in map or inactive
-        message_buffer = (char*)malloc(strlen(source) + 40);
-        if (message_buffer) {
-            sprintf(message_buffer, "Directory not monitored: %s\n", source);
-            message_buffer = addTimestampToMessage(message_buffer, NULL);
-            printf("%s", message_buffer);
-            if (message_buffer) {
-                forwardMessage(message_buffer, fss_out, -1);
-                free(message_buffer);
-            }
-        }
-    } else if (isTaskQueued(source)) {
-        message_buffer = (char*)malloc(strlen(source) + 50);
-        if (message_buffer) {
-            sprintf(message_buffer, "Directory is currently being synced: %s\n", source);
-            message_buffer = addTimestampToMessage(message_buffer, NULL);
-            printf("%s", message_buffer);
-            if (message_buffer) {
-                forwardMessage(message_buffer, fss_out, -1);
-                free(message_buffer);
-            }
-        }
+        sendNotice("Directory not monitored: ", source, fss_out);
+    } else if (isTaskQueued(info)) {
+        sendNotice("Directory is currently being synced: ", source, fss_out);
     } else {  // Directory exists in map
         if (rmvDirFromMonitor(inotify_fd, info->wd) >= 0) {
-            info->wd = -1;  // Mark as inactive
-            message_buffer = (char*)malloc(strlen(source) + 40);
-            if (message_buffer) {
-                sprintf(message_buffer, "Monitoring stopped for %s\n", source);
-                message_buffer = addTimestampToMessage(message_buffer, NULL);
-                printf("%s", message_buffer);
-                if (message_buffer) {
-                    forwardMessage(message_buffer, fss_out, log_fd);
-                    free(message_buffer);
-                }
-            }
-        } else {
-            message_buffer = (char*)malloc(strlen(source) + 50);
-            if (message_buffer) {
-                sprintf(message_buffer, "Failed to stop monitoring for %s\n", source);
-                message_buffer = addTimestampToMessage(message_buffer, NULL);
-                printf("%s", message_buffer);
-                if (message_buffer) {
-                    forwardMessage(message_buffer, fss_out, -1);
-                    free(message_buffer);
-                }
-            }
+            setSyncWatch(info, -1);  // Mark as inactive
+            str_builder msg;
+            startMessage(&msg);
+            sbAppend(&msg, "Monitoring stopped for ");
+            sbAppend(&msg, source);
+            sbAppendChar(&msg, '\n');
+            sendMessage(&msg, fss_out, log_fd);
+            indexMonitoring(source, false);
+            return CMD_OK;
         }
+        sendNotice("Failed to stop monitoring for ", source, fss_out);
     }
+    return CMD_FAILED;
 }
 
 // Show status of directory (use "all" to print all directories)
-void commandStatus(const char* source, int fss_out) {
-    char* message_buffer = NULL;
-    char* entry_buffer = NULL;
+int commandStatus(const char* source, int fss_out) {
+    str_builder msg;
 
     if (strcmp(source, "all") == 0) {   // Print all directories (testing purpose only)
         printAllSyncInfo();
-        message_buffer = strdup("All directories printed to manager console\n");
-        if (message_buffer) {
-            message_buffer = addTimestampToMessage(message_buffer, NULL);
-            printf("%s", message_buffer);
-            if (message_buffer) {
-                forwardMessage(message_buffer, fss_out, -1);
-                free(message_buffer);
-            }
-        }
-        return;
+        startMessage(&msg);
+        sbAppend(&msg, "All directories printed to manager console (inotify overflows: ");
+        sbAppendInt(&msg, inotify_overflow_count);
+        sbAppend(&msg, ")\n");
+        appendOpUsage(&msg);
+        sendMessage(&msg, fss_out, -1);
+        return CMD_OK;
     }
     
     sync_info_entry* info = getSyncInfo(source);
     if (info == NULL) {    // Directory not found in map
-        message_buffer = (char*)malloc(strlen(source) + 40);
-        if (message_buffer) {
-            sprintf(message_buffer, "Directory not monitored: %s\n", source);
-            message_buffer = addTimestampToMessage(message_buffer, NULL);
-            printf("%s", message_buffer);
-            if (message_buffer) {
-                forwardMessage(message_buffer, fss_out, -1);
-                free(message_buffer);
-            }
-        }
-    } else {    // Directory exists
-        entry_buffer = copySyncInfo(source);
-        if (entry_buffer) { // Check if buffer was returned successfully
-            message_buffer = (char*)malloc(strlen(source) + 40);
-            if (message_buffer) {
-                sprintf(message_buffer, "Status requested for %s\n", source);
-                message_buffer = addTimestampToMessage(message_buffer, NULL);
-                if (message_buffer) {
-                    printf("%s", message_buffer);
-                    printf("%s", entry_buffer);
-                    
-                    // Append entry details to message
-                    message_buffer = appendToBuffer(message_buffer, entry_buffer);
-                    if (message_buffer) {
-                        forwardMessage(message_buffer, fss_out, -1);
-                        free(message_buffer);
-                    }
-                }
-            }
-            // Free the entry buffer since copySyncInfo now allocates it dynamically
-            free(entry_buffer);
-        } else {
-            message_buffer = (char*)malloc(strlen(source) + 50);
-            if (message_buffer) {
-                sprintf(message_buffer, "Error retrieving status for %s\n", source);
-                message_buffer = addTimestampToMessage(message_buffer, NULL);
-                if (message_buffer) {
-                    forwardMessage(message_buffer, fss_out, -1);
-                    free(message_buffer);
-                }
-            }
-        }
+        sendNotice("Directory not monitored: ", source, fss_out);
+        return CMD_FAILED;
     }
+
+    // Directory exists, append the entry details to the message
+    startMessage(&msg);
+    sbAppend(&msg, "Status requested for ");
+    sbAppend(&msg, source);
+    sbAppendChar(&msg, '\n');
+    appendSyncInfo(&msg, info);
+    sendMessage(&msg, fss_out, -1);
+    return CMD_OK;
+}
+
+// Show metrics of directory (use "all" for the metrics of the whole manager)
+int commandStats(const char* source, int fss_out) {
+    str_builder stats;
+    sbInit(&stats);
+    if (!appendStats(&stats, source)) {    // Directory not found in map
+        sbFree(&stats);
+        sendNotice("Directory not monitored: ", source, fss_out);
+        return CMD_FAILED;
+    }
+
+    str_builder msg;
+    startMessage(&msg);
+    sbAppend(&msg, "Stats requested for ");
+    sbAppend(&msg, source);
+    sbAppendChar(&msg, '\n');
+    sbAppendLength(&msg, sbString(&stats), sbLength(&stats));
+    sbFree(&stats);
+    sendMessage(&msg, fss_out, -1);
+    return CMD_OK;
 }
 
 // Sync directory
-void commandSync(const char* source, int fss_out, int log_fd, int inotify_fd) {
-    char* message_buffer = NULL;
-    
+int commandSync(const char* source, int fss_out, int log_fd, int inotify_fd) {
     sync_info_entry* info = getSyncInfo(source);
     if (info == NULL) {
-        message_buffer = (char*)malloc(strlen(source) + 40);
-        if (message_buffer) {
-            sprintf(message_buffer, "Directory not monitored: %s\n", source);
-            message_buffer = addTimestampToMessage(message_buffer, NULL);
-            printf("%s", message_buffer);
-            if (message_buffer) {
-                forwardMessage(message_buffer, fss_out, -1);
-                free(message_buffer);
-            }
-        }
-    } else if (info->wd < 0) {
-        commandAdd(source, NULL, fss_out, log_fd, inotify_fd);  // Special case, reactivate the directory
-        message_buffer = (char*)malloc(strlen(source) + strlen(info->target_dir) + 40);
-        if (message_buffer) {
-            sprintf(message_buffer, "Syncing directory: %s -> %s\n", source, info->target_dir);
-            message_buffer = addTimestampToMessage(message_buffer, NULL);
-            printf("%s", message_buffer);
-            if (message_buffer) {
-                forwardMessage(message_buffer, fss_out, log_fd);
-                free(message_buffer);
-            }
-        }
-    } else {
-        int log_message = log_fd;
-        if (addTaskToQueue(source, info->target_dir, "ALL", "SYNC", true)) {
-            message_buffer = (char*)malloc(strlen(source) + strlen(info->target_dir) + 40);
-            if (message_buffer) {
-                sprintf(message_buffer, "Syncing directory: %s -> %s\n", source, info->target_dir);
-            }
-        } else {
-            message_buffer = (char*)malloc(strlen(source) + 40);
-            if (message_buffer) {
-                sprintf(message_buffer, "Sync already in progress %s\n", source);
-            }
-            log_message = -1;
-        }
-        
-        if (message_buffer) {
-            message_buffer = addTimestampToMessage(message_buffer, NULL);
-            printf("%s", message_buffer);
-            if (message_buffer) {
-                forwardMessage(message_buffer, fss_out, log_message);
-                free(message_buffer);
-            }
-        }
+        sendNotice("Directory not monitored: ", source, fss_out);
+        return CMD_FAILED;
     }
-}
 
-// Delete directory from sync_info (only if inactive)
-void commandDelete(const char* source, int fss_out, int log_fd) {
-    char* message_buffer = NULL;
+    int log_message = log_fd;
+    int result = CMD_OK;
+    if (info->wd < 0) {
+        result = commandAdd(source, NULL, fss_out, log_fd, inotify_fd);  // Special case, reactivate the directory
+    } else if (!addTaskToQueue(info, "ALL", OP_SYNC, true, 0)) {
+        sendNotice("Sync already in progress ", source, fss_out);
+        return CMD_FAILED;
+    }
+
+    str_builder msg;
+    startMessage(&msg);
+    sbAppend(&msg, "Syncing directory: ");
+    sbAppend(&msg, source);
+    sbAppend(&msg, " -> ");
+    sbAppend(&msg, info->target_dir);
+    sbAppendChar(&msg, '\n');
+    sendMessage(&msg, fss_out, log_message);
+    return result;
+}
 
+// Delete directory from sync_info (only if inactive and without pending tasks, which refer to the pair)
+int commandDelete(const char* source, int fss_out, int log_fd) {
     sync_info_entry* info = getSyncInfo(source);
     if (info == NULL) {
-        message_buffer = (char*)malloc(strlen(source) + 40);
-        if (message_buffer) {
-            sprintf(message_buffer, "Directory not monitored: %s\n", source);
-            message_buffer = addTimestampToMessage(message_buffer, NULL);
-            printf("%s", message_buffer);
-            if (message_buffer) {
-                forwardMessage(message_buffer, fss_out, -1);
-                free(message_buffer);
-            }
-        }
+        sendNotice("Directory not monitored: ", source, fss_out);
+    } else if (info->wd >= 0) {     // Check if it's active or inactive before deleting
+        sendNotice("Active directory cannot be deleted: ", source, fss_out);
+    } else if (isTaskQueued(info)) {
+        sendNotice("Directory is currently being synced: ", source, fss_out);
     } else {
-        // Check if it's active or inactive before deleting
-        if (info->wd >= 0) {
-            message_buffer = (char*)malloc(strlen(source) + 50);
-            if (message_buffer) {
-                sprintf(message_buffer, "Active directory cannot be deleted: %s\n", source);
-                message_buffer = addTimestampToMessage(message_buffer, NULL);
-                printf("%s", message_buffer);
-                if (message_buffer) {
-                    forwardMessage(message_buffer, fss_out, -1);
-                    free(message_buffer);
-                }
-            }
-        } else {
-            rmvSyncInfo(source);            
-            message_buffer = (char*)malloc(strlen(source) + 30);
-            if (message_buffer) {
-                sprintf(message_buffer, "Directory deleted: %s\n", source);
-                message_buffer = addTimestampToMessage(message_buffer, NULL);
-                printf("%s", message_buffer);
-                if (message_buffer) {
-                    forwardMessage(message_buffer, fss_out, log_fd);
-                    free(message_buffer);
-                }
-            }
-        }
+        rmvSyncInfo(source);
+        str_builder msg;
+        startMessage(&msg);
+        sbAppend(&msg, "Directory deleted: ");
+        sbAppend(&msg, source);
+        sbAppendChar(&msg, '\n');
+        sendMessage(&msg, fss_out, log_fd);
+        return CMD_OK;
+    }
+    return CMD_FAILED;
+}
+
+// Set bytes/s and files/s limits of a directory (use "global" for the limits of all workers)
+int commandThrottle(const char* source, const char* bps, const char* fps, int fss_out, int log_fd) {
+    long long bps_limit = parseSizeValue(bps);
+    long long fps_limit = parseSizeValue(fps);
+
+    sync_info_entry* info = NULL;
+    bool global = strcmp(source, "global") == 0;
+    if (!global) info = getSyncInfo(source);
+
+    if (!global && info == NULL) {
+        sendNotice("Directory not monitored: ", source, fss_out);
+        return CMD_FAILED;
+    }
+
+    str_builder msg;
+    startMessage(&msg);
+    int result = CMD_OK;
+    if (bps_limit < 0 || fps_limit < 0) {
+        sbAppend(&msg, "Invalid limits, usage: throttle <source|global> <bytes/s> <files/s>\n");
+        log_fd = -1;
+        result = CMD_INVALID;
+    } else {
+        setThrottleLimits(info, bps_limit, fps_limit);
+        sbAppend(&msg, "Throttle set for ");
+        sbAppend(&msg, source);
+        sbAppend(&msg, ": ");
+        sbAppendInt(&msg, bps_limit);
+        sbAppend(&msg, " bytes/s, ");
+        sbAppendInt(&msg, fps_limit);
+        sbAppend(&msg, " files/s\n");
     }
+    sendMessage(&msg, fss_out, log_fd);
+    return result;
 }
 
 // Shutdown the manager and clean up resources
-void commandShutdown(int fss_out, int log_fd) {
-    char* message_buffer = strdup("Shutting down manager...\n");
-    if (message_buffer) {
-        message_buffer = addTimestampToMessage(message_buffer, NULL);
-        printf("%s", message_buffer);
-        if (message_buffer) {
-            // No need to forward to console (just log)
-            forwardMessage(message_buffer, -1, log_fd);
-            free(message_buffer);
-        }
+// Fast shutdown only waits for the active workers and leaves the queued tasks in the task journal
+int commandShutdown(int fss_out, int log_fd, bool fast) {
+    str_builder msg;
+    startMessage(&msg);
+    sbAppend(&msg, "Shutting down manager...\n");
+    sendMessage(&msg, -1, log_fd);  // No need to forward to console (just log)
+
+    // Fast shutdown needs the journal to keep the queued tasks for the next start
+    if (fast && !isTaskJournalOpen()) {
+        startMessage(&msg);
+        sbAppend(&msg, "No task journal configured, processing all queued tasks instead.\n");
+        sendMessage(&msg, fss_out, log_fd);
+        fast = false;
     }
 
     // Finish tasks
-    finishTasks(fss_out, log_fd);
-
-    message_buffer = strdup("Manager shutdown complete.\n");
-    if (message_buffer) {
-        message_buffer = addTimestampToMessage(message_buffer, NULL);
-        printf("%s", message_buffer);
-        if (message_buffer) {
-            forwardMessage(message_buffer, fss_out, -1);
-            free(message_buffer);
-        }
+    if (fast) {
+        finishActiveTasks(fss_out, log_fd);
+
+        startMessage(&msg);
+        sbAppend(&msg, "Saved ");
+        sbAppendInt(&msg, getQueuedTaskCount());
+        sbAppend(&msg, " queued tasks to the task journal.\n");
+        sendMessage(&msg, fss_out, log_fd);
+    } else {
+        finishTasks(fss_out, log_fd);
     }
+
+    startMessage(&msg);
+    sbAppend(&msg, "Manager shutdown complete.\n");
+    sendMessage(&msg, fss_out, -1);
     
     usleep(100000);  // Sleep for a short time to allow messages to be sent
-}
\ No newline at end of file
+    return CMD_OK;
+}
+
+// Parse a command line and run it
+int executeCommand(const char* line, int fss_out, int log_fd, int inotify_fd, bool* shutdown) {
+    char cmd[16] = "";
+    char src_dir[PATH_MAX] = "";
+    char trg_dir[PATH_MAX] = "";
+    char extra_arg[32] = "";
+    *shutdown = false;
+
+    // Parse command and arguments (paths are limited to PATH_MAX - 1)
+    int parsed_num = sscanf(line, "%15s %4095s %4095s %31s", cmd, src_dir, trg_dir, extra_arg);
+
+    // Check which command was given
+    if (strcmp(cmd, "add") == 0 && parsed_num == 3) {
+        return commandAdd(src_dir, trg_dir, fss_out, log_fd, inotify_fd);
+    } else if (strcmp(cmd, "addfile") == 0 && parsed_num == 2) {
+        return commandAddFile(src_dir, fss_out, log_fd, inotify_fd);
+    } else if (strcmp(cmd, "cancel") == 0 && parsed_num == 2) {
+        return commandCancel(src_dir, fss_out, log_fd, inotify_fd);
+    } else if (strcmp(cmd, "status") == 0 && parsed_num == 2) {
+        return commandStatus(src_dir, fss_out);
+    } else if (strcmp(cmd, "stats") == 0 && parsed_num <= 2) {
+        return commandStats(parsed_num == 2 ? src_dir : "all", fss_out);
+    } else if (strcmp(cmd, "sync") == 0 && parsed_num == 2) {
+        return commandSync(src_dir, fss_out, log_fd, inotify_fd);
+    } else if (strcmp(cmd, "delete") == 0 && parsed_num == 2) {
+        return commandDelete(src_dir, fss_out, log_fd);
+    } else if (strcmp(cmd, "throttle") == 0 && parsed_num == 4) {
+        return commandThrottle(src_dir, trg_dir, extra_arg, fss_out, log_fd);
+    } else if (strcmp(cmd, "shutdown") == 0 &&
+               (parsed_num == 1 || (parsed_num == 2 && strcmp(src_dir, "fast") == 0))) {
+        *shutdown = true;
+        return commandShutdown(fss_out, log_fd, parsed_num == 2);
+    }
+
+    // Unknown or invalid command format
+    forwardMessage("Invalid command!\n", fss_out, -1);
+    return CMD_INVALID;
+}
@@ -0,0 +1,261 @@
+#include "../header/control_server.h"
+#include "../header/protocol.h"
+#include "../header/message_utils.h"
+#include "../header/commands.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <deque>
+#include <string>
+
+// Control Server: UNIX socket where many clients can send commands at the same time
+
+#define CLOSE_FLUSH_MS 1000     // How long closeControlServer() waits for slow clients
+#define READS_PER_EVENT 16      // Packets read from a client before the others get their turn
+
+struct control_session {
+    int fd;
+    bool broken;                        // Disconnected or too slow, closed after the current command
+    frame_buffer input;                 // Received requests (complete once their newline arrived)
+    std::deque<std::string> output;     // Packets waiting for the socket to become writable
+    size_t output_bytes;
+};
+
+static int listen_fd = -1;
+static char socket_path[sizeof(((struct sockaddr_un*)0)->sun_path)] = "";
+static control_session sessions[CONTROL_MAX_CLIENTS];
+static int session_count = 0;
+
+///// HELPER FUNCTIONS /////
+
+static control_session* findSession(int fd) {
+    for (int i = 0; i < session_count; i++) {
+        if (sessions[i].fd == fd) return &sessions[i];
+    }
+    return NULL;
+}
+
+// Send the queued packets until the socket is full
+static void flushSession(control_session* session) {
+    while (!session->output.empty() && !session->broken) {
+        const std::string& packet = session->output.front();
+        if (send(session->fd, packet.data(), packet.size(), MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) session->broken = true;
+            return;
+        }
+        session->output_bytes -= packet.size();
+        session->output.pop_front();
+    }
+}
+
+// Send one packet (header + message) now, or queue it if the socket is full
+static void sendPacket(control_session* session, const char* header, size_t header_len, const char* msg, size_t msg_len) {
+    if (session->broken) return;
+
+    if (session->output.empty()) {
+        struct iovec iov[2] = {{(void*)header, header_len}, {(void*)msg, msg_len}};
+        struct msghdr packet;
+        memset(&packet, 0, sizeof(packet));
+        packet.msg_iov = iov;
+        packet.msg_iovlen = 2;
+        ssize_t sent;
+        while ((sent = sendmsg(session->fd, &packet, MSG_DONTWAIT | MSG_NOSIGNAL)) < 0 && errno == EINTR) {}
+        if (sent >= 0) return;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            session->broken = true;
+            return;
+        }
+    }
+
+    // A client that does not read its responses is disconnected instead of growing the queue forever
+    if (session->output_bytes + header_len + msg_len > CONTROL_OUTPUT_MAX) {
+        printf("%sControl client disconnected, %zu bytes of responses not read\n", currentTimestamp(),
+               session->output_bytes);
+        session->broken = true;
+        return;
+    }
+    std::string queued(header, header_len);
+    queued.append(msg, msg_len);
+    session->output_bytes += queued.size();
+    session->output.push_back(queued);
+}
+
+// Console writer: responses for a session go to its queue
+static bool writeSession(int fd, const char* header, size_t header_len, const char* msg, size_t msg_len) {
+    control_session* session = findSession(fd);
+    if (!session) return false;
+
+    // Frames are already at most FRAME_PAYLOAD_MAX, plain text can be split anywhere
+    if (header_len > 0) {
+        sendPacket(session, header, header_len, msg, msg_len);
+        return true;
+    }
+    for (size_t offset = 0; offset < msg_len; offset += FRAME_PAYLOAD_MAX) {
+        size_t length = msg_len - offset < FRAME_PAYLOAD_MAX ? msg_len - offset : FRAME_PAYLOAD_MAX;
+        sendPacket(session, "", 0, msg + offset, length);
+    }
+    return true;
+}
+
+// Accept the waiting clients
+static void acceptClients() {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) perror("Error accepting control client");
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (session_count == CONTROL_MAX_CLIENTS) {
+            printf("%sControl client refused, %d clients connected\n", currentTimestamp(), session_count);
+            close(fd);
+            continue;
+        }
+
+        control_session* session = &sessions[session_count++];
+        session->fd = fd;
+        session->broken = false;
+        initFrameBuffer(&session->input);
+        session->output.clear();
+        session->output_bytes = 0;
+    }
+}
+
+// Read the packets of a client and run its complete requests
+static void serveSession(control_session* session, int log_fd, int inotify_fd, bool* shutdown) {
+    for (int i = 0; i < READS_PER_EVENT; i++) {
+        ssize_t bytes_read = readFrameBuffer(session->fd, &session->input);
+        if (bytes_read == 0 || (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            session->broken = true;     // Client closed the connection
+            break;
+        }
+        if (bytes_read < 0) break;
+    }
+
+    // The responses of the session are framed with its request ids, the fss_out console keeps its own
+    long long request_id;
+    char* command;
+    while (!*shutdown && nextRequest(&session->input, &request_id, &command)) {
+        long long previous_id = getResponseId();
+        setResponseId(request_id);
+        int result = executeCommand(command, session->fd, log_fd, inotify_fd, shutdown);
+        sendResponseEnd(session->fd, request_id, result);
+        setResponseId(previous_id);
+    }
+}
+
+// Close the sessions that are broken
+static void removeBrokenSessions() {
+    int kept = 0;
+    for (int i = 0; i < session_count; i++) {
+        if (sessions[i].broken) {
+            close(sessions[i].fd);
+            freeFrameBuffer(&sessions[i].input);
+            sessions[i].output.clear();
+            continue;
+        }
+        if (kept != i) {
+            sessions[kept].fd = sessions[i].fd;
+            sessions[kept].broken = false;
+            sessions[kept].input = sessions[i].input;
+            sessions[kept].output.swap(sessions[i].output);
+            sessions[kept].output_bytes = sessions[i].output_bytes;
+            sessions[i].output.clear();
+        }
+        kept++;
+    }
+    session_count = kept;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Create the socket and start accepting clients
+bool openControlServer(const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Control socket path too long: %s\n", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        perror("Error creating control socket");
+        return false;
+    }
+
+    // Remove the socket of a previous run
+    unlink(path);
+    if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, CONTROL_MAX_CLIENTS) < 0) {
+        perror("Error binding control socket");
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    strcpy(socket_path, path);
+    setConsoleWriter(writeSession);
+    return true;
+}
+
+// Fill fds for the listening socket and the sessions
+int addControlPollFds(struct pollfd* fds) {
+    if (listen_fd < 0) return 0;
+
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    for (int i = 0; i < session_count; i++) {
+        fds[i + 1].fd = sessions[i].fd;
+        fds[i + 1].events = POLLIN | (sessions[i].output.empty() ? 0 : POLLOUT);
+        fds[i + 1].revents = 0;
+    }
+    return session_count + 1;
+}
+
+// Accept clients, run the commands they sent and send their queued responses
+void handleControlEvents(const struct pollfd* fds, int count, int log_fd, int inotify_fd, bool* shutdown) {
+    for (int i = 1; i < count && !*shutdown; i++) {
+        control_session* session = findSession(fds[i].fd);
+        if (!session || !fds[i].revents) continue;
+
+        if (fds[i].revents & POLLOUT) flushSession(session);
+        if (fds[i].revents & POLLIN) serveSession(session, log_fd, inotify_fd, shutdown);
+        else if (fds[i].revents & (POLLHUP | POLLERR)) session->broken = true;
+    }
+    removeBrokenSessions();
+
+    // New clients after the sessions, so fds still matches them above
+    if (count > 0 && (fds[0].revents & POLLIN)) acceptClients();
+}
+
+// Send what is still queued, close the sessions and remove the socket
+void closeControlServer() {
+    if (listen_fd < 0) return;
+
+    // Give the clients a moment to read the last responses (e.g. of shutdown)
+    for (int waited = 0; waited < CLOSE_FLUSH_MS; waited += 10) {
+        bool pending = false;
+        for (int i = 0; i < session_count; i++) {
+            flushSession(&sessions[i]);
+            if (!sessions[i].output.empty() && !sessions[i].broken) pending = true;
+        }
+        if (!pending) break;
+        usleep(10000);
+    }
+
+    setConsoleWriter(NULL);
+    for (int i = 0; i < session_count; i++) sessions[i].broken = true;
+    removeBrokenSessions();
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(socket_path);
+}
\ No newline at end of file
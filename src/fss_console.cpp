@@ -9,7 +9,11 @@
 #include <limits.h>
 #include <poll.h>
 #include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include "../header/message_utils.h"
+#include "../header/protocol.h"
+#include "../header/commands.h"     // for the CMD_* result codes
 
 #define COMMAND_BUF_S (16 + 2*PATH_MAX) // ((SOURCE & TARGET PATHS) + COMMAND)
 
@@ -20,27 +24,194 @@ void handle_sigint(int) {
     sigint_received = 1;
 }
 
+// A command of a batch file and its result
+typedef struct {
+    char* command;
+    int result;     // CMD_* code, -1 = no response yet
+} batch_command;
+
+///// HELPER FUNCTIONS /////
+
+// Connect to the control socket of the manager (@control_socket), returns the fd or -1
+static int connectControlSocket(const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Control socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("Error creating control socket");
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        perror("Error connecting to control socket");
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// Log a command sent to the manager
+static void logCommand(const char* command, int log_fd) {
+    str_builder msg;
+    startMessage(&msg);
+    sbAppend(&msg, "Command ");
+    sbAppend(&msg, command);
+    sbAppendChar(&msg, '\n');
+    forwardMessage(sbString(&msg), -1, log_fd);
+    sbFree(&msg);
+}
+
+// Print and log the output of a response frame
+static void showResponse(const response_frame* frame, int log_fd) {
+    str_builder output;
+    sbInit(&output);
+    sbAppendLength(&output, frame->payload, frame->length);
+    printf("%s", sbString(&output));
+    forwardMessage(sbString(&output), -1, log_fd);
+    sbFree(&output);
+}
+
+// Send every command of a batch file at once (request id = position in the file) and collect the results
+// Returns 0 if all commands succeeded, otherwise the highest result code (3 if a command got no response)
+static int runBatch(const char* batch_file, int fss_in, int fss_out, int log_fd) {
+    FILE* file = fopen(batch_file, "r");
+    if (!file) {
+        perror("Error opening batch file");
+        return 3;
+    }
+
+    // One request per non-empty line ('#' starts a comment)
+    batch_command* commands = NULL;
+    int count = 0;
+    str_builder requests;
+    sbInit(&requests);
+    char line[COMMAND_BUF_S];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        const char* command = line + strspn(line, " \t");
+        if (!*command || *command == '#') continue;
+
+        batch_command* grown = (batch_command*)realloc(commands, (count + 1) * sizeof(batch_command));
+        if (!grown) {
+            perror("Memory allocation failed for batch");
+            break;
+        }
+        commands = grown;
+        commands[count].command = strdup(command);
+        commands[count].result = -1;
+        count++;
+        sbAppendFormat(&requests, "#%d %s\n", count, command);
+        logCommand(command, log_fd);
+    }
+    fclose(file);
+
+    // Write the requests while reading the responses, so neither pipe can fill up and block both sides
+    fcntl(fss_in, F_SETFL, fcntl(fss_in, F_GETFL) | O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+    frame_buffer responses;
+    initFrameBuffer(&responses);
+    size_t sent = 0;
+    int answered = 0;
+    while (answered < count && !sigint_received) {
+        struct pollfd pfds[2];
+        pfds[0].fd = fss_out;
+        pfds[0].events = POLLIN;
+        pfds[1].fd = sent < sbLength(&requests) ? fss_in : -1;
+        pfds[1].events = POLLOUT;
+        if (poll(pfds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll failed");
+            break;
+        }
+
+        if (pfds[1].revents & (POLLOUT | POLLERR)) {
+            // At most REQUEST_MAX per write, a socket packet must fit in the manager's read buffer
+            size_t length = sbLength(&requests) - sent < REQUEST_MAX ? sbLength(&requests) - sent : REQUEST_MAX;
+            ssize_t written = write(fss_in, sbString(&requests) + sent, length);
+            if (written > 0) {
+                sent += written;
+            } else if (written < 0 && errno != EAGAIN && errno != EINTR) {
+                perror("write to fss_in failed");
+                break;
+            }
+        }
+
+        if (pfds[0].revents & (POLLIN | POLLHUP)) {
+            ssize_t bytes_read = readFrameBuffer(fss_out, &responses);
+            if (bytes_read == 0) break;     // Manager closed fss_out (shut down)
+            if (bytes_read < 0 && errno != EAGAIN) {
+                perror("read from fss_out failed");
+                break;
+            }
+
+            response_frame frame;
+            while (nextResponse(&responses, &frame)) {
+                if (!frame.end) {
+                    showResponse(&frame, log_fd);
+                } else if (frame.id >= 1 && frame.id <= count && commands[frame.id - 1].result < 0) {
+                    commands[frame.id - 1].result = frame.rc;
+                    answered++;
+                }
+            }
+        }
+    }
+    freeFrameBuffer(&responses);
+    sbFree(&requests);
+
+    // Result of every command: #<id> <code> <command> ('-' = no response)
+    int status = 0;
+    printf("\nResults:\n");
+    for (int i = 0; i < count; i++) {
+        int result = commands[i].result;
+        if (result < 0) printf("#%d - %s\n", i + 1, commands[i].command);
+        else printf("#%d %d %s\n", i + 1, result, commands[i].command);
+
+        if (result < 0) status = 3;
+        else if (result > status && status < 3) status = result;
+        free(commands[i].command);
+    }
+    free(commands);
+    return status;
+}
+
+///// MAIN FUNCTIONS /////
+
 int main(int argc, char* argv[]) {
     int fss_in, fss_out;
     int log_fd = -1;
     char command_buf[COMMAND_BUF_S];
     char log_file[PATH_MAX] = "";
+    const char* batch_file = NULL;
+    const char* socket_file = NULL;
     
     // Parse command line arguments
     int opt;
-    while ((opt = getopt(argc, argv, "l:")) != -1) {
+    while ((opt = getopt(argc, argv, "l:b:s:")) != -1) {
         switch (opt) {
             case 'l':
                 strncpy(log_file, optarg, PATH_MAX - 1);
                 log_file[PATH_MAX - 1] = '\0';
                 break;
+            case 'b':
+                batch_file = optarg;
+                break;
+            case 's':
+                socket_file = optarg;
+                break;
             default:
-                printf("Usage: %s -l <log_file>\n", argv[0]);
+                printf("Usage: %s -l <log_file> [-b <command_file>] [-s <control_socket>]\n", argv[0]);
                 exit(1);
         }
     }
     if (!strlen(log_file)) {
-        printf("Usage: %s -l <log_file>\n", argv[0]);
+        printf("Usage: %s -l <log_file> [-b <command_file>] [-s <control_socket>]\n", argv[0]);
         exit(1);
     }
     
@@ -51,22 +222,36 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
 
-    // Open pipes
-    if ((fss_in = open("fss_in", O_WRONLY)) < 0) {  // to send command
-        perror("fifo open error: fss_in");
-        exit(1);
-    }
-    if ((fss_out = open("fss_out", O_RDONLY | O_NONBLOCK)) < 0) {   // to receive response
-        perror("fifo open error: fss_out");
-        exit(1);
+    // Open pipes (or one socket for both directions)
+    if (socket_file) {
+        if ((fss_in = connectControlSocket(socket_file)) < 0) exit(1);
+        fss_out = fss_in;
+    } else {
+        if ((fss_in = open("fss_in", O_WRONLY)) < 0) {  // to send command
+            perror("fifo open error: fss_in");
+            exit(1);
+        }
+        if ((fss_out = open("fss_out", O_RDONLY | O_NONBLOCK)) < 0) {   // to receive response
+            perror("fifo open error: fss_out");
+            exit(1);
+        }
     }
     
     // Give manager a moment to start initializing
     usleep(100000);
 
-    // Set up SIGINT handler
+    // Signal handler for SIGINT (ctrl+c)
     signal(SIGINT, handle_sigint);
 
+    // Non-interactive: pipeline a whole command file
+    if (batch_file) {
+        int status = runBatch(batch_file, fss_in, fss_out, log_fd);
+        close(fss_out);
+        if (fss_in != fss_out) close(fss_in);
+        close(log_fd);
+        exit(status);
+    }
+
     // Initialize pollfd array once
     struct pollfd pfds[2];
     pfds[0].fd = fss_out;      // respone message from manager
@@ -75,6 +260,9 @@ int main(int argc, char* argv[]) {
     pfds[1].events = POLLIN;
 
     int sigint_shutdown_requested = 0;
+    int request_id = 0;
+    frame_buffer responses;     // Output of the manager (frames may arrive in pieces)
+    initFrameBuffer(&responses);
 
     for(;;) {
         if (poll(pfds, 2, 100) < 0) {
@@ -91,32 +279,24 @@ int main(int argc, char* argv[]) {
         }
 
         // Check for any messages from manager
-        if (pfds[0].revents & POLLIN) {
-            char temp_buf[128];  // to read data in chunks
-            char* output_buf = NULL;
-            size_t total_size = 0;
-            ssize_t bytes_read;
+        if (pfds[0].revents & (POLLIN | POLLHUP)) {
+            // The socket is closed when the manager exits (a pipe without writer is not an error here)
+            if (readFrameBuffer(fss_out, &responses) == 0 && socket_file) {
+                printf("\nManager closed the connection\n");
+                break;
+            }
+
+            str_builder output;
+            sbInit(&output);
             
-            // Read data in chunks and reallocate as needed
-            while ((bytes_read = read(fss_out, temp_buf, sizeof(temp_buf))) > 0) {
-                char* new_buf = (char*)realloc(output_buf, total_size + bytes_read + 1);
-                if (!new_buf) {
-                    perror("Failed to allocate memory for output");
-                    free(output_buf);
-                    break;
-                }
-                output_buf = new_buf;
-                
-                // Copy new data into expanded buffer
-                memcpy(output_buf + total_size, temp_buf, bytes_read);
-                total_size += bytes_read;
-                output_buf[total_size] = '\0';  // Null-terminate
-                
-                if (bytes_read < (ssize_t)sizeof(temp_buf))
-                    break;
+            // Collect the output of the complete frames (END frames only end a request)
+            response_frame frame;
+            while (nextResponse(&responses, &frame)) {
+                if (!frame.end) sbAppendLength(&output, frame.payload, frame.length);
             }
             
-            if (output_buf && total_size > 0) {
+            if (sbLength(&output) > 0) {
+                const char* output_buf = sbString(&output);
                 printf("\n%s\n", output_buf);
                 
                 // Log manager response
@@ -125,9 +305,10 @@ int main(int argc, char* argv[]) {
                 // Check for shutdown message
                 if (strstr(output_buf, "Manager shutdown complete") != NULL) {
                     printf("Shutting down console...\n");
-                    free(output_buf);
+                    sbFree(&output);
+                    freeFrameBuffer(&responses);
                     close(fss_out);
-                    close(fss_in);
+                    if (fss_in != fss_out) close(fss_in);
                     close(log_fd);
                     exit(0);
                 }
@@ -137,9 +318,8 @@ int main(int argc, char* argv[]) {
                     printf("> ");
                     fflush(stdout);
                 }
-            
-                free(output_buf);
             }
+            sbFree(&output);
         }
 
         // If shutdown has been requested, skip user input
@@ -167,7 +347,8 @@ int main(int argc, char* argv[]) {
             }
             
             // Format and log the command
-            char* temp_msg = NULL;
+            str_builder temp_msg;
+            startMessage(&temp_msg);
             int valid_command = 1;
 
             if (strncmp(command_buf, "add ", 4) == 0) {
@@ -175,17 +356,10 @@ int main(int argc, char* argv[]) {
                 char target[PATH_MAX] = "";
                 sscanf(command_buf + 4, "%s %s", source, target);
                 
-                // Allocate memory for formatted message
-                temp_msg = (char*)malloc(strlen(source) + strlen(target) + 30);
-                if (!temp_msg) {
-                    perror("Memory allocation failed");
-                    continue;
-                }
-                
                 if (strlen(source) > 0 && strlen(target) > 0) {
-                    sprintf(temp_msg, "Command add %s -> %s\n", source, target);
+                    sbAppendFormat(&temp_msg, "Command add %s -> %s\n", source, target);
                 } else {
-                    sprintf(temp_msg, "Invalid command: add %s\n", command_buf + 4);
+                    sbAppendFormat(&temp_msg, "Invalid command: add %s\n", command_buf + 4);
                     valid_command = 0;
                 }
             } else {
@@ -193,50 +367,41 @@ int main(int argc, char* argv[]) {
                 char cmd[16] = "";
                 sscanf(command_buf, "%s", cmd);
                 
-                // Allocate memory for formatted message
-                temp_msg = (char*)malloc(strlen(command_buf) + 30);
-                if (!temp_msg) {
-                    perror("Memory allocation failed");
-                    continue;
-                }
-                
                 // Check if it's one of the known commands
                 if (strcmp(cmd, "cancel") == 0 || 
                     strcmp(cmd, "status") == 0 || 
+                    strcmp(cmd, "addfile") == 0 || 
+                    strcmp(cmd, "stats") == 0 || 
                     strcmp(cmd, "sync") == 0 || 
                     strcmp(cmd, "delete") == 0 || 
+                    strcmp(cmd, "throttle") == 0 || 
                     strcmp(cmd, "shutdown") == 0) {
-                    sprintf(temp_msg, "Command %s\n", command_buf);
+                    sbAppendFormat(&temp_msg, "Command %s\n", command_buf);
                 } else {
-                    sprintf(temp_msg, "Invalid command: %s\n", command_buf);
+                    sbAppendFormat(&temp_msg, "Invalid command: %s\n", command_buf);
                     valid_command = 0;
                 }
             }
 
             if (!valid_command) {
-                // For invalid commands, add timestamp, print warning, log
-                temp_msg = addTimestampToMessage(temp_msg, NULL);
-                
-                if (temp_msg) {
-                    printf("%s", temp_msg);                    
-                    forwardMessage(temp_msg, -1, log_fd);
-                }
-                
-                free(temp_msg);
+                // For invalid commands, print warning, log
+                printf("%s", sbString(&temp_msg));
+                forwardMessage(sbString(&temp_msg), -1, log_fd);
+                sbFree(&temp_msg);
                 printf("> ");
                 fflush(stdout);
                 continue;
             } else {
-                // For valid commands, just add timestamp and log
-                temp_msg = addTimestampToMessage(temp_msg, NULL);
-                
-                if (temp_msg) forwardMessage(temp_msg, -1, log_fd);                    
-                
-                free(temp_msg);
+                // For valid commands, just log
+                forwardMessage(sbString(&temp_msg), -1, log_fd);
+                sbFree(&temp_msg);
             }
 
-            // Send message to manager
-            size_t msg_len = strlen(command_buf);
+            // Send message to manager as a framed request
+            str_builder request;
+            sbInit(&request);
+            sbAppendFormat(&request, "#%d %s\n", ++request_id, command_buf);
+            size_t msg_len = sbLength(&request);
             size_t bytes_sent = 0;
 
             while (bytes_sent < msg_len) {
@@ -244,7 +409,7 @@ int main(int argc, char* argv[]) {
                 size_t chunk_size = (msg_len - bytes_sent) < PIPE_BUF ? (msg_len - bytes_sent) : PIPE_BUF;
                                     
                 // Write the chunk
-                ssize_t written = write(fss_in, command_buf + bytes_sent, chunk_size);
+                ssize_t written = write(fss_in, sbString(&request) + bytes_sent, chunk_size);
                 
                 if (written < 0) {
                     if (errno == EINTR) {
@@ -255,29 +420,27 @@ int main(int argc, char* argv[]) {
                     // Real error - use existing error handling
                     perror("write to fss_in failed");
                     // Log the failure
-                    char* error_msg = strdup("Failed to send command to manager\n");
-                    if (error_msg) {
-                        char* formatted_error = addTimestampToMessage(error_msg, NULL);
-                        if (formatted_error) {
-                            printf("%s", formatted_error);
-                            forwardMessage(formatted_error, -1, log_fd);
-                            free(formatted_error);
-                        }
-                        free(error_msg);
-                    }
+                    str_builder error_msg;
+                    startMessage(&error_msg);
+                    sbAppend(&error_msg, "Failed to send command to manager\n");
+                    printf("%s", sbString(&error_msg));
+                    forwardMessage(sbString(&error_msg), -1, log_fd);
+                    sbFree(&error_msg);
                     break;
                 }
                 
                 // Update the number of bytes sent
                 bytes_sent += written;
             }
+            sbFree(&request);
 
             usleep(100000);  // Small delay to let manager process command
         }
     }
 
+    freeFrameBuffer(&responses);
     close(fss_out);
-    close(fss_in);
+    if (fss_in != fss_out) close(fss_in);
     close(log_fd);
     exit(0);
 }
\ No newline at end of file
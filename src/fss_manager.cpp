@@ -16,14 +16,36 @@
 #include "../header/commands.h"
 #include "../header/monitor_manager.h"
 #include "../header/task_manager.h"
+#include "../header/task_journal.h"
+#include "../header/settings.h"
+#include "../header/metrics.h"
+#include "../header/trace.h"
+#include "../header/throttle.h"
+#include "../header/logger.h"
+#include "../header/log_index.h"
+#include "../header/state_export.h"
+#include "../header/protocol.h"
+#include "../header/control_server.h"
 
 volatile sig_atomic_t sigint_received = 0;
+volatile sig_atomic_t sigterm_received = 0;
+volatile sig_atomic_t sighup_received = 0;
 
 // Signal handler for SIGINT (ctrl+c)
 void handle_sigint(int) {
     sigint_received = 1;
 }
 
+// Signal handler for SIGTERM (planned restarts, fast shutdown)
+void handle_sigterm(int) {
+    sigterm_received = 1;
+}
+
+// Signal handler for SIGHUP (reload the config file)
+void handle_sighup(int) {
+    sighup_received = 1;
+}
+
 int main(int argc, char *argv[]) {
     int fss_in, fss_out;
     
@@ -61,15 +83,15 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
     
-    // Open or create log file
-    int log_fd = open(log_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    // Open or create log file (appended to, old lines end up in rotated segments)
+    int log_fd = open(log_file, O_WRONLY | O_CREAT | O_APPEND, 0644);
     if (log_fd < 0) {
         perror("Error opening log file");
         exit(1);
     }
     
     // Initialize worker manager
-    initWorkerManager(worker_limit);
+    initWorkerManager(worker_limit, log_fd);
     
     // Read config file and store data to sync_info
     int num_dirs = 0;
@@ -103,6 +125,7 @@ int main(int argc, char *argv[]) {
     if ((fss_out = open("fss_out", O_WRONLY)) < 0) {
         perror("fifo open error: fss_out"); exit(1);
     }
+    signal(SIGPIPE, SIG_IGN);   // Consoles come and go, writing to fss_out without one must not kill the manager
 
     // Initialize monitor manager (inotify)
     int monitor_fd = initMonitorManager();
@@ -111,29 +134,98 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
 
-    // Set up polling for both inotify and command input
-    struct pollfd fds[2];
+    // Set up polling for both inotify and command input (and the control socket after them)
+    struct pollfd fds[2 + CONTROL_MAX_CLIENTS + 1];
     fds[0].fd = fss_in;
     fds[0].events = POLLIN;
     fds[1].fd = monitor_fd;
     fds[1].events = POLLIN;
 
-    // Initial syncronization
-    for (auto& pair : sync_info) {
-        commandAdd(pair.second.source_dir, pair.second.target_dir, fss_out, log_fd, monitor_fd);
+    // Commands that arrived on fss_in (kept until their newline arrives)
+    frame_buffer command_input;
+    initFrameBuffer(&command_input);
+
+    // Log writes go through the flusher thread from here on
+    size_t log_buffer = settings.log_buffer > 0 ? (size_t)settings.log_buffer : LOG_BUFFER_DEFAULT;
+    setLogRotation(log_file, settings.log_rotate_size, settings.log_rotate_interval, settings.log_keep);
+    if (!openLogger(log_fd, log_buffer, settings.log_block)) {
+        printf("Failed to start the log flusher, writing the log directly.\n");
+    }
+
+    // Summary of the log for fss_script
+    if (!openLogIndex(log_file)) {
+        printf("Failed to open the log index, fss_script will read the log instead.\n");
+    }
+
+    // Live state for fss_state
+    if (settings.state_path[0] && !openStateExport(settings.state_path)) {
+        printf("Failed to open state file %s, continuing without it.\n", settings.state_path);
+    }
+
+    // Control socket for clients other than the fss_in/fss_out console
+    if (settings.control_socket[0] && !openControlServer(settings.control_socket)) {
+        printf("Failed to open control socket %s, continuing without it.\n", settings.control_socket);
+    }
+
+    // Optional timeline of the manager loop and the tasks
+    if (settings.trace_path[0] && !openTrace(settings.trace_path)) {
+        printf("Failed to open trace file %s, continuing without it.\n", settings.trace_path);
+    }
+
+    // Recover pending tasks of the previous run from the task journal
+    if (settings.journal_path[0]) {
+        int replayed = openTaskJournal(settings.journal_path, log_fd);
+        if (replayed < 0) {
+            printf("Failed to open task journal %s, continuing without it.\n", settings.journal_path);
+        } else if (replayed > 0) {
+            str_builder journal_msg;
+            startMessage(&journal_msg);
+            sbAppendFormat(&journal_msg, "Recovered %d pending tasks from journal %s\n", replayed, settings.journal_path);
+            printf("%s", sbString(&journal_msg));
+            forwardMessage(sbString(&journal_msg), -1, log_fd);
+            sbFree(&journal_msg);
+        }
+    }
+
+    // Initial syncronization (not needed for pairs whose pending tasks were recovered from the journal)
+    for (sync_info_entry& info : sync_info) {
+        if (info.queued_tasks > 0) {
+            commandResume(info.source_dir, fss_out, log_fd, monitor_fd);
+        } else {
+            commandAdd(info.source_dir, info.target_dir, fss_out, log_fd, monitor_fd);
+        }
     }
 
     // Register signal handler
     signal(SIGINT, handle_sigint);
+    signal(SIGTERM, handle_sigterm);
+    signal(SIGHUP, handle_sighup);
 
     // Polling loop
+    uint64_t loop_start_ns = 0;
     for (;;) {
+        // One span per loop iteration (written when the next one starts)
+        if (trace_enabled) {
+            uint64_t now = getMonotonicNs();
+            if (loop_start_ns) traceSpan("loop", "manager", 0, loop_start_ns, now, NULL, NULL);
+            loop_start_ns = now;
+        }
+        
         if (sigint_received) {
-            commandShutdown(fss_out, log_fd);
+            commandShutdown(fss_out, log_fd, false);
             break;
         }
+        if (sigterm_received) {
+            commandShutdown(fss_out, log_fd, true);
+            break;
+        }
+        if (sighup_received) {
+            sighup_received = 0;
+            commandReload(config_file, fss_out, log_fd, monitor_fd);
+        }
 
-        // Check if we need to process completed workers
+        // Read what the workers wrote, then process completed workers
+        readWorkerOutput();
         if (worker_finished_flag) {
             processFinishedWorker(fss_out, log_fd);
         }
@@ -141,7 +233,19 @@ int main(int argc, char *argv[]) {
         // Start worker processes for queued tasks
         startWorker();
         
-        int poll_result = poll(fds, 2, 100);
+        // Commit the tasks added and completed in this loop to the journal
+        flushTaskJournal();
+        
+        // Update the metrics file for the exporter
+        exportMetrics(false);
+        flushLogIndex(false);
+        exportState(false);
+        compactSyncInfo();
+        
+        uint64_t poll_start_ns = trace_enabled ? getMonotonicNs() : 0;
+        int nfds = 2 + addControlPollFds(fds + 2);
+        int poll_result = poll(fds, nfds, 100);
+        if (trace_enabled) traceSpan("poll", "manager", 0, poll_start_ns, getMonotonicNs(), NULL, NULL);
         
         if (poll_result < 0) {
             // Error in poll
@@ -163,78 +267,44 @@ int main(int argc, char *argv[]) {
         
         // Check for command input
         if (fds[0].revents & POLLIN) {
-            // Read data in chunks
-            char temp_buf[128];  // to read data in chunks
-            char* buffer_in = NULL;
-            size_t total_size = 0;
-            ssize_t bytes_read;
-            
-            // Read data in chunks and reallocate as needed
-            while ((bytes_read = read(fss_in, temp_buf, sizeof(temp_buf))) > 0) {
-                char* new_buf = (char*)realloc(buffer_in, total_size + bytes_read + 1);
-                if (!new_buf) {
-                    perror("Failed to allocate memory for command");
-                    free(buffer_in);
-                    break;
-                }
-                buffer_in = new_buf;
-                
-                // Copy new data into expanded buffer
-                memcpy(buffer_in + total_size, temp_buf, bytes_read);
-                total_size += bytes_read;
-                buffer_in[total_size] = '\0';  // Null-terminate
-                
-                if (bytes_read < (ssize_t)sizeof(temp_buf))
-                    break;
+            ssize_t bytes_read = readFrameBuffer(fss_in, &command_input);
+            if (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("read from fss_in");
+                break;
             }
             
-            if (bytes_read < 0) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {  // No data available right now
-                    free(buffer_in);
-                    continue;
-                } else {
-                    perror("read from fss_in");
-                    free(buffer_in);
-                    break;
-                }
-            } else if (buffer_in && total_size > 0) {
-                // Parse the command string
-                char cmd[16] = "";
-                char src_dir[PATH_MAX] = "";
-                char trg_dir[PATH_MAX] = "";
-                
-                // Parse command and arguments
-                int parsed_num = sscanf(buffer_in, "%s %s %s", cmd, src_dir, trg_dir);
-                
-                if (parsed_num >= 1) {
-                    // Check which command was given
-                    if (strcmp(cmd, "add") == 0 && parsed_num == 3) {
-                        commandAdd(src_dir, trg_dir, fss_out, log_fd, monitor_fd);
-                    } else if (strcmp(cmd, "cancel") == 0 && parsed_num == 2) {
-                        commandCancel(src_dir, fss_out, log_fd, monitor_fd);
-                    } else if (strcmp(cmd, "status") == 0 && parsed_num == 2) {
-                        commandStatus(src_dir, fss_out);
-                    } else if (strcmp(cmd, "sync") == 0 && parsed_num == 2) {
-                        commandSync(src_dir, fss_out, log_fd, monitor_fd);
-                    } else if (strcmp(cmd, "delete") == 0 && parsed_num == 2) {
-                        commandDelete(src_dir, fss_out, log_fd);
-                    } else if (strcmp(cmd, "shutdown") == 0) {
-                        free(buffer_in);
-                        commandShutdown(fss_out, log_fd);
-                        break;
-                    } else {
-                        // Unknown or invalid command format
-                        forwardMessage("Invalid command!\n", fss_out, -1);
-                    }
-                } else {
-                    forwardMessage("Invalid command!\n", fss_out, -1);
-                }
-                free(buffer_in);
+            // Run every command that arrived, framed requests get their output framed and an END frame
+            bool shutdown = false;
+            long long request_id;
+            char* command;
+            while (!shutdown && nextRequest(&command_input, &request_id, &command)) {
+                setResponseId(request_id);
+                int result = executeCommand(command, fss_out, log_fd, monitor_fd, &shutdown);
+                sendResponseEnd(fss_out, request_id, result);
+                setResponseId(request_id < 0 ? -1 : 0);  // Later messages of a framed client use id 0
             }
+            if (shutdown) break;
+        }
+        
+        // Check the control socket clients
+        if (nfds > 2) {
+            bool shutdown = false;
+            handleControlEvents(fds + 2, nfds - 2, log_fd, monitor_fd, &shutdown);
+            if (shutdown) break;
         }
     }
 
+    // Save the tasks still queued (none after a normal shutdown) and close the journal
+    closeTaskJournal();
+    exportMetrics(true);
+    closeTrace();
+    closeLogIndex();
+    closeStateExport();
+    closeControlServer();
+    closeLogger();
+
     // Close file descriptors and cleanup
+    freeFrameBuffer(&command_input);
     close(fss_in);
     close(fss_out);
     close(log_fd);
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../header/state_export.h"
+
+// fss_state: Prints a consistent snapshot of the manager's state file (@state_file) without talking to the manager
+
+#define SNAPSHOT_TRIES 2000     // Attempts before giving up (the manager holds the lock for microseconds)
+#define RETRY_SLEEP_US 500      // Pause after a failed attempt
+
+static int state_fd = -1;
+static char* state_map = NULL;
+static size_t state_size = 0;
+
+///// HELPER FUNCTIONS /////
+
+// Map the whole file (again, if the manager made it larger), returns false on error
+static bool mapState() {
+    struct stat st;
+    if (fstat(state_fd, &st) < 0 || (size_t)st.st_size < sizeof(state_header)) return false;
+
+    if (state_map) munmap(state_map, state_size);
+    state_size = st.st_size;
+    state_map = (char*)mmap(NULL, state_size, PROT_READ, MAP_SHARED, state_fd, 0);
+    if (state_map == MAP_FAILED) {
+        state_map = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Copy the header and the entries while no update is in progress
+// Returns the data (malloc'd) or NULL if no consistent copy was made
+static char* takeSnapshot(state_header* snapshot) {
+    char* data = NULL;
+    size_t data_capacity = 0;
+
+    for (int attempt = 0; attempt < SNAPSHOT_TRIES; attempt++) {
+        if (attempt > 0) usleep(RETRY_SLEEP_US);
+        const state_header* shared = (const state_header*)state_map;
+
+        uint64_t sequence = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+        if (sequence & 1) continue;     // Update in progress
+
+        memcpy(snapshot, shared, sizeof(state_header));
+        if (snapshot->magic != STATE_MAGIC) continue;
+        if (snapshot->version != STATE_VERSION) {
+            fprintf(stderr, "Unsupported state file version %u (expected %u)\n", snapshot->version, STATE_VERSION);
+            break;
+        }
+
+        // The manager made the file larger since it was mapped
+        if (snapshot->file_size > state_size || sizeof(state_header) + snapshot->data_length > state_size) {
+            if (!mapState()) break;
+            continue;
+        }
+
+        if (snapshot->data_length > data_capacity) {
+            free(data);
+            data_capacity = snapshot->data_length;
+            data = (char*)malloc(data_capacity);
+            if (!data) {
+                perror("Memory allocation failed for snapshot");
+                return NULL;
+            }
+        }
+        if (snapshot->data_length) memcpy(data, state_map + sizeof(state_header), snapshot->data_length);
+
+        // Consistent if nothing was written while copying
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shared->sequence, __ATOMIC_RELAXED) == sequence) {
+            return data ? data : (char*)malloc(1);
+        }
+    }
+    free(data);
+    return NULL;
+}
+
+// Print the entries of the snapshot (only the one of source if it is not NULL), returns number printed
+static int printEntries(const char* data, const state_header* snapshot, const char* source) {
+    int printed = 0;
+    size_t offset = 0;
+    while (offset + sizeof(state_entry) <= snapshot->data_length) {
+        const state_entry* entry = (const state_entry*)(data + offset);
+        if (entry->length < sizeof(state_entry) || offset + entry->length > snapshot->data_length) break;
+
+        const char* source_dir = data + offset + sizeof(state_entry);
+        const char* target_dir = source_dir + entry->source_length + 1;
+        offset += entry->length;
+        if (entry->removed) continue;
+        if (source && strcmp(source, source_dir) != 0) continue;
+
+        // Times are stored as numbers and formatted here
+        char last_sync[TIMESTAMP_SIZE] = "Never";
+        if (entry->last_sync) {
+            time_t when = (time_t)entry->last_sync;
+            struct tm tm_sync;
+            localtime_r(&when, &tm_sync);
+            strftime(last_sync, sizeof(last_sync), "%Y-%m-%d %H:%M:%S", &tm_sync);
+        }
+        printf("%s -> %s [Last Sync: %s] [Errors: %d] [Queued: %d] [%s]\n", source_dir, target_dir,
+               last_sync, entry->error_count, entry->queued_tasks, entry->active ? "Active" : "Inactive");
+        printed++;
+    }
+    return printed;
+}
+
+///// MAIN FUNCTIONS /////
+
+int main(int argc, char* argv[]) {
+    char state_file[PATH_MAX] = "";
+    const char* source = NULL;
+    bool quiet = false;
+
+    // Parse command line arguments
+    int opt;
+    while ((opt = getopt(argc, argv, "f:d:q")) != -1) {
+        switch (opt) {
+            case 'f':
+                strncpy(state_file, optarg, PATH_MAX - 1);
+                state_file[PATH_MAX - 1] = '\0';
+                break;
+            case 'd':
+                source = optarg;
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            default:
+                printf("Usage: %s -f <state_file> [-d <source_dir>] [-q]\n", argv[0]);
+                exit(1);
+        }
+    }
+    if (!strlen(state_file)) {
+        printf("Usage: %s -f <state_file> [-d <source_dir>] [-q]\n", argv[0]);
+        exit(1);
+    }
+
+    state_fd = open(state_file, O_RDONLY | O_CLOEXEC);
+    if (state_fd < 0) {
+        perror("Error opening state file");
+        exit(1);
+    }
+    if (!mapState()) {
+        fprintf(stderr, "Error mapping state file %s\n", state_file);
+        exit(1);
+    }
+
+    state_header snapshot;
+    char* data = takeSnapshot(&snapshot);
+    if (!data) {
+        fprintf(stderr, "Could not read a consistent snapshot of %s\n", state_file);
+        exit(1);
+    }
+
+    // Summary line (-q leaves it out for scripts)
+    if (!quiet) {
+        char updated[TIMESTAMP_SIZE];
+        time_t when = (time_t)snapshot.updated;
+        struct tm tm_updated;
+        localtime_r(&when, &tm_updated);
+        strftime(updated, sizeof(updated), "%Y-%m-%d %H:%M:%S", &tm_updated);
+        if (snapshot.manager_pid) printf("Manager: running (pid %d)", snapshot.manager_pid);
+        else printf("Manager: stopped");
+        printf(", updated %s, %u directories, %d queued tasks, %d active workers\n",
+               updated, snapshot.count, snapshot.queued_tasks, snapshot.active_workers);
+    }
+
+    int printed = printEntries(data, &snapshot, source);
+    if (source && printed == 0) printf("Directory not found: %s\n", source);
+
+    free(data);
+    munmap(state_map, state_size);
+    close(state_fd);
+    return source && printed == 0 ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "../header/log_index.h"
+#include "../header/message_utils.h"
+#include "../header/throttle.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <string>
+
+// Log Index: Summary of the log kept next to it as <log>.index
+
+#define INDEX_INTERVAL_NS 1000000000ULL  // Shortest time between two writes of the index file
+#define STATUS_SIZE 8                    // SUCCESS/PARTIAL/ERROR
+
+struct log_index_entry {
+    std::string target;                 // Empty until the first sync result
+    char last_sync[TIMESTAMP_SIZE];
+    char status[STATUS_SIZE];           // Empty until the first sync result
+    int monitoring;                     // 1 = started, 0 = stopped, -1 = unknown
+};
+
+static std::unordered_map<std::string, log_index_entry> log_index;
+static char index_path[PATH_MAX + 8] = "";
+static bool index_dirty = false;
+static uint64_t last_write_ns = 0;
+
+///// HELPER FUNCTIONS /////
+
+// Get the entry of a source, created empty if needed
+static log_index_entry* getIndexEntry(const char* source) {
+    auto found = log_index.find(source);
+    if (found != log_index.end()) return &found->second;
+
+    log_index_entry entry;
+    entry.last_sync[0] = '\0';
+    entry.status[0] = '\0';
+    entry.monitoring = -1;
+    return &(log_index[source] = entry);
+}
+
+// Copy a string into a fixed size field
+static void copyField(char* field, size_t size, const char* value) {
+    strncpy(field, value, size - 1);
+    field[size - 1] = '\0';
+}
+
+// Write the index to a temporary file and rename it, so the script never reads a partial index
+static void writeIndexFile() {
+    char tmp_path[PATH_MAX + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", index_path);
+
+    FILE* file = fopen(tmp_path, "w");
+    if (!file) {
+        perror("Error opening log index");
+        return;
+    }
+    for (const auto& pair : log_index) {
+        const log_index_entry* entry = &pair.second;
+        fprintf(file, "%s\t%s\t%s\t%s\t%s\n", pair.first.c_str(), entry->target.c_str(), entry->last_sync,
+                entry->status, entry->monitoring < 0 ? "-" : entry->monitoring ? "1" : "0");
+    }
+    if (fclose(file) != 0 || rename(tmp_path, index_path) < 0) {
+        perror("Error writing log index");
+        unlink(tmp_path);
+        return;
+    }
+    index_dirty = false;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Load the index of the log (if a previous run left one)
+bool openLogIndex(const char* log_path) {
+    if (strlen(log_path) >= PATH_MAX) return false;
+    snprintf(index_path, sizeof(index_path), "%s.index", log_path);
+
+    FILE* file = fopen(index_path, "r");
+    if (!file) return true;     // First run
+
+    char line[2 * PATH_MAX + 64];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = '\0';
+
+        // source, target, last sync, status, monitoring
+        char* fields[5];
+        int count = 0;
+        char* cursor = line;
+        while (count < 5) {
+            fields[count++] = cursor;
+            cursor = strchr(cursor, '\t');
+            if (!cursor) break;
+            *cursor++ = '\0';
+        }
+        if (count < 5 || !fields[0][0]) continue;
+
+        log_index_entry* entry = getIndexEntry(fields[0]);
+        entry->target = fields[1];
+        copyField(entry->last_sync, TIMESTAMP_SIZE, fields[2]);
+        copyField(entry->status, STATUS_SIZE, fields[3]);
+        entry->monitoring = fields[4][0] == '1' ? 1 : fields[4][0] == '0' ? 0 : -1;
+    }
+    fclose(file);
+    return true;
+}
+
+// Record the result of a finished task
+void indexSyncResult(const char* source, const char* target, const char* time, const char* status) {
+    if (!index_path[0]) return;
+
+    log_index_entry* entry = getIndexEntry(source);
+    if (entry->target != target) entry->target = target;
+    copyField(entry->last_sync, TIMESTAMP_SIZE, time);
+    copyField(entry->status, STATUS_SIZE, status);
+    index_dirty = true;
+}
+
+// Record that monitoring of a source started or stopped
+void indexMonitoring(const char* source, bool monitoring) {
+    if (!index_path[0]) return;
+
+    getIndexEntry(source)->monitoring = monitoring ? 1 : 0;
+    index_dirty = true;
+}
+
+// Write the index file if it changed and a second has passed since the last write
+void flushLogIndex(bool force) {
+    if (!index_dirty || !index_path[0]) return;
+
+    uint64_t now = getMonotonicNs();
+    if (!force && now - last_write_ns < INDEX_INTERVAL_NS) return;
+    last_write_ns = now;
+    writeIndexFile();
+}
+
+// Write the index file and free the index
+void closeLogIndex() {
+    flushLogIndex(true);
+    log_index.clear();
+    index_path[0] = '\0';
+}
\ No newline at end of file
@@ -0,0 +1,308 @@
+#include "../header/logger.h"
+#include "../header/message_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <atomic>
+
+// Logger: Asynchronous writer of the manager's log file
+
+#define FLUSHER_IDLE_MS 100     // Longest sleep of an idle flusher (it is woken up by new messages)
+#define BLOCK_WAIT_US 100       // Wait between checks for space with @log_full=block
+
+static char* ring = NULL;
+static size_t ring_size = 0;            // Power of two
+static int logger_fd = -1;
+static int wake_fd = -1;                // eventfd that wakes up the flusher
+static bool block_when_full = false;
+static bool running = false;
+static pthread_t flusher_thread;
+
+// Rotation (only touched by the flusher thread once it runs)
+static char log_path[PATH_MAX] = "";
+static long long rotate_size = 0;
+static int rotate_interval = 0;
+static int keep_segments = LOG_KEEP_DEFAULT;
+static int last_segment = 0;            // Number of the newest rotated segment
+static long long segment_size = 0;      // Bytes in the current log file
+static time_t segment_start = 0;
+
+// Positions are byte counts since the start, the index in the ring is position & (ring_size - 1)
+static std::atomic<uint64_t> head(0);           // End of the queued messages (written by the manager loop)
+static std::atomic<uint64_t> tail(0);           // End of the messages written to the file (written by the flusher)
+static std::atomic<bool> flusher_idle(false);   // The flusher sleeps and must be woken up
+static std::atomic<bool> stopping(false);
+static std::atomic<uint64_t> dropped(0);
+
+///// HELPER FUNCTIONS /////
+
+// Wake up the flusher
+static void wakeFlusher() {
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) perror("Error waking log flusher");
+}
+
+// Write all iovecs, continuing after partial writes, returns false on error
+static bool writeAll(struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(logger_fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        // Skip what was written
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+// Find the number of the newest <log>.<N> segment left by a previous run
+static int findLastSegment() {
+    char dir_buffer[PATH_MAX], name_buffer[PATH_MAX];
+    strcpy(dir_buffer, log_path);
+    strcpy(name_buffer, log_path);
+    const char* dir_name = dirname(dir_buffer);
+    const char* base_name = basename(name_buffer);
+    size_t base_length = strlen(base_name);
+
+    DIR* dir = opendir(dir_name);
+    if (!dir) return 0;
+
+    int last = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char* name = entry->d_name;
+        if (strncmp(name, base_name, base_length) != 0 || name[base_length] != '.') continue;
+
+        // Only digits after the dot (not .index)
+        const char* number = name + base_length + 1;
+        if (!*number || strspn(number, "0123456789") != strlen(number)) continue;
+        if (atoi(number) > last) last = atoi(number);
+    }
+    closedir(dir);
+    return last;
+}
+
+// Start a new log file: the current one becomes the next numbered segment
+static void rotateLog() {
+    char segment[PATH_MAX + 16];
+    snprintf(segment, sizeof(segment), "%s.%d", log_path, last_segment + 1);
+    if (rename(log_path, segment) < 0) {
+        perror("Error rotating log file");
+        return;
+    }
+    last_segment++;
+
+    // Same descriptor number, so the log_fd of the manager stays valid
+    int fd = open(log_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        perror("Error opening new log file");
+        return;
+    }
+    dup2(fd, logger_fd);
+    close(fd);
+    segment_size = 0;
+    segment_start = time(NULL);
+
+    // Delete the segments that are too old (stops at the first one already gone)
+    for (int number = last_segment - keep_segments; number > 0; number--) {
+        snprintf(segment, sizeof(segment), "%s.%d", log_path, number);
+        if (unlink(segment) < 0) break;
+    }
+}
+
+// Rotate the log if it reached the size or age limit
+static void checkRotation() {
+    if (!log_path[0] || segment_size == 0) return;
+    if ((rotate_size > 0 && segment_size >= rotate_size) ||
+        (rotate_interval > 0 && time(NULL) - segment_start >= rotate_interval)) {
+        rotateLog();
+    }
+}
+
+// Log how many messages were dropped since the last report
+static void reportDropped(uint64_t* reported) {
+    uint64_t count = dropped.load();
+    if (count == *reported) return;
+
+    // The flusher has its own timestamp, the cached one belongs to the manager loop
+    char timestamp[TIMESTAMP_SIZE];
+    time_t now = time(NULL);
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+    strftime(timestamp, sizeof(timestamp), "[%Y-%m-%d %H:%M:%S] ", &tm_now);
+
+    char line[128];
+    int length = snprintf(line, sizeof(line), "%s[-] [-] [%d] [LOG] [DROPPED] [%llu messages, log buffer full]\n",
+                          timestamp, (int)getpid(), (unsigned long long)(count - *reported));
+    struct iovec iov = {line, (size_t)length};
+    if (writeAll(&iov, 1)) segment_size += length;
+    *reported = count;
+}
+
+// Flusher thread: write the queued messages in batches until closeLogger()
+static void* flushLoop(void*) {
+    uint64_t reported = 0;
+    struct pollfd wake = {wake_fd, POLLIN, 0};
+
+    for (;;) {
+        uint64_t start = tail.load(std::memory_order_relaxed);
+        uint64_t end = head.load(std::memory_order_acquire);
+
+        if (start == end) {
+            reportDropped(&reported);
+            if (stopping.load()) break;
+            checkRotation();
+
+            // Sleep until woken up, checking again after announcing it so no message is missed
+            flusher_idle.store(true);
+            if (head.load() == start && !stopping.load()) {
+                if (poll(&wake, 1, FLUSHER_IDLE_MS) > 0) {
+                    uint64_t count;
+                    if (read(wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) perror("Error reading log wakeup");
+                }
+            }
+            flusher_idle.store(false);
+            continue;
+        }
+
+        // Everything queued in one writev (two parts if it wraps around the end of the ring)
+        size_t offset = start & (ring_size - 1);
+        size_t length = end - start;
+        size_t first = length < ring_size - offset ? length : ring_size - offset;
+        struct iovec iov[2] = {{ring + offset, first}, {ring, length - first}};
+        if (!writeAll(iov, length > first ? 2 : 1)) perror("Error writing log file");
+        else segment_size += length;
+
+        tail.store(end, std::memory_order_release);
+        checkRotation();    // Segments end after a whole batch, so they never split a message
+    }
+    return NULL;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Rotate the log at path when it reaches max_size bytes or is interval_s seconds old
+void setLogRotation(const char* path, long long max_size, int interval_s, int keep) {
+    if (strlen(path) >= PATH_MAX || (max_size <= 0 && interval_s <= 0)) {
+        log_path[0] = '\0';
+        return;
+    }
+    strcpy(log_path, path);
+    rotate_size = max_size;
+    rotate_interval = interval_s;
+    keep_segments = keep > 0 ? keep : LOG_KEEP_DEFAULT;
+    last_segment = findLastSegment();
+}
+
+// Start the flusher thread for log_fd
+bool openLogger(int log_fd, size_t capacity, bool block) {
+    if (running) return true;
+
+    ring_size = 4096;
+    while (ring_size < capacity) ring_size <<= 1;
+    ring = (char*)malloc(ring_size);
+    if (!ring) {
+        perror("Memory allocation failed for log buffer");
+        return false;
+    }
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        perror("Error creating log wakeup");
+        free(ring);
+        ring = NULL;
+        return false;
+    }
+
+    logger_fd = log_fd;
+    block_when_full = block;
+
+    // The log is appended to, count what a previous run left in it
+    struct stat st;
+    segment_size = fstat(log_fd, &st) == 0 ? st.st_size : 0;
+    segment_start = time(NULL);
+    head.store(0);
+    tail.store(0);
+    stopping.store(false);
+    if (pthread_create(&flusher_thread, NULL, flushLoop, NULL) != 0) {
+        perror("Error starting log flusher");
+        close(wake_fd);
+        free(ring);
+        ring = NULL;
+        return false;
+    }
+
+    running = true;
+    setLogWriter(log_fd, logMessage);
+    atexit(closeLogger);    // Early exit() calls still write out the log
+    return true;
+}
+
+// Queue a message for the log file
+bool logMessage(const char* msg, size_t length) {
+    if (!running) return false;
+    if (length == 0) return true;
+
+    uint64_t position = head.load(std::memory_order_relaxed);
+    while (ring_size - (position - tail.load(std::memory_order_acquire)) < length) {
+        if (!block_when_full || length > ring_size) {
+            dropped.fetch_add(1);
+            return false;
+        }
+        wakeFlusher();
+        usleep(BLOCK_WAIT_US);
+    }
+
+    // Copy the message, wrapping around the end of the ring
+    size_t offset = position & (ring_size - 1);
+    size_t first = length < ring_size - offset ? length : ring_size - offset;
+    memcpy(ring + offset, msg, first);
+    memcpy(ring, msg + first, length - first);
+
+    head.store(position + length);
+    if (flusher_idle.load()) wakeFlusher();
+    return true;
+}
+
+// Messages dropped because the ring was full
+uint64_t getLogDropped() {
+    return dropped.load();
+}
+
+// Write out everything queued and stop the flusher thread
+void closeLogger() {
+    if (!running) return;
+
+    setLogWriter(-1, NULL);
+    stopping.store(true);
+    wakeFlusher();
+    pthread_join(flusher_thread, NULL);
+
+    close(wake_fd);
+    wake_fd = -1;
+    free(ring);
+    ring = NULL;
+    running = false;
+}
\ No newline at end of file
@@ -8,107 +8,79 @@
 
 // message_utils: Functions to handle timestamp generation, message formatting and buffering
 
-// Returns dynamically allocated timestamp string in [YYYY/MM/DD HH:MM:SS] format
-// Caller is responsible for freeing the returned string
-char* getTimestamp() {
+// Log writer set by setLogWriter()
+static int log_writer_fd = -1;
+static log_writer_t log_writer = NULL;
+
+// Request whose output is being sent to the console (-1 = plain text without frames)
+static long long response_id = -1;
+
+// Writer set by setConsoleWriter()
+static console_writer_t console_writer = NULL;
+
+// Returns the current timestamp in [YYYY-MM-DD HH:MM:SS] format
+// localtime/strftime only run when the second changes
+const char* currentTimestamp() {
+    static char cached[TIMESTAMP_SIZE] = "";
+    static time_t cached_second = -1;
+
     time_t now = time(NULL);
-    struct tm *tm_now = localtime(&now);
-    
-    // Allocate memory for timestamp
-    char* timestamp_str = (char*)malloc(TIMESTAMP_SIZE);
-    if (!timestamp_str) {
-        perror("Memory allocation failed for timestamp");
-        return NULL;
+    if (now != cached_second) {
+        struct tm tm_now;
+        localtime_r(&now, &tm_now);
+        strftime(cached, TIMESTAMP_SIZE, "[%Y-%m-%d %H:%M:%S] ", &tm_now);
+        cached_second = now;
     }
-    
-    strftime(timestamp_str, TIMESTAMP_SIZE, "[%Y-%m-%d %H:%M:%S] ", tm_now);
-    return timestamp_str;
+    return cached;
 }
 
-// Add timestamp to the beginning of a message
-// Returns reallocated message buffer with timestamp
-char* addTimestampToMessage(char* msg, const char* custom_timestamp) {
-    if (!msg) return NULL;
-    
-    // Get the timestamp
-    char* timestamp;
-    if (custom_timestamp != NULL) {
-        timestamp = strdup(custom_timestamp);
-    } else {
-        timestamp = getTimestamp();
-    }
-    if (!timestamp) return msg;  // Return original if timestamp fails
-    
-    // Reallocate the original msg buffer to fit timestamp + original content
-    size_t timestamp_len = strlen(timestamp);
-    size_t msg_len = strlen(msg);
-    size_t total_len = timestamp_len + msg_len + 1;
-    
-    char* new_msg = (char*)realloc(msg, total_len);
-    if (!new_msg) {
-        free(timestamp);
-        return msg;  // Return original if realloc fails
-    }
-    
-    memmove(new_msg + timestamp_len, new_msg, msg_len + 1); // Move original message content to make room for timestamp
-    memcpy(new_msg, timestamp, timestamp_len);  // Copy timestamp to beginning of buffer
-    
-    free(timestamp);
-    return new_msg;  // Return the possibly reallocated pointer
+// Append the current timestamp (or custom_timestamp if not NULL) to a message
+void appendTimestamp(str_builder* msg, const char* custom_timestamp) {
+    sbAppend(msg, custom_timestamp != NULL ? custom_timestamp : currentTimestamp());
 }
 
-// Concatenate a message to an existing dynamically allocated buffer
-// If the buffer is NULL, a new buffer is created
-// Returns the new or expanded buffer; caller is responsible for freeing it
-char* appendToBuffer(char* existing_buffer, const char* msg) {
-    if (!msg || strlen(msg) == 0) {
-        return existing_buffer;  // Nothing to append
-    }
-    
-    size_t msg_len = strlen(msg);
-    
-    if (!existing_buffer) {
-        // No existing buffer, just duplicate the message
-        return strdup(msg);
-    }
-    
-    size_t buffer_len = strlen(existing_buffer);
-    size_t new_len = buffer_len + msg_len + 1;  // +1 for null terminator
-    
-    // Reallocate buffer to fit the additional message
-    char* new_buffer = (char*)realloc(existing_buffer, new_len);
-    if (!new_buffer) {
-        // If reallocation fails, don't lose the original buffer
-        perror("Memory reallocation failed for appending message");
-        return existing_buffer;
-    }
-    
-    // Append message to buffer
-    strcat(new_buffer, msg);
-    return new_buffer;
+// Start a message with the current timestamp
+void startMessage(str_builder* msg) {
+    sbInit(msg);
+    appendTimestamp(msg, NULL);
 }
 
-// Sends messages to log file and console's terminal
-void forwardMessage(const char* msg, int fss_out, int log_fd) {
-    if (!msg) return;
-    
-    if (log_fd > 0) {
-        // Write message to log file
-        write(log_fd, msg, strlen(msg));
-    }
-    
-    if (fss_out != -1) {
-        // Write message to console's terminal in chunks
-        size_t msg_len = strlen(msg);
+// Route the writes to log_fd through writer (NULL = write directly)
+void setLogWriter(int log_fd, log_writer_t writer) {
+    log_writer_fd = writer ? log_fd : -1;
+    log_writer = writer;
+}
+
+// Frame the messages sent to the console as output of request id
+void setResponseId(long long id) {
+    response_id = id;
+}
+
+long long getResponseId() {
+    return response_id;
+}
+
+// Route the console writes of the writer's own descriptors through it (NULL = write directly)
+void setConsoleWriter(console_writer_t writer) {
+    console_writer = writer;
+}
+
+// Send one frame (header + message) to a console
+void writeConsole(int fss_out, const char* header, size_t header_len, const char* msg, size_t msg_len) {
+    if (console_writer && console_writer(fss_out, header, header_len, msg, msg_len)) return;
+
+    // Write header and message to the pipe in chunks
+    const char* parts[2] = {header, msg};
+    size_t lengths[2] = {header_len, msg_len};
+    for (int part = 0; part < 2; part++) {
         size_t bytes_sent = 0;
-        
-        while (bytes_sent < msg_len) {
+        while (bytes_sent < lengths[part]) {
             // Calculate how many bytes to send in this chunk
-            size_t chunk_size = (msg_len - bytes_sent) < PIPE_BUF ? 
-                               (msg_len - bytes_sent) : PIPE_BUF;
+            size_t chunk_size = (lengths[part] - bytes_sent) < PIPE_BUF ? 
+                               (lengths[part] - bytes_sent) : PIPE_BUF;
             
             // Write the chunk
-            ssize_t written = write(fss_out, msg + bytes_sent, chunk_size);
+            ssize_t written = write(fss_out, parts[part] + bytes_sent, chunk_size);
             
             if (written < 0) {
                 if (errno == EINTR) {
@@ -116,13 +88,48 @@ void forwardMessage(const char* msg, int fss_out, int log_fd) {
                     continue;
                 }
                 
+                // No console is reading (e.g. a batch console that already exited), drop the message
+                if (errno == EPIPE) return;
+                
                 // Real error
                 perror("Error sending message to console");
-                break;
+                return;
             }
             
             // Update the number of bytes sent
             bytes_sent += written;
         }
     }
+}
+
+// Sends messages to log file and console's terminal
+void forwardMessage(const char* msg, int fss_out, int log_fd) {
+    if (!msg) return;
+    
+    if (log_fd > 0) {
+        // Write message to log file (queued if a log writer owns the file)
+        if (log_writer && log_fd == log_writer_fd) {
+            log_writer(msg, strlen(msg));
+        } else {
+            write(log_fd, msg, strlen(msg));
+        }
+    }
+    
+    if (fss_out != -1) {
+        size_t msg_len = strlen(msg);
+        if (response_id < 0) {
+            writeConsole(fss_out, "", 0, msg, msg_len);
+            return;
+        }
+
+        // Frames "#<id> <length>\n<payload>", long messages are split so a frame fits in one socket packet
+        size_t offset = 0;
+        do {
+            size_t length = msg_len - offset < FRAME_PAYLOAD_MAX ? msg_len - offset : FRAME_PAYLOAD_MAX;
+            char header[48];
+            int header_len = snprintf(header, sizeof(header), "#%lld %zu\n", response_id, length);
+            writeConsole(fss_out, header, header_len, msg + offset, length);
+            offset += length;
+        } while (offset < msg_len);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,423 @@
+#include "../header/metrics.h"
+#include "../header/sync_database.h"
+#include "../header/task_manager.h"
+#include "../header/monitor_manager.h"
+#include "../header/settings.h"
+#include "../header/throttle.h"
+#include "../header/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Metrics: Counters and latency histograms of the manager, shown by the stats command and exported as OpenMetrics text
+
+// Default seconds between metrics file updates (see settings.h)
+#define METRICS_INTERVAL 10
+
+// Upper bounds of the histogram buckets in seconds (x4 per bucket, the last bucket is +Inf)
+static const double bucket_bounds[HISTOGRAM_BUCKETS - 1] = {
+    0.0001, 0.0004, 0.0016, 0.0064, 0.0256, 0.1024, 0.4096,
+    1.6384, 6.5536, 26.2144, 104.8576, 419.4304, 1677.7216
+};
+
+// Names of the latency stages shown by status
+static const char* stage_names[LATENCY_STAGES] = {
+    "Queued", "Startup", "Copy", "Report", "Event to Target"
+};
+
+manager_metrics metrics = {};
+static uint64_t last_export_ns = 0;
+
+///// HELPER FUNCTIONS /////
+
+// Upper bound of the bucket that holds the given quantile (0.0 - 1.0)
+static double histogramQuantile(const latency_histogram* histogram, double quantile) {
+    if (histogram->count == 0) return 0;
+
+    uint64_t rank = (uint64_t)(quantile * histogram->count);
+    if (rank >= histogram->count) rank = histogram->count - 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS - 1; i++) {
+        seen += histogram->buckets[i];
+        if (seen > rank) return bucket_bounds[i] < histogram->max ? bucket_bounds[i] : histogram->max;
+    }
+    return histogram->max;   // Value is in the +Inf bucket
+}
+
+// Bucket index of a value in an HDR histogram
+static int hdrBucketIndex(uint64_t value) {
+    if (value < 2 * HDR_SUB_BUCKETS) return (int)value;
+
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - 4;    // log2(HDR_SUB_BUCKETS), keeps the top 5 bits of the value
+    if (shift > HDR_MAX_SHIFT) return HDR_BUCKETS - 1;
+    return shift * HDR_SUB_BUCKETS + (int)(value >> shift);
+}
+
+// Highest value that falls into a bucket of an HDR histogram
+static uint64_t hdrBucketValue(int index) {
+    if (index < 2 * HDR_SUB_BUCKETS) return (uint64_t)index;
+
+    int shift = index / HDR_SUB_BUCKETS - 1;
+    uint64_t sub_bucket = (uint64_t)(index - shift * HDR_SUB_BUCKETS);
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+// Add a value to an HDR histogram
+static void hdrRecord(hdr_histogram* histogram, uint64_t value) {
+    histogram->counts[hdrBucketIndex(value)]++;
+    histogram->count++;
+    if (value > histogram->max) histogram->max = value;
+}
+
+// Value at the given percentile (0 - 100) of an HDR histogram
+static uint64_t hdrPercentile(const hdr_histogram* histogram, double percentile) {
+    if (histogram->count == 0) return 0;
+
+    uint64_t rank = (uint64_t)(percentile / 100 * histogram->count + 0.5);
+    if (rank < 1) rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HDR_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint64_t value = hdrBucketValue(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+// Microseconds between two timestamps (0 if one is missing or they are out of order)
+static uint64_t intervalUs(uint64_t start_ns, uint64_t end_ns) {
+    if (!start_ns || !end_ns || end_ns < start_ns) return 0;
+    return (end_ns - start_ns) / 1000;
+}
+
+// Format a histogram as a single line of text (times in ms)
+static void appendHistogram(str_builder* msg, const char* name, const latency_histogram* histogram) {
+    sbAppendFormat(msg, "%s: %llu samples, avg %.3f ms, p50 <= %.3f ms, p99 <= %.3f ms, max %.3f ms\n",
+                   name,
+                   (unsigned long long)histogram->count,
+                   histogram->count ? histogram->sum / histogram->count * 1000 : 0.0,
+                   histogramQuantile(histogram, 0.50) * 1000,
+                   histogramQuantile(histogram, 0.99) * 1000,
+                   histogram->max * 1000);
+}
+
+// Write a label value with '\', '"' and newlines escaped
+static void writeLabelValue(FILE* file, const char* value) {
+    for (const char* c = value; *c; c++) {
+        if (*c == '\\' || *c == '"') {
+            fputc('\\', file);
+            fputc(*c, file);
+        } else if (*c == '\n') {
+            fputs("\\n", file);
+        } else {
+            fputc(*c, file);
+        }
+    }
+}
+
+// Write a counter or gauge with no labels
+static void writeMetric(FILE* file, const char* name, const char* type, const char* help, long long value) {
+    fprintf(file, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+    fprintf(file, "%s%s %lld\n", name, strcmp(type, "counter") == 0 ? "_total" : "", value);
+}
+
+// Write a histogram (buckets are cumulative in OpenMetrics)
+static void writeHistogram(FILE* file, const char* name, const char* help, const latency_histogram* histogram) {
+    fprintf(file, "# TYPE %s histogram\n# HELP %s %s\n", name, name, help);
+
+    uint64_t cumulative = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS - 1; i++) {
+        cumulative += histogram->buckets[i];
+        fprintf(file, "%s_bucket{le=\"%.4f\"} %llu\n", name, bucket_bounds[i], (unsigned long long)cumulative);
+    }
+    fprintf(file, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)histogram->count);
+    fprintf(file, "%s_sum %f\n", name, histogram->sum);
+    fprintf(file, "%s_count %llu\n", name, (unsigned long long)histogram->count);
+}
+
+// Write a per-pair counter
+static void writePairCounter(FILE* file, const char* name, const char* help, long long sync_info_entry::*field) {
+    fprintf(file, "# TYPE %s counter\n# HELP %s %s\n", name, name, help);
+    for (const sync_info_entry& info : sync_info) {
+        fprintf(file, "%s_total{source=\"", name);
+        writeLabelValue(file, info.source_dir);
+        fprintf(file, "\",target=\"");
+        writeLabelValue(file, info.target_dir);
+        fprintf(file, "\"} %lld\n", info.*field);
+    }
+}
+
+// Write the p50/p99/p999 of the pairs' event-to-target latency as a summary
+static void writePairLatencySummary(FILE* file) {
+    const char* name = "fss_pair_event_to_target_seconds";
+    fprintf(file, "# TYPE %s summary\n# HELP %s %s\n", name, name,
+            "Time from the inotify event until the change is copied to the target.");
+
+    static const char* quantiles[] = {"0.5", "0.99", "0.999"};
+    for (const sync_info_entry& info : sync_info) {
+        if (!info.latency) continue;
+        const hdr_histogram* histogram = &info.latency->stages[LATENCY_TOTAL];
+
+        for (int i = 0; i < 3; i++) {
+            fprintf(file, "%s{source=\"", name);
+            writeLabelValue(file, info.source_dir);
+            fprintf(file, "\",quantile=\"%s\"} %f\n", quantiles[i],
+                    hdrPercentile(histogram, atof(quantiles[i]) * 100) / 1e6);
+        }
+        fprintf(file, "%s_count{source=\"", name);
+        writeLabelValue(file, info.source_dir);
+        fprintf(file, "\"} %llu\n", (unsigned long long)histogram->count);
+    }
+}
+
+// Write the CPU time and block I/O of the workers of each operation
+static void writeOpUsage(FILE* file) {
+    const char* name = "fss_worker_cpu_seconds";
+    fprintf(file, "# TYPE %s counter\n# HELP %s %s\n", name, name, "CPU time used by the workers of each operation.");
+    for (int op = 0; op < TASK_OPS; op++) {
+        const task_usage* usage = &metrics.op_usage[op];
+        fprintf(file, "%s_total{op=\"%s\",mode=\"user\"} %f\n", name, taskOpName((task_op)op), usage->user_us / 1e6);
+        fprintf(file, "%s_total{op=\"%s\",mode=\"system\"} %f\n", name, taskOpName((task_op)op), usage->sys_us / 1e6);
+    }
+
+    name = "fss_worker_blocks";
+    fprintf(file, "# TYPE %s counter\n# HELP %s %s\n", name, name, "Blocks (512 bytes) read and written by the workers of each operation.");
+    for (int op = 0; op < TASK_OPS; op++) {
+        const task_usage* usage = &metrics.op_usage[op];
+        fprintf(file, "%s_total{op=\"%s\",direction=\"in\"} %llu\n", name, taskOpName((task_op)op),
+                (unsigned long long)usage->in_blocks);
+        fprintf(file, "%s_total{op=\"%s\",direction=\"out\"} %llu\n", name, taskOpName((task_op)op),
+                (unsigned long long)usage->out_blocks);
+    }
+}
+
+// Write all metrics to file
+static void writeMetricsFile(FILE* file) {
+    writeMetric(file, "fss_tasks_enqueued", "counter", "Tasks added to the queue.", (long long)metrics.tasks_enqueued);
+    writeMetric(file, "fss_tasks_dispatched", "counter", "Tasks given to a worker.", (long long)metrics.tasks_dispatched);
+    writeMetric(file, "fss_tasks_completed", "counter", "Tasks whose worker finished.", (long long)metrics.tasks_completed);
+    writeMetric(file, "fss_tasks_failed", "counter", "Tasks that finished with PARTIAL or ERROR status.", (long long)metrics.tasks_failed);
+    writeMetric(file, "fss_queue_collapses", "counter", "Backlogs of a pair replaced by a single full sync.", (long long)metrics.queue_collapses);
+    writeMetric(file, "fss_queue_depth", "gauge", "Tasks waiting in the queue, including the spilled and staggered ones.", getQueuedTaskCount());
+    writeMetric(file, "fss_active_workers", "gauge", "Running worker processes.", getActiveWorkerCount());
+    writeMetric(file, "fss_inotify_overflows", "counter", "Times the inotify event queue overflowed.", inotify_overflow_count);
+    writeMetric(file, "fss_log_dropped", "counter", "Log messages dropped because the log buffer was full.", (long long)getLogDropped());
+
+    writeHistogram(file, "fss_worker_spawn_seconds", "Time to create a worker process.", &metrics.spawn_latency);
+    writeHistogram(file, "fss_task_completion_seconds", "Time from enqueue until the worker report is processed.", &metrics.completion_latency);
+    writeOpUsage(file);
+
+    writePairCounter(file, "fss_pair_bytes_copied", "Bytes copied for the pair.", &sync_info_entry::bytes_copied);
+    writePairCounter(file, "fss_pair_files_copied", "Files copied for the pair.", &sync_info_entry::files_copied);
+    writePairCounter(file, "fss_pair_tasks_completed", "Tasks of the pair that finished.", &sync_info_entry::tasks_completed);
+    writePairCounter(file, "fss_pair_tasks_failed", "Tasks of the pair that finished with PARTIAL or ERROR status.", &sync_info_entry::tasks_failed);
+    writePairLatencySummary(file);
+
+    fprintf(file, "# EOF\n");
+}
+
+// Add the resources of one worker to a total
+static void addTaskUsage(task_usage* total, const task_usage* task) {
+    total->tasks += task->tasks;
+    total->user_us += task->user_us;
+    total->sys_us += task->sys_us;
+    if (task->max_rss_kb > total->max_rss_kb) total->max_rss_kb = task->max_rss_kb;
+    total->in_blocks += task->in_blocks;
+    total->out_blocks += task->out_blocks;
+    total->voluntary_cs += task->voluntary_cs;
+    total->involuntary_cs += task->involuntary_cs;
+}
+
+// Append a usage total as one line of status ("<label>: N tasks, CPU ...")
+static void appendUsageLine(str_builder* msg, const char* label, const task_usage* usage) {
+    sbAppendFormat(msg, "%s: %llu tasks, CPU %.3f s user / %.3f s sys, max RSS %llu KB, "
+                   "blocks %llu in / %llu out, context switches %llu / %llu\n",
+                   label,
+                   (unsigned long long)usage->tasks,
+                   usage->user_us / 1e6,
+                   usage->sys_us / 1e6,
+                   (unsigned long long)usage->max_rss_kb,
+                   (unsigned long long)usage->in_blocks,
+                   (unsigned long long)usage->out_blocks,
+                   (unsigned long long)usage->voluntary_cs,
+                   (unsigned long long)usage->involuntary_cs);
+}
+
+///// MAIN FUNCTIONS /////
+
+// Add a value (in seconds) to a histogram
+void observeLatency(latency_histogram* histogram, double seconds) {
+    int bucket = 0;
+    while (bucket < HISTOGRAM_BUCKETS - 1 && seconds > bucket_bounds[bucket]) bucket++;
+
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->sum += seconds;
+    if (seconds > histogram->max) histogram->max = seconds;
+}
+
+// Add the stage intervals of a finished task to the histograms of its pair (allocated on first use)
+void recordTaskLatency(sync_info_entry* entry, const task_timing* timing) {
+    if (!entry->latency) {
+        entry->latency = (pair_latency*)calloc(1, sizeof(pair_latency));
+        if (!entry->latency) return;
+    }
+    hdr_histogram* stages = entry->latency->stages;
+
+    hdrRecord(&stages[LATENCY_QUEUED], intervalUs(timing->enqueued_ns, timing->dispatched_ns));
+
+    // Workers that failed before copying do not report the copy times
+    if (!timing->copy_start_ns || !timing->copy_end_ns) return;
+
+    hdrRecord(&stages[LATENCY_STARTUP], intervalUs(timing->dispatched_ns, timing->copy_start_ns));
+    hdrRecord(&stages[LATENCY_COPY], intervalUs(timing->copy_start_ns, timing->copy_end_ns));
+    hdrRecord(&stages[LATENCY_REPORT], intervalUs(timing->copy_end_ns, timing->parsed_ns));
+    hdrRecord(&stages[LATENCY_TOTAL], intervalUs(timing->event_ns, timing->copy_end_ns));
+}
+
+// Add the resources used by a finished worker to its pair and to its operation
+void recordTaskUsage(sync_info_entry* entry, task_op op, const struct rusage* rusage, task_usage* task) {
+    task->tasks = 1;
+    task->user_us = rusage->ru_utime.tv_sec * 1000000ULL + rusage->ru_utime.tv_usec;
+    task->sys_us = rusage->ru_stime.tv_sec * 1000000ULL + rusage->ru_stime.tv_usec;
+    task->max_rss_kb = rusage->ru_maxrss;   // Already in KB on Linux
+    task->in_blocks = rusage->ru_inblock;
+    task->out_blocks = rusage->ru_oublock;
+    task->voluntary_cs = rusage->ru_nvcsw;
+    task->involuntary_cs = rusage->ru_nivcsw;
+
+    if (op < TASK_OPS) addTaskUsage(&metrics.op_usage[op], task);
+    if (!entry) return;
+    if (!entry->usage) {
+        entry->usage = (task_usage*)calloc(1, sizeof(task_usage));
+        if (!entry->usage) return;
+    }
+    addTaskUsage(entry->usage, task);
+}
+
+// Append resource usage to a message (end of a worker's log line)
+void appendTaskUsage(str_builder* msg, const task_usage* usage) {
+    sbAppendFormat(msg, " (cpu %.1f+%.1f ms, rss %llu KB, io %llu/%llu blocks, cs %llu/%llu)",
+                   usage->user_us / 1000.0,
+                   usage->sys_us / 1000.0,
+                   (unsigned long long)usage->max_rss_kb,
+                   (unsigned long long)usage->in_blocks,
+                   (unsigned long long)usage->out_blocks,
+                   (unsigned long long)usage->voluntary_cs,
+                   (unsigned long long)usage->involuntary_cs);
+}
+
+// Append the resources used by the pair's workers to a message
+void appendPairUsage(str_builder* msg, const sync_info_entry* entry) {
+    if (entry->usage) appendUsageLine(msg, "Resources", entry->usage);
+}
+
+// Append the resources used by the workers of each operation to a message
+void appendOpUsage(str_builder* msg) {
+    sbAppend(msg, "Resources by operation:\n");
+    for (int op = 0; op < TASK_OPS; op++) {
+        char label[32];
+        snprintf(label, sizeof(label), "  %s", taskOpName((task_op)op));
+        appendUsageLine(msg, label, &metrics.op_usage[op]);
+    }
+}
+
+// Append p50/p99/p999 of the pair's stage histograms to a message
+void appendPairLatency(str_builder* msg, const sync_info_entry* entry) {
+    if (!entry->latency) return;
+
+    sbAppend(msg, "Latency (p50 / p99 / p999):\n");
+    for (int i = 0; i < LATENCY_STAGES; i++) {
+        const hdr_histogram* histogram = &entry->latency->stages[i];
+        sbAppendFormat(msg, "  %s: %.3f / %.3f / %.3f ms (%llu tasks)\n",
+                       stage_names[i],
+                       hdrPercentile(histogram, 50) / 1000.0,
+                       hdrPercentile(histogram, 99) / 1000.0,
+                       hdrPercentile(histogram, 99.9) / 1000.0,
+                       (unsigned long long)histogram->count);
+    }
+}
+
+// Append metrics of a directory (or of the whole manager if source is "all") to a message
+bool appendStats(str_builder* msg, const char* source) {
+    if (strcmp(source, "all") != 0) {
+        sync_info_entry* info = getSyncInfo(source);
+        if (info == NULL) return false;
+
+        sbAppendFormat(msg,
+            "Source: %s\n"
+            "Target: %s\n"
+            "Tasks: %lld completed, %lld failed, %d queued\n"
+            "Copied: %lld files, %lld bytes\n"
+            "Throttled: %lld ms\n"
+            "Rescans: %d\n",
+            info->source_dir,
+            info->target_dir,
+            info->tasks_completed,
+            info->tasks_failed,
+            info->queued_tasks,
+            info->files_copied,
+            info->bytes_copied,
+            info->throttled_ms,
+            info->rescan_count);
+        return true;
+    }
+
+    long long bytes_copied = 0, files_copied = 0;
+    for (const sync_info_entry& info : sync_info) {
+        bytes_copied += info.bytes_copied;
+        files_copied += info.files_copied;
+    }
+
+    sbAppendFormat(msg,
+        "Tasks: %llu enqueued, %llu dispatched, %llu completed, %llu failed\n"
+        "Queue: %d queued, %d active workers, %llu backlogs collapsed\n"
+        "Inotify Overflows: %lld\n"
+        "Copied: %lld files, %lld bytes (%d directories)\n",
+        (unsigned long long)metrics.tasks_enqueued,
+        (unsigned long long)metrics.tasks_dispatched,
+        (unsigned long long)metrics.tasks_completed,
+        (unsigned long long)metrics.tasks_failed,
+        getQueuedTaskCount(),
+        getActiveWorkerCount(),
+        (unsigned long long)metrics.queue_collapses,
+        inotify_overflow_count,
+        files_copied,
+        bytes_copied,
+        (int)sync_info.size());
+    appendHistogram(msg, "Spawn Latency", &metrics.spawn_latency);
+    appendHistogram(msg, "Completion Latency", &metrics.completion_latency);
+    return true;
+}
+
+// Write metrics to the OpenMetrics text file if the export interval has passed
+void exportMetrics(bool force) {
+    if (!settings.metrics_path[0]) return;
+
+    uint64_t now = getMonotonicNs();
+    int interval = settings.metrics_interval > 0 ? settings.metrics_interval : METRICS_INTERVAL;
+    if (!force && last_export_ns && now - last_export_ns < (uint64_t)interval * 1000000000ULL) return;
+    last_export_ns = now;
+
+    // Write a temporary file and rename it, so the scraper never sees a partial file
+    char tmp_path[PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", settings.metrics_path);
+
+    FILE* file = fopen(tmp_path, "w");
+    if (!file) {
+        perror("Error opening metrics file");
+        return;
+    }
+    writeMetricsFile(file);
+
+    if (fclose(file) != 0 || rename(tmp_path, settings.metrics_path) < 0) {
+        perror("Error writing metrics file");
+        unlink(tmp_path);
+    }
+}
\ No newline at end of file
@@ -12,9 +12,75 @@
 #include "../header/message_utils.h"
 #include "../header/monitor_manager.h"
 #include "../header/task_manager.h"
+#include "../header/throttle.h"
+#include "../header/trace.h"
+#include "../header/log_index.h"
 
 // Monitor Manager: Using inotify, the following functions manage directory monitoring
 
+// Size of the buffer used to drain the inotify queue
+#define INOTIFY_BUF_LEN (64 * 1024)
+
+// Reads per call of handleDirChange(), so an event storm does not keep the loop from workers and commands
+// (poll() reports the rest of the queue again right away)
+#define INOTIFY_MAX_READS 16
+
+long long inotify_overflow_count = 0;
+
+///// HELPER FUNCTIONS /////
+
+// Read the kernel's inotify queue size (for the overflow message)
+static long readMaxQueuedEvents() {
+    long max_events = -1;
+    FILE* file = fopen("/proc/sys/fs/inotify/max_queued_events", "r");
+    if (file) {
+        if (fscanf(file, "%ld", &max_events) != 1) max_events = -1;
+        fclose(file);
+    }
+    return max_events;
+}
+
+// The kernel does not say which watches lost events, so rescan every monitored pair
+// Pairs that already have a pending full sync are not queued again
+// Appends the message for the log to output
+static void handleQueueOverflow(str_builder* output) {
+    inotify_overflow_count++;
+    
+    int rescans = 0;
+    for (sync_info_entry& info : sync_info) {
+        if (info.wd >= 0 && queueRescan(&info)) {
+            rescans++;
+        }
+    }
+    
+    appendTimestamp(output, NULL);
+    sbAppendFormat(output, "Inotify queue overflow (total: %lld, max_queued_events: %ld), rescanning %d directories\n",
+                   inotify_overflow_count, readMaxQueuedEvents(), rescans);
+}
+
+// Watch of a monitored pair was removed by the kernel, try to watch the directory again and rescan it
+// Appends the message for the log to output (nothing if the watch did not belong to a monitored pair)
+static void handleWatchRemoved(int inotify_fd, int wd, str_builder* output) {
+    sync_info_entry* info = getSyncInfoByWatch(wd);
+    if (!info) return;
+    
+    appendTimestamp(output, NULL);
+    setSyncWatch(info, addDirToMonitor(inotify_fd, info->source_dir));
+    if (info->wd >= 0) {
+        queueRescan(info);
+        sbAppend(output, "Watch lost for ");
+        sbAppend(output, info->source_dir);
+        sbAppend(output, ", monitoring restarted and rescan queued\n");
+    } else {
+        sbAppend(output, "Monitoring stopped for ");
+        sbAppend(output, info->source_dir);
+        sbAppend(output, " (watch removed by the kernel)\n");
+        indexMonitoring(info->source_dir, false);
+    }
+}
+
+///// MAIN FUNCTIONS /////
+
 // Initialize monitor manager (inotify), returns file descriptor
 int initMonitorManager() {
     int inotify_fd = inotify_init1(IN_NONBLOCK);
@@ -28,7 +94,8 @@ int initMonitorManager() {
 
 // Add directory to monitor by creating an inotify watch
 int addDirToMonitor(int inotify_fd, const char* dir_path) {
-    int wd = inotify_add_watch(inotify_fd, dir_path, IN_CREATE | IN_MODIFY | IN_DELETE);
+    int wd = inotify_add_watch(inotify_fd, dir_path, IN_CREATE | IN_MODIFY | IN_DELETE |
+                                                     IN_MOVED_FROM | IN_MOVED_TO);
     if (wd < 0) {
         perror("inotify_add_watch");
         return -1;
@@ -46,86 +113,98 @@ int rmvDirFromMonitor(int inotify_fd, int wd) {
 
 // Handle changes in one of the monitoring directories (process inotify events)
 void handleDirChange(int inotify_fd, int fss_out, int log_fd) {
+    // Large buffer, aligned for struct inotify_event, so that a burst is drained with few reads
+    static char buffer[INOTIFY_BUF_LEN] __attribute__((aligned(__alignof__(struct inotify_event))));
     const int EVENT_SIZE = sizeof(struct inotify_event);
-    const int BUF_LEN = 128 * (EVENT_SIZE + 16);
-    char buffer[BUF_LEN];
-    char* output_buf = NULL;
+    str_builder output;
+    sbInit(&output);
+    uint64_t batch_start_ns = trace_enabled ? getMonotonicNs() : 0;
+    int event_count = 0;
     
-    int length = read(inotify_fd, buffer, BUF_LEN);
-    
-    if (length < 0) {
-        if (errno != EAGAIN) {
-            perror("read from inotify fd");
+    // Read until the inotify queue is empty (otherwise the kernel may drop events), at most INOTIFY_MAX_READS times
+    for (int reads = 0; reads < INOTIFY_MAX_READS; reads++) {
+        ssize_t length = read(inotify_fd, buffer, INOTIFY_BUF_LEN);
+        
+        if (length < 0) {
+            if (errno == EINTR) {
+                reads--;
+                continue;
+            }
+            if (errno != EAGAIN) {
+                perror("read from inotify fd");
+            }
+            break;
         }
-        return;
-    }
-    
-    int i = 0;
-    while (i < length) {    // Read all events
-        struct inotify_event *event = (struct inotify_event*)&buffer[i];
+        if (length == 0) break;
+        uint64_t event_ns = getMonotonicNs();   // Time the events of this read reached the manager
         
-        // Skip directory events
-        if (!(event->mask & IN_ISDIR)) {
+        ssize_t i = 0;
+        while (i < length) {    // Read all events
+            struct inotify_event *event = (struct inotify_event*)&buffer[i];
+            i += EVENT_SIZE + event->len;
+            event_count++;
+            
+            // Kernel queue overflowed, events were lost
+            if (event->mask & IN_Q_OVERFLOW) {
+                handleQueueOverflow(&output);
+                continue;
+            }
+            
+            // Watch was removed by the kernel (directory deleted, moved or unmounted)
+            if (event->mask & IN_IGNORED) {
+                handleWatchRemoved(inotify_fd, event->wd, &output);
+                continue;
+            }
+            
+            // Skip directory events
+            if (event->mask & IN_ISDIR) continue;
+            
             // Find which directory this event belongs to
-            for (auto& pair : sync_info) {
-                if (pair.second.wd == event->wd) {
-                    const char* operation = "";
-                    bool valid_event = true;
-                    
-                    // Determine the type of event
-                    if (event->mask & IN_CREATE) {
-                        operation = "ADDED";
-                    } else if (event->mask & IN_MODIFY) {
-                        operation = "MODIFIED";
-                    } else if (event->mask & IN_DELETE) {
-                        operation = "DELETED";
-                    } else {
-                        valid_event = false;
-                    }
-                    
-                    if (valid_event) {  // Add task to queue
-                        addTaskToQueue(pair.second.source_dir, pair.second.target_dir,
-                                        event->name, operation, false);
-                        
-                        // // Format the change notification message
-                        // const char* base_msg = "File change detected: ";
-                        // size_t needed_size = strlen(base_msg) + strlen(event->name) + strlen(operation) + 10;
-
-                        // char* event_msg = (char*)malloc(needed_size);
-                        // if (event_msg) {
-                        //     sprintf(event_msg, "File change detected: %s (%s)\n", 
-                        //             event->name, operation);
-                            
-                        //     // Add timestamp
-                        //     event_msg = addTimestampToMessage(event_msg, NULL);
-                        //     if (event_msg) {
-                        //         output_buf = appendToBuffer(output_buf, event_msg);
-                        //         free(event_msg);
-                        //     }
-                        // }
-                    }
-                    break;
-                }
+            sync_info_entry* info = getSyncInfoByWatch(event->wd);
+            if (!info) continue;
+
+            task_op op = OP_ADDED;
+            bool valid_event = true;
+            
+            // Determine the type of event
+            // A file renamed inside or into the directory is a new file, renamed away it is deleted
+            if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                op = OP_ADDED;
+            } else if (event->mask & IN_MODIFY) {
+                op = OP_MODIFIED;
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                op = OP_DELETED;
+            } else {
+                valid_event = false;
+            }
+            
+            if (valid_event) {  // Add task to queue
+                addTaskToQueue(info, event->name, op, false, event_ns);
             }
         }
-        
-        i += EVENT_SIZE + event->len;
     }
     
     // Send notification to console and log if we have any messages
-    if (output_buf && strlen(output_buf) > 0) {
-        forwardMessage(output_buf, fss_out, log_fd);
-        free(output_buf);  // Clean up dynamic memory
+    if (sbLength(&output) > 0) {
+        printf("%s", sbString(&output));
+        forwardMessage(sbString(&output), fss_out, log_fd);
+    }
+    sbFree(&output);
+    
+    if (trace_enabled) {
+        char events[16];
+        sprintf(events, "%d", event_count);
+        traceSpan("handleDirChange", "inotify", 0, batch_start_ns, getMonotonicNs(), "events", events);
     }
 }
 
 // Shutdown and clean up resources used by the monitor manager
 void shutdownMonitorManager(int inotify_fd) {
     // Clean up inotify resources
-    for (auto& pair : sync_info) {
-        if (pair.second.wd >= 0) {
-            rmvDirFromMonitor(inotify_fd, pair.second.wd);
-            pair.second.wd = -1;
+    for (sync_info_entry& info : sync_info) {
+        if (info.wd >= 0) {
+            rmvDirFromMonitor(inotify_fd, info.wd);
+            setSyncWatch(&info, -1);
         }
     }
     close(inotify_fd);
@@ -0,0 +1,194 @@
+#include "../header/priority.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+// Priority: CPU and I/O priority of the workers (shared by the manager and the worker)
+
+// ioprio_set(2) has no glibc wrapper
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_LEVELS 8
+
+static const char* io_class_names[] = {"none", "rt", "be", "idle"};
+
+///// HELPER FUNCTIONS /////
+
+// Class of an option key, and the key without its prefix
+static priority_class splitPriorityKey(const char* key, const char** name) {
+    if (strncmp(key, "event_", 6) == 0) {
+        *name = key + 6;
+        return PRIORITY_EVENT;
+    }
+    if (strncmp(key, "bulk_", 5) == 0) {
+        *name = key + 5;
+        return PRIORITY_BULK;
+    }
+    *name = key;
+    return PRIORITY_ALL;
+}
+
+// Parse a whole decimal number
+static bool parseNumber(const char* value, long* number) {
+    char* end;
+    errno = 0;
+    *number = strtol(value, &end, 10);
+    return end != value && *end == '\0' && errno == 0;
+}
+
+// Parse a CPU list ("0-3,6") into a set, returns false if it is invalid or empty
+static bool parseCpuList(const char* list, cpu_set_t* cpus) {
+    CPU_ZERO(cpus);
+    const char* c = list;
+    while (*c) {
+        char* end;
+        long first = strtol(c, &end, 10);
+        if (end == c || first < 0) return false;
+        long last = first;
+        if (*end == '-') {
+            c = end + 1;
+            last = strtol(c, &end, 10);
+            if (end == c || last < first) return false;
+        }
+        if (last >= CPU_SETSIZE) return false;
+        for (long cpu = first; cpu <= last; cpu++) CPU_SET(cpu, cpus);
+
+        if (*end == ',') end++;
+        else if (*end) return false;
+        c = end;
+    }
+    return CPU_COUNT(cpus) > 0;
+}
+
+// Parse a nice level
+static bool parseNice(const char* value, worker_priority* priority) {
+    long nice;
+    if (!parseNumber(value, &nice) || nice < -20 || nice > 19) return false;
+    priority->has_nice = true;
+    priority->nice = (int)nice;
+    return true;
+}
+
+// Parse an I/O class and level ("idle", "be", "be:4", "rt:0")
+static bool parseIoprio(const char* value, worker_priority* priority) {
+    const char* colon = strchr(value, ':');
+    size_t name_length = colon ? (size_t)(colon - value) : strlen(value);
+
+    int io_class = 0;
+    for (int i = 1; i < 4; i++) {
+        if (strlen(io_class_names[i]) == name_length && strncmp(value, io_class_names[i], name_length) == 0) io_class = i;
+    }
+    if (io_class == 0) return false;
+
+    long level = 4;     // Kernel default of the be and rt classes
+    if (colon && (!parseNumber(colon + 1, &level) || level < 0 || level >= IOPRIO_LEVELS)) return false;
+    priority->has_ioprio = true;
+    priority->io_class = io_class;
+    priority->io_level = (int)level;
+    return true;
+}
+
+// Parse a CPU list
+static bool parseCpus(const char* value, worker_priority* priority) {
+    cpu_set_t cpus;
+    if (strlen(value) >= PRIORITY_CPUS_MAX || !parseCpuList(value, &cpus)) return false;
+    strcpy(priority->cpus, value);
+    return true;
+}
+
+// Parse the value of an option without prefix
+static bool parsePriorityValue(const char* name, const char* value, worker_priority* priority) {
+    if (strcmp(name, "nice") == 0) return parseNice(value, priority);
+    if (strcmp(name, "ioprio") == 0) return parseIoprio(value, priority);
+    if (strcmp(name, "cpus") == 0) return parseCpus(value, priority);
+    return false;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Returns true if key is a priority option
+bool isPriorityOption(const char* key) {
+    const char* name;
+    splitPriorityKey(key, &name);
+    return strcmp(name, "nice") == 0 || strcmp(name, "ioprio") == 0 || strcmp(name, "cpus") == 0;
+}
+
+// Set a priority option in the priorities of each class
+bool setPriorityOption(worker_priority priorities[PRIORITY_CLASSES], const char* key, const char* value) {
+    const char* name;
+    priority_class priority_class = splitPriorityKey(key, &name);
+    return parsePriorityValue(name, value, &priorities[priority_class]);
+}
+
+// Returns true if both set the same values
+bool samePriority(const worker_priority* a, const worker_priority* b) {
+    if (a->has_nice != b->has_nice || (a->has_nice && a->nice != b->nice)) return false;
+    if (a->has_ioprio != b->has_ioprio) return false;
+    if (a->has_ioprio && (a->io_class != b->io_class || a->io_level != b->io_level)) return false;
+    return strcmp(a->cpus, b->cpus) == 0;
+}
+
+// Fill the values that are not set in priority with those of fallback
+void mergePriority(worker_priority* priority, const worker_priority* fallback) {
+    if (!priority->has_nice && fallback->has_nice) {
+        priority->has_nice = true;
+        priority->nice = fallback->nice;
+    }
+    if (!priority->has_ioprio && fallback->has_ioprio) {
+        priority->has_ioprio = true;
+        priority->io_class = fallback->io_class;
+        priority->io_level = fallback->io_level;
+    }
+    if (!priority->cpus[0]) strcpy(priority->cpus, fallback->cpus);
+}
+
+// Format the values that are set as worker arguments
+int formatPriorityArgs(const worker_priority* priority, char args[PRIORITY_ARGS][PRIORITY_ARG_MAX]) {
+    int count = 0;
+    if (priority->has_nice) {
+        snprintf(args[count++], PRIORITY_ARG_MAX, "nice=%d", priority->nice);
+    }
+    if (priority->has_ioprio) {
+        snprintf(args[count++], PRIORITY_ARG_MAX, "ioprio=%s:%d", io_class_names[priority->io_class], priority->io_level);
+    }
+    if (priority->cpus[0]) {
+        snprintf(args[count++], PRIORITY_ARG_MAX, "cpus=%s", priority->cpus);
+    }
+    return count;
+}
+
+// Parse a worker argument made by formatPriorityArgs()
+bool parsePriorityArg(worker_priority* priority, const char* arg) {
+    const char* equals = strchr(arg, '=');
+    if (!equals || (size_t)(equals - arg) >= 8) return false;
+
+    char name[8];
+    memcpy(name, arg, equals - arg);
+    name[equals - arg] = '\0';
+    return parsePriorityValue(name, equals + 1, priority);
+}
+
+// Apply the values that are set to the calling process
+void applyPriority(const worker_priority* priority) {
+    if (priority->has_nice && setpriority(PRIO_PROCESS, 0, priority->nice) < 0) {
+        fprintf(stderr, "Worker: cannot set nice level %d: %s\n", priority->nice, strerror(errno));
+    }
+
+    if (priority->has_ioprio) {
+        int ioprio = (priority->io_class << IOPRIO_CLASS_SHIFT) | priority->io_level;
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, ioprio) < 0) {
+            fprintf(stderr, "Worker: cannot set I/O priority %s:%d: %s\n", io_class_names[priority->io_class],
+                    priority->io_level, strerror(errno));
+        }
+    }
+
+    cpu_set_t cpus;
+    if (priority->cpus[0] && parseCpuList(priority->cpus, &cpus) && sched_setaffinity(0, sizeof(cpus), &cpus) < 0) {
+        fprintf(stderr, "Worker: cannot set CPU affinity %s: %s\n", priority->cpus, strerror(errno));
+    }
+}
\ No newline at end of file
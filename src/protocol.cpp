@@ -0,0 +1,159 @@
+#include "../header/protocol.h"
+#include "../header/message_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+// Protocol: Framing of the commands sent to the manager and of its responses
+
+#define READ_CHUNK (64 * 1024)     // Room for a whole control socket packet
+
+///// HELPER FUNCTIONS /////
+
+// Make room for extra more bytes (plus a NUL), moving the unconsumed data to the front
+static bool reserveFrameBuffer(frame_buffer* buffer, size_t extra) {
+    if (buffer->start > 0) {
+        memmove(buffer->data, buffer->data + buffer->start, buffer->length - buffer->start);
+        buffer->length -= buffer->start;
+        buffer->start = 0;
+    }
+    if (buffer->length + extra + 1 <= buffer->capacity) return true;
+
+    size_t capacity = buffer->capacity ? buffer->capacity : READ_CHUNK;
+    while (capacity < buffer->length + extra + 1) capacity *= 2;
+    char* data = (char*)realloc(buffer->data, capacity);
+    if (!data) return false;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+// Parse "#<id> " at the start of text, returns the id (> 0) and sets rest, or -1 if text is not framed
+static long long parseFrameId(const char* text, char** rest) {
+    if (text[0] != '#') return -1;
+    char* end;
+    long long id = strtoll(text + 1, &end, 10);
+    if (end == text + 1 || id < 0 || *end != ' ') return -1;
+    *rest = end + 1;
+    return id;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Empty buffer
+void initFrameBuffer(frame_buffer* buffer) {
+    buffer->data = NULL;
+    buffer->start = 0;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+// Free the memory of the buffer
+void freeFrameBuffer(frame_buffer* buffer) {
+    free(buffer->data);
+    initFrameBuffer(buffer);
+}
+
+// Append what fd has without blocking
+ssize_t readFrameBuffer(int fd, frame_buffer* buffer) {
+    ssize_t total = 0;
+    for (;;) {
+        if (!reserveFrameBuffer(buffer, READ_CHUNK)) {
+            errno = ENOMEM;
+            return total > 0 ? total : -1;
+        }
+        size_t space = buffer->capacity - buffer->length - 1;
+        ssize_t bytes_read = read(fd, buffer->data + buffer->length, space);
+        if (bytes_read < 0) {
+            if (errno == EINTR) continue;
+            return total > 0 ? total : -1;
+        }
+        if (bytes_read == 0) return total;
+
+        buffer->length += bytes_read;
+        buffer->data[buffer->length] = '\0';
+        total += bytes_read;
+        if ((size_t)bytes_read < space) return total;
+    }
+}
+
+// Take the next complete request out of the buffer
+bool nextRequest(frame_buffer* buffer, long long* id, char** command) {
+    // Skip empty lines
+    while (buffer->start < buffer->length && strchr("\r\n", buffer->data[buffer->start])) buffer->start++;
+    if (buffer->start >= buffer->length) return false;
+
+    char* begin = buffer->data + buffer->start;
+    size_t available = buffer->length - buffer->start;
+    char* newline = (char*)memchr(begin, '\n', available);
+    if (!newline) {
+        // A framed request is always complete with its newline (unless it is too long to ever be valid)
+        if (begin[0] == '#' && available <= REQUEST_MAX) return false;
+        newline = begin + available;    // On the NUL that readFrameBuffer() keeps after the data
+    }
+
+    *newline = '\0';
+    buffer->start = newline - buffer->data + (newline < buffer->data + buffer->length ? 1 : 0);
+    if (newline > begin && newline[-1] == '\r') newline[-1] = '\0';
+
+    *id = parseFrameId(begin, command);
+    if (*id <= 0) {
+        *id = -1;
+        *command = begin;
+    }
+    return true;
+}
+
+// Take the next complete response frame out of the buffer
+bool nextResponse(frame_buffer* buffer, response_frame* frame) {
+    if (buffer->start >= buffer->length) return false;
+
+    char* begin = buffer->data + buffer->start;
+    size_t available = buffer->length - buffer->start;
+    char* newline = (char*)memchr(begin, '\n', available);
+
+    char* rest;
+    long long id = newline ? parseFrameId(begin, &rest) : -1;
+    if (id >= 0 && rest < newline) {
+        frame->id = id;
+        if (strncmp(rest, "END ", 4) == 0) {
+            frame->end = true;
+            frame->rc = atoi(rest + 4);
+            frame->payload = NULL;
+            frame->length = 0;
+            buffer->start += newline + 1 - begin;
+            return true;
+        }
+
+        size_t length = strtoull(rest, NULL, 10);
+        if ((size_t)(newline + 1 - begin) + length > available) return false;     // Payload not here yet
+        frame->end = false;
+        frame->rc = 0;
+        frame->payload = newline + 1;
+        frame->length = length;
+        buffer->start += newline + 1 - begin + length;
+        return true;
+    }
+
+    // Plain text up to the end of the line (or of what arrived)
+    if (available > 0 && begin[0] == '#' && !newline) return false;    // Frame header not complete yet
+    size_t length = newline ? (size_t)(newline + 1 - begin) : available;
+    frame->id = -1;
+    frame->end = false;
+    frame->rc = 0;
+    frame->payload = begin;
+    frame->length = length;
+    buffer->start += length;
+    return true;
+}
+
+// Send the END frame of a request
+void sendResponseEnd(int fss_out, long long id, int rc) {
+    if (id < 0 || fss_out < 0) return;
+
+    char frame[64];
+    int length = snprintf(frame, sizeof(frame), "#%lld END %d\n", id, rc);
+    writeConsole(fss_out, frame, length, "", 0);
+}
\ No newline at end of file
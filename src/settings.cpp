@@ -0,0 +1,152 @@
+#include "../header/settings.h"
+#include "../header/task_manager.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Settings: Global and per-pair options given in the config file
+
+manager_settings settings = {};
+
+// Parse a number with an optional K/M/G suffix (e.g. "10M")
+long long parseSizeValue(const char* value) {
+    if (!value || !*value) return -1;
+
+    char* end = NULL;
+    long long number = strtoll(value, &end, 10);
+    if (end == value || number < 0) return -1;
+
+    switch (*end) {
+        case '\0': break;
+        case 'k': case 'K': number *= 1024LL; end++; break;
+        case 'm': case 'M': number *= 1024LL * 1024; end++; break;
+        case 'g': case 'G': number *= 1024LL * 1024 * 1024; end++; break;
+        default: return -1;
+    }
+    if (*end != '\0') return -1;
+
+    return number;
+}
+
+// Apply a single key=value option to a pair (or to the global settings if entry is NULL)
+bool applySetting(const char* key, const char* value, sync_info_entry* entry) {
+    if (strcmp(key, "bps") == 0 || strcmp(key, "fps") == 0) {
+        long long limit = parseSizeValue(value);
+        if (limit < 0) return false;
+
+        // Keep the other limit as it is
+        long long bps = entry ? entry->limit_bps : settings.global_bps;
+        long long fps = entry ? entry->limit_fps : settings.global_fps;
+        if (key[0] == 'b') bps = limit; else fps = limit;
+
+        setThrottleLimits(entry, bps, fps);
+        return true;
+    }
+
+    if (isPriorityOption(key)) {
+        if (!entry) return setPriorityOption(settings.priority, key, value);
+        if (!entry->priority) {
+            entry->priority = (worker_priority*)calloc(PRIORITY_CLASSES, sizeof(worker_priority));
+            if (!entry->priority) return false;
+        }
+        return setPriorityOption(entry->priority, key, value);
+    }
+
+    // Global only options
+    if (entry) return false;
+
+    if (strcmp(key, "journal") == 0) {
+        if (!*value || strlen(value) >= PATH_MAX) return false;
+        strcpy(settings.journal_path, value);
+        return true;
+    }
+
+    if (strcmp(key, "journal_compact_size") == 0) {
+        settings.journal_compact_size = parseSizeValue(value);
+        return settings.journal_compact_size > 0;
+    }
+
+    if (strcmp(key, "queue_memory") == 0) {
+        settings.queue_memory = parseSizeValue(value);
+        return settings.queue_memory > 0;
+    }
+
+    if (strcmp(key, "queue_spill") == 0) {
+        if (!*value || strlen(value) >= PATH_MAX) return false;
+        strcpy(settings.queue_spill_path, value);
+        return true;
+    }
+
+    if (strcmp(key, "collapse_limit") == 0) {
+        settings.collapse_limit = atoi(value);
+        return settings.collapse_limit > 0;
+    }
+
+    if (strcmp(key, "metrics_file") == 0) {
+        if (!*value || strlen(value) >= PATH_MAX) return false;
+        strcpy(settings.metrics_path, value);
+        return true;
+    }
+
+    if (strcmp(key, "metrics_interval") == 0) {
+        settings.metrics_interval = atoi(value);
+        return settings.metrics_interval > 0;
+    }
+
+    if (strcmp(key, "trace_file") == 0) {
+        if (!*value || strlen(value) >= PATH_MAX) return false;
+        strcpy(settings.trace_path, value);
+        return true;
+    }
+
+    if (strcmp(key, "log_buffer") == 0) {
+        settings.log_buffer = parseSizeValue(value);
+        return settings.log_buffer > 0;
+    }
+
+    if (strcmp(key, "log_full") == 0) {
+        if (strcmp(value, "drop") != 0 && strcmp(value, "block") != 0) return false;
+        settings.log_block = value[0] == 'b';
+        return true;
+    }
+
+    if (strcmp(key, "spawn") == 0) {
+        if (strcmp(value, "posix_spawn") != 0 && strcmp(value, "fork") != 0) return false;
+        settings.spawn_fork = value[0] == 'f';
+        return true;
+    }
+
+    if (strcmp(key, "log_rotate_size") == 0) {
+        settings.log_rotate_size = parseSizeValue(value);
+        return settings.log_rotate_size > 0;
+    }
+
+    if (strcmp(key, "log_rotate_interval") == 0) {
+        settings.log_rotate_interval = atoi(value);
+        return settings.log_rotate_interval > 0;
+    }
+
+    if (strcmp(key, "log_keep") == 0) {
+        settings.log_keep = atoi(value);
+        return settings.log_keep > 0;
+    }
+
+    if (strcmp(key, "state_file") == 0) {
+        if (!*value || strlen(value) >= PATH_MAX) return false;
+        strcpy(settings.state_path, value);
+        return true;
+    }
+
+    if (strcmp(key, "stagger") == 0) {
+        settings.stagger = atoi(value);
+        return settings.stagger > 0;
+    }
+
+    if (strcmp(key, "control_socket") == 0) {
+        if (!*value || strlen(value) >= sizeof(settings.control_socket)) return false;
+        strcpy(settings.control_socket, value);
+        return true;
+    }
+
+    return false;  // Unknown option
+}
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "../header/state_export.h"
+#include "../header/sync_database.h"
+#include "../header/task_manager.h"
+#include "../header/throttle.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+
+// State Export: Live copy of sync_info in a memory mapped file
+
+#define STATE_INITIAL_SIZE (64 * 1024)
+
+static int state_fd = -1;
+static char* state_map = NULL;
+static size_t state_size = 0;
+static uint64_t last_export_ns = 0;
+static size_t data_length = 0;                  // Bytes of entries after the header (removed ones included)
+static size_t removed_length = 0;               // Bytes of removed entries
+static bool rewrite_entries = true;             // Write all entries from scratch in the next update
+static std::vector<size_t> entry_offsets;       // Offset of each pair's entry in the file by pair index (0 = none)
+static std::vector<bool> dirty_flags;           // Pairs in dirty_pairs by pair index
+static std::vector<uint32_t> dirty_pairs;       // Pairs to write in the next update
+static std::vector<size_t> removed_entries;     // Offsets of entries to mark removed in the next update
+
+///// HELPER FUNCTIONS /////
+
+static state_header* header() {
+    return (state_header*)state_map;
+}
+
+// Size of the entry of a pair (rounded up so the next entry stays aligned)
+static size_t entrySize(const sync_info_entry* info) {
+    size_t size = sizeof(state_entry) + strlen(info->source_dir) + 1 + strlen(info->target_dir) + 1;
+    return (size + 7) & ~(size_t)7;
+}
+
+// Seqlock: readers retry while the sequence is odd or changed during their copy
+static void beginUpdate() {
+    __atomic_store_n(&header()->sequence, header()->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void endUpdate() {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&header()->sequence, header()->sequence + 1, __ATOMIC_RELAXED);
+}
+
+// Grow the file and the mapping to at least size bytes (call between beginUpdate and endUpdate)
+static bool growState(size_t size) {
+    size_t new_size = state_size;
+    while (new_size < size) new_size *= 2;
+
+    if (ftruncate(state_fd, new_size) < 0) {
+        perror("Error growing state file");
+        return false;
+    }
+    char* map = (char*)mremap(state_map, state_size, new_size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        perror("Error mapping state file");
+        return false;
+    }
+    state_map = map;
+    state_size = new_size;
+    header()->file_size = new_size;
+    return true;
+}
+
+// Write the entry of a pair at offset, length is the size of its space
+static void writeEntry(size_t offset, const sync_info_entry* info, size_t length) {
+    state_entry* entry = (state_entry*)(state_map + offset);
+    entry->length = (uint32_t)length;
+    entry->source_length = (uint32_t)strlen(info->source_dir);
+    entry->target_length = (uint32_t)strlen(info->target_dir);
+    entry->error_count = info->error_count;
+    entry->queued_tasks = info->queued_tasks;
+    entry->active = info->wd >= 0;
+    entry->removed = 0;
+    entry->last_sync = (int64_t)info->last_sync;
+
+    char* strings = state_map + offset + sizeof(state_entry);
+    memcpy(strings, info->source_dir, entry->source_length + 1);
+    memcpy(strings + entry->source_length + 1, info->target_dir, entry->target_length + 1);
+}
+
+// Remember where the entry of a pair is
+static void setEntryOffset(uint32_t index, size_t offset) {
+    if (index >= entry_offsets.size()) entry_offsets.resize(index + 1, 0);
+    entry_offsets[index] = offset;
+}
+
+// Mark the entry at offset as removed
+static void removeEntry(size_t offset) {
+    state_entry* entry = (state_entry*)(state_map + offset);
+    entry->removed = 1;
+    removed_length += entry->length;
+}
+
+// Write every pair, one entry after the other (call between beginUpdate and endUpdate)
+static bool writeAllEntries() {
+    size_t length = 0;
+    for (const sync_info_entry& info : sync_info) length += entrySize(&info);
+    if (sizeof(state_header) + length > state_size && !growState(sizeof(state_header) + length)) return false;
+
+    entry_offsets.assign(entry_offsets.size(), 0);
+    size_t offset = sizeof(state_header);
+    for (const sync_info_entry& info : sync_info) {
+        size_t size = entrySize(&info);
+        writeEntry(offset, &info, size);
+        setEntryOffset(info.index, offset);
+        offset += size;
+    }
+    data_length = length;
+    removed_length = 0;
+    return true;
+}
+
+// Write the pairs that changed since the last update (call between beginUpdate and endUpdate)
+// Returns false if the file could not grow, the entries are then written from scratch next time
+static bool writeDirtyEntries() {
+    for (size_t offset : removed_entries) removeEntry(offset);
+
+    for (uint32_t index : dirty_pairs) {
+        const sync_info_entry* info = getSyncInfoById(index);
+        if (!info) continue;    // Removed since
+
+        // Rewritten in place if it still fits, otherwise moved to the end
+        size_t size = entrySize(info);
+        size_t offset = index < entry_offsets.size() ? entry_offsets[index] : 0;
+        if (offset) {
+            size_t length = ((state_entry*)(state_map + offset))->length;
+            if (size <= length) {
+                writeEntry(offset, info, length);
+                continue;
+            }
+            removeEntry(offset);
+        }
+
+        offset = sizeof(state_header) + data_length;
+        if (offset + size > state_size && !growState(offset + size)) return false;
+        writeEntry(offset, info, size);
+        setEntryOffset(index, offset);
+        data_length += size;
+    }
+    return true;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Create (or reuse) the state file
+bool openStateExport(const char* path) {
+    state_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (state_fd < 0) {
+        perror("Error opening state file");
+        return false;
+    }
+
+    // Never shrink the file, a reader may still have the old size mapped
+    struct stat st;
+    if (fstat(state_fd, &st) < 0) st.st_size = 0;
+    state_size = st.st_size > STATE_INITIAL_SIZE ? (size_t)st.st_size : STATE_INITIAL_SIZE;
+    if ((size_t)st.st_size < state_size && ftruncate(state_fd, state_size) < 0) {
+        perror("Error sizing state file");
+        close(state_fd);
+        state_fd = -1;
+        return false;
+    }
+
+    state_map = (char*)mmap(NULL, state_size, PROT_READ | PROT_WRITE, MAP_SHARED, state_fd, 0);
+    if (state_map == MAP_FAILED) {
+        perror("Error mapping state file");
+        state_map = NULL;
+        close(state_fd);
+        state_fd = -1;
+        return false;
+    }
+
+    // Continue the sequence of a previous run, so a reader in the middle of a copy notices the change
+    uint64_t sequence = header()->magic == STATE_MAGIC ? (header()->sequence + 1) & ~1ULL : 0;
+    header()->sequence = sequence;
+    beginUpdate();
+    header()->magic = STATE_MAGIC;
+    header()->version = STATE_VERSION;
+    header()->generation = 0;
+    header()->file_size = state_size;
+    header()->data_length = 0;
+    header()->count = 0;
+    header()->manager_pid = (int32_t)getpid();
+    endUpdate();
+
+    rewrite_entries = true;
+    exportState(true);
+    return true;
+}
+
+// Record that the exported fields of a pair changed
+void markStateDirty(const sync_info_entry* info) {
+    if (!state_map || rewrite_entries) return;  // All entries are written anyway
+
+    if (info->index >= dirty_flags.size()) dirty_flags.resize(info->index + 1, false);
+    if (dirty_flags[info->index]) return;
+    dirty_flags[info->index] = true;
+    dirty_pairs.push_back(info->index);
+}
+
+// Record that a pair is being removed
+void markStateRemoved(const sync_info_entry* info) {
+    if (!state_map || info->index >= entry_offsets.size() || !entry_offsets[info->index]) return;
+
+    removed_entries.push_back(entry_offsets[info->index]);
+    entry_offsets[info->index] = 0;     // A pair that reuses the index gets a new entry
+}
+
+// Write the changed pairs into the state file if STATE_INTERVAL_MS has passed
+void exportState(bool force) {
+    if (!state_map) return;
+
+    uint64_t now = getMonotonicNs();
+    if (!force && now - last_export_ns < STATE_INTERVAL_MS * 1000000ULL) return;
+    last_export_ns = now;
+
+    // Only the changed pairs, unless removed entries take more space than the others
+    beginUpdate();
+    if (removed_length > data_length - removed_length) rewrite_entries = true;
+    if (!rewrite_entries && !writeDirtyEntries()) rewrite_entries = true;
+    if (rewrite_entries) rewrite_entries = !writeAllEntries();
+    if (!rewrite_entries) {
+        for (uint32_t index : dirty_pairs) dirty_flags[index] = false;
+        dirty_pairs.clear();
+        removed_entries.clear();
+    }
+
+    header()->generation++;
+    header()->data_length = data_length;
+    header()->count = (uint32_t)sync_info.size();
+    header()->updated = (int64_t)time(NULL);
+    header()->queued_tasks = getQueuedTaskCount();
+    header()->active_workers = getActiveWorkerCount();
+    endUpdate();
+}
+
+// Write the final state, mark the manager as stopped and unmap the file
+void closeStateExport() {
+    if (!state_map) return;
+
+    exportState(true);
+    beginUpdate();
+    header()->manager_pid = 0;
+    endUpdate();
+
+    munmap(state_map, state_size);
+    close(state_fd);
+    state_map = NULL;
+    state_fd = -1;
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "../header/str_builder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+// str_builder: String builder for messages, backed by a stack buffer and a reusable arena
+
+// Arena blocks, one per builder that outgrew its stack buffer (builders are nested at most a few deep)
+#define SB_ARENA_BLOCKS 8
+
+struct sb_arena_block {
+    char* data;
+    size_t capacity;
+    bool in_use;
+};
+
+static sb_arena_block arena[SB_ARENA_BLOCKS];
+
+///// HELPER FUNCTIONS /////
+
+// Make room for extra more bytes (and the NUL), returns false if memory ran out
+static bool reserve(str_builder* sb, size_t extra) {
+    size_t needed = sb->length + extra + 1;
+    if (needed <= sb->capacity) return true;
+
+    size_t capacity = sb->capacity * 2;
+    while (capacity < needed) capacity *= 2;
+
+    // Grow inside the arena block (or malloc'd memory) already in use
+    if (sb->block != -1) {
+        if (sb->block >= 0 && arena[sb->block].capacity >= capacity) {
+            sb->capacity = arena[sb->block].capacity;
+            return true;
+        }
+        char* data = (char*)realloc(sb->data, capacity);
+        if (!data) return false;
+        sb->data = data;
+        sb->capacity = capacity;
+        if (sb->block >= 0) {
+            arena[sb->block].data = data;
+            arena[sb->block].capacity = capacity;
+        }
+        return true;
+    }
+
+    // Move from the stack to a free arena block, grown only if it is too small
+    for (int i = 0; i < SB_ARENA_BLOCKS; i++) {
+        if (arena[i].in_use) continue;
+        if (arena[i].capacity < capacity) {
+            char* data = (char*)realloc(arena[i].data, capacity);
+            if (!data) return false;
+            arena[i].data = data;
+            arena[i].capacity = capacity;
+        }
+        arena[i].in_use = true;
+        memcpy(arena[i].data, sb->data, sb->length + 1);
+        sb->data = arena[i].data;
+        sb->capacity = arena[i].capacity;
+        sb->block = i;
+        return true;
+    }
+
+    // Every block is taken
+    char* data = (char*)malloc(capacity);
+    if (!data) return false;
+    memcpy(data, sb->data, sb->length + 1);
+    sb->data = data;
+    sb->capacity = capacity;
+    sb->block = -2;
+    return true;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Start an empty builder
+void sbInit(str_builder* sb) {
+    sb->data = sb->stack;
+    sb->length = 0;
+    sb->capacity = SB_STACK_SIZE;
+    sb->block = -1;
+    sb->stack[0] = '\0';
+}
+
+// Give back the arena block (or heap memory) of the builder
+void sbFree(str_builder* sb) {
+    if (sb->block >= 0) arena[sb->block].in_use = false;
+    else if (sb->block == -2) free(sb->data);
+    sbInit(sb);
+}
+
+// Empty the builder, keeping its memory
+void sbReset(str_builder* sb) {
+    sb->length = 0;
+    sb->data[0] = '\0';
+}
+
+// The built string
+const char* sbString(const str_builder* sb) {
+    return sb->data;
+}
+
+// Length of the built string
+size_t sbLength(const str_builder* sb) {
+    return sb->length;
+}
+
+// Append text
+void sbAppend(str_builder* sb, const char* text) {
+    if (text) sbAppendLength(sb, text, strlen(text));
+}
+
+// Append length bytes of text (cut short if memory runs out)
+void sbAppendLength(str_builder* sb, const char* text, size_t length) {
+    if (!reserve(sb, length)) {
+        length = sb->capacity - sb->length - 1;
+    }
+    memcpy(sb->data + sb->length, text, length);
+    sb->length += length;
+    sb->data[sb->length] = '\0';
+}
+
+// Append a single character
+void sbAppendChar(str_builder* sb, char c) {
+    if (!reserve(sb, 1)) return;
+    sb->data[sb->length++] = c;
+    sb->data[sb->length] = '\0';
+}
+
+// Append a number in decimal
+void sbAppendInt(str_builder* sb, long long value) {
+    if (value < 0) {
+        sbAppendChar(sb, '-');
+        sbAppendUnsigned(sb, 0ULL - (unsigned long long)value);
+    } else {
+        sbAppendUnsigned(sb, (unsigned long long)value);
+    }
+}
+
+void sbAppendUnsigned(str_builder* sb, unsigned long long value) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    if (!reserve(sb, count)) return;
+    while (count > 0) sb->data[sb->length++] = digits[--count];
+    sb->data[sb->length] = '\0';
+}
+
+// Append printf-style formatted text
+void sbAppendFormat(str_builder* sb, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(sb->data + sb->length, sb->capacity - sb->length, format, args);
+    va_end(args);
+    if (length < 0) {
+        sb->data[sb->length] = '\0';
+        return;
+    }
+
+    // Did not fit, grow and format again
+    if ((size_t)length >= sb->capacity - sb->length) {
+        if (!reserve(sb, length)) {
+            sb->data[sb->length] = '\0';
+            return;
+        }
+        va_start(args, format);
+        vsnprintf(sb->data + sb->length, sb->capacity - sb->length, format, args);
+        va_end(args);
+    }
+    sb->length += length;
+}
\ No newline at end of file
@@ -1,31 +1,331 @@
 #include "../header/sync_database.h"
 #include "../header/message_utils.h"
+#include "../header/settings.h"
+#include "../header/state_export.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <unordered_set>
+#include <algorithm>
 
-// sync database: Manages synchronization information for directories using unordered map (stl)
+// sync database: Manages synchronization information for directories in a compact registry
 
-std::unordered_map<std::string, sync_info_entry> sync_info;
+#define CONFIG_GLOBAL 2     // "@key=value" line (only returned by splitConfigLine())
 
-///// HELPER FUNCTION /////
+#define ENTRY_CHUNK 4096                // Entries per chunk (chunks never move)
+#define ARENA_BLOCK (1024 * 1024)       // Size of an arena block for the paths
+#define TABLE_MIN 1024                  // Initial slots of a table (power of 2)
+#define EMPTY_INDEX UINT32_MAX          // Free entry / empty slot
 
-// Function to free memory for a single sync_info_entry
-void freeSyncInfoEntry(sync_info_entry* entry) {
-    if (!entry) return;
-    
-    if (entry->source_dir) free(entry->source_dir);
-    if (entry->target_dir) free(entry->target_dir);
-    if (entry->last_sync_time) free(entry->last_sync_time);
+// Slot of an open addressing table (linear probing): hash of the key and index of the entry
+typedef struct {
+    uint32_t hash;
+    uint32_t index;     // EMPTY_INDEX = empty slot
+} registry_slot;
+
+typedef struct {
+    registry_slot* slots;
+    uint32_t mask;      // Number of slots - 1
+    uint32_t count;
+} registry_table;
+
+// Block of the path arena
+typedef struct {
+    char* data;
+    size_t used;
+    size_t size;
+} arena_block;
+
+sync_registry sync_info;
+
+static std::vector<sync_info_entry*> entry_chunks;
+static uint32_t entry_end = 0;          // Entries handed out (free ones included)
+static std::vector<uint32_t> free_entries;
+static size_t entry_count = 0;
+static registry_table source_table = {NULL, 0, 0};     // Source path -> entry
+static registry_table watch_table = {NULL, 0, 0};      // Inotify watch -> entry
+static std::vector<arena_block> arena;
+static size_t arena_live = 0;           // Bytes of the paths in use
+static size_t arena_garbage = 0;        // Bytes of removed or replaced paths
+
+///// HELPER FUNCTIONS /////
+
+static inline sync_info_entry* entryAt(uint32_t index) {
+    return &entry_chunks[index / ENTRY_CHUNK][index % ENTRY_CHUNK];
+}
+
+// FNV-1a hash of a path
+static uint32_t hashPath(const char* path) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* c = (const unsigned char*)path; *c; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t hashWatch(int wd) {
+    return (uint32_t)wd * 2654435761u;
+}
+
+// Copy a path into the arena, returns NULL if memory ran out
+static char* internPath(const char* path) {
+    size_t length = strlen(path) + 1;
+    if (arena.empty() || arena.back().size - arena.back().used < length) {
+        arena_block block;
+        block.size = length > ARENA_BLOCK ? length : ARENA_BLOCK;
+        block.used = 0;
+        block.data = (char*)malloc(block.size);
+        if (!block.data) return NULL;
+        arena.push_back(block);
+    }
+    char* copy = arena.back().data + arena.back().used;
+    memcpy(copy, path, length);
+    arena.back().used += length;
+    arena_live += length;
+    return copy;
+}
+
+// A path is no longer used (its bytes are given back by compactSyncInfo())
+static void releasePath(const char* path) {
+    size_t length = strlen(path) + 1;
+    arena_live -= length;
+    arena_garbage += length;
+}
+
+// Insert an entry index into a table, growing it at 70% load
+static bool tableInsert(registry_table* table, uint32_t hash, uint32_t index) {
+    uint32_t size = table->slots ? table->mask + 1 : 0;
+    if ((uint64_t)(table->count + 1) * 10 > (uint64_t)size * 7) {
+        uint32_t new_size = size ? size * 2 : TABLE_MIN;
+        registry_slot* slots = (registry_slot*)malloc(new_size * sizeof(registry_slot));
+        if (!slots) return false;
+        for (uint32_t i = 0; i < new_size; i++) slots[i].index = EMPTY_INDEX;
+
+        // Move the entries (the stored hashes are enough, keys are not read again)
+        for (uint32_t i = 0; i < size; i++) {
+            if (table->slots[i].index == EMPTY_INDEX) continue;
+            uint32_t slot = table->slots[i].hash & (new_size - 1);
+            while (slots[slot].index != EMPTY_INDEX) slot = (slot + 1) & (new_size - 1);
+            slots[slot] = table->slots[i];
+        }
+        free(table->slots);
+        table->slots = slots;
+        table->mask = new_size - 1;
+    }
+
+    uint32_t slot = hash & table->mask;
+    while (table->slots[slot].index != EMPTY_INDEX) slot = (slot + 1) & table->mask;
+    table->slots[slot].hash = hash;
+    table->slots[slot].index = index;
+    table->count++;
+    return true;
+}
+
+// Remove an entry index from a table, moving back the entries after it (no tombstones)
+static void tableErase(registry_table* table, uint32_t hash, uint32_t index) {
+    if (!table->slots) return;
+    uint32_t slot = hash & table->mask;
+    while (table->slots[slot].index != index) {
+        if (table->slots[slot].index == EMPTY_INDEX) return;
+        slot = (slot + 1) & table->mask;
+    }
+
+    uint32_t hole = slot;
+    for (uint32_t next = (hole + 1) & table->mask; table->slots[next].index != EMPTY_INDEX; next = (next + 1) & table->mask) {
+        // Entries whose home slot is not between the hole and their slot can fill the hole
+        uint32_t home = table->slots[next].hash & table->mask;
+        if (((next - home) & table->mask) >= ((next - hole) & table->mask)) {
+            table->slots[hole] = table->slots[next];
+            hole = next;
+        }
+    }
+    table->slots[hole].index = EMPTY_INDEX;
+    table->count--;
+}
+
+// Append the progress of a running full sync ("Progress: 45.0% (...), 12.5 MB/s, ETA 40 s")
+// Done and remaining work are counted in bytes, or in files when the files are empty
+static void appendSyncProgress(str_builder* msg, const sync_progress* progress) {
+    uint64_t now_ns = getMonotonicNs();
+    double elapsed = (now_ns - progress->started_ns) / 1e9;
+    bool by_bytes = progress->bytes_total > 0;
+    double done = by_bytes ? progress->bytes_done : progress->files_done;
+    double total = by_bytes ? progress->bytes_total : progress->files_total;
+    double rate = elapsed > 0 ? done / elapsed : 0;
+
+    sbAppendFormat(msg, "Progress: %.1f%% (%lld/%lld files, %lld/%lld bytes), %.1f MB/s, ",
+                   total > 0 ? std::min(100.0, done * 100 / total) : 0.0,
+                   progress->files_done, progress->files_total, progress->bytes_done, progress->bytes_total,
+                   elapsed > 0 ? progress->bytes_done / elapsed / (1024 * 1024) : 0.0);
+    if (rate > 0 && done < total) {
+        sbAppendFormat(msg, "ETA %.0f s", (total - done) / rate);
+    } else {
+        sbAppend(msg, "ETA unknown");
+    }
+    sbAppendFormat(msg, " (worker %d, updated %.1f s ago)\n", (int)progress->pid, (now_ns - progress->updated_ns) / 1e9);
+}
+
+// Free memory of a single entry and put it on the free list
+static void freeSyncInfoEntry(sync_info_entry* entry) {
+    releasePath(entry->source_dir);
+    releasePath(entry->target_dir);
+    free(entry->latency);
+    free(entry->usage);
+    free(entry->priority);
+    free(entry->progress);
     
     entry->source_dir = NULL;
     entry->target_dir = NULL;
-    entry->last_sync_time = NULL;
+    entry->latency = NULL;
+    entry->usage = NULL;
+    entry->priority = NULL;
+    entry->progress = NULL;
+    free_entries.push_back(entry->index);
+    entry_count--;
+}
+
+// Apply the key=value options found after the directories of a config line
+void applyLineSettings(char* options, sync_info_entry* entry, int line_num) {
+    char* saveptr = NULL;
+    for (char* token = strtok_r(options, " \t", &saveptr); token; token = strtok_r(NULL, " \t", &saveptr)) {
+        char* equals = strchr(token, '=');
+        if (equals) {
+            *equals = '\0';
+            if (applySetting(token, equals + 1, entry)) continue;
+            *equals = '=';
+        }
+        printf("\nWARNING! Invalid option '%s' in line: %d\n", token, line_num);
+    }
+}
+
+// Hash of the options of a config line (64 bit FNV-1a of the options separated by single spaces)
+uint64_t hashConfigOptions(const char* options) {
+    if (!options) return 0;
+
+    uint64_t hash = 14695981039346656037ULL;
+    bool empty = true, separator = false;
+    for (const unsigned char* c = (const unsigned char*)options; *c; c++) {
+        if (*c == ' ' || *c == '\t') {
+            separator = !empty;
+            continue;
+        }
+        if (separator) hash = (hash ^ ' ') * 1099511628211ULL;
+        hash = (hash ^ *c) * 1099511628211ULL;
+        empty = false;
+        separator = false;
+    }
+    return empty ? 0 : hash;
+}
+
+// Split a config line into its directories and options (checking that both directories exist)
+// Returns a CONFIG_* result, or CONFIG_GLOBAL with options set for a "@key=value" line
+static int splitConfigLine(char* line, int line_num, char* source_dir, char* target_dir, char** options) {
+    // Remove trailing newline if present
+    size_t len = strlen(line);
+    if (len > 0 && line[len-1] == '\n') {
+        line[len-1] = '\0';
+    }
+
+    // Skip leading whitespace, empty lines and comments
+    while (*line == ' ' || *line == '\t') line++;
+    if (*line == '\0' || *line == '#') {
+        return CONFIG_SKIPPED;
+    }
+
+    // Global option
+    if (*line == '@') {
+        *options = line + 1;
+        return CONFIG_GLOBAL;
+    }
+
+    // Parse line to get source and target directories (and where the options start)
+    int options_pos = 0;
+    if (sscanf(line, "%s %s%n", source_dir, target_dir, &options_pos) != 2) {
+        printf("\nWARNING! Invalid format in line: %d\n", line_num);
+        return CONFIG_REJECTED;
+    }
+    *options = line + options_pos;
+
+    // Check if directories exist and are accessible
+    if (access(source_dir, F_OK) != 0) {
+        fprintf(stderr, "Line %d: ", line_num);
+        perror(source_dir);
+        return CONFIG_ERROR;
+    }
+    
+    if (access(target_dir, F_OK) != 0) {
+        fprintf(stderr, "Line %d: ", line_num);
+        perror(target_dir);
+        return CONFIG_ERROR;
+    }
+    return CONFIG_PAIR;
 }
 
 ///// MAIN FUNCTIONS /////
 
+// Parse a single config line ("<source> <target> [key=value ...]" or "@key=value")
+int parseConfigLine(char* line, int line_num, bool global_options, sync_info_entry** added) {
+    char source_dir[PATH_MAX], target_dir[PATH_MAX];
+    char* options = NULL;
+    int result = splitConfigLine(line, line_num, source_dir, target_dir, &options);
+
+    // Global option
+    if (result == CONFIG_GLOBAL) {
+        if (global_options) applyLineSettings(options, NULL, line_num);
+        else printf("Global option ignored in line: %d\n", line_num);
+        return CONFIG_SKIPPED;
+    }
+    if (result != CONFIG_PAIR) return result;
+
+    // Check if source already exists in sync_info
+    if (getSyncInfo(source_dir)) {
+        printf("Duplicate source directory in config (line %d): %s\n", line_num, source_dir);
+        return CONFIG_REJECTED;
+    }
+
+    sync_info_entry* entry = addSyncInfo(source_dir, target_dir);  // add to map
+    if (!entry) return CONFIG_ERROR;
+    entry->options_hash = hashConfigOptions(options);   // Before applyLineSettings() splits them
+    applyLineSettings(options, entry, line_num);
+    if (added) *added = entry;
+    return CONFIG_PAIR;
+}
+
+// Read the pairs of a config file without changing the map
+int readConfigPairs(const char* config_path, std::vector<config_pair>* pairs) {
+    FILE* file = fopen(config_path, "r");
+    if (file == NULL) {
+        perror("Error opening config file");
+        return -1;
+    }
+
+    char line[CONFIG_BUF_S];
+    char source_dir[PATH_MAX], target_dir[PATH_MAX];
+    std::unordered_set<std::string> sources;
+    int invalid = 0;
+    int line_num = 0;
+    while (fgets(line, CONFIG_BUF_S, file) != NULL) {
+        line_num++;
+
+        char* options = NULL;
+        int result = splitConfigLine(line, line_num, source_dir, target_dir, &options);
+        if (result == CONFIG_ERROR || result == CONFIG_REJECTED) invalid++;
+        if (result != CONFIG_PAIR) continue;
+
+        if (!sources.insert(source_dir).second) {
+            printf("Duplicate source directory in config (line %d): %s\n", line_num, source_dir);
+            invalid++;
+            continue;
+        }
+        pairs->push_back({source_dir, target_dir, options, line_num});
+    }
+
+    fclose(file);
+    return invalid;
+}
+
 // Insert directories from config file into the map
 int readConfig(const char* config_path) {
     FILE* file = fopen(config_path, "r");
@@ -35,7 +335,6 @@ int readConfig(const char* config_path) {
     }
 
     char line[CONFIG_BUF_S];
-    char source_dir[PATH_MAX], target_dir[PATH_MAX];
     int count = 0;
     int line_num = 0;
 
@@ -43,45 +342,14 @@ int readConfig(const char* config_path) {
     while (fgets(line, CONFIG_BUF_S, file) != NULL) {
         line_num++;
         
-        // Remove trailing newline if present
-        size_t len = strlen(line);
-        if (len > 0 && line[len-1] == '\n') {
-            line[len-1] = '\0';
-        }
-        
-        // Skip empty lines
-        if (strlen(line) == 0) {
-            continue;
-        }
-        
-        // Parse line to get source and target directories
-        if (sscanf(line, "%s %s", source_dir, target_dir) == 2) {
-            // Check if directories exist and are accessible
-            if (access(source_dir, F_OK) != 0) {
-                fprintf(stderr, "Line %d: ", line_num);
-                perror(source_dir);
-                fclose(file);
-                return -1;  // Abort on directory access error
-            }
-            
-            if (access(target_dir, F_OK) != 0) {
-                fprintf(stderr, "Line %d: ", line_num);
-                perror(target_dir);
-                fclose(file);
-                return -1;  // Abort on directory access error
-            }
-
-            // Check if source already exists in sync_info
-            if (sync_info.find(source_dir) != sync_info.end()) {
-                printf("Duplicate source directory in config (line %d): %s\n", line_num, source_dir);
-                continue;
-            }
-
-            addSyncInfo(source_dir, target_dir);  // add to map            
-            count++;
-        } else {
-            printf("\nWARNING! Invalid format in line: %d\n", line_num);
+        sync_info_entry* entry = NULL;
+        int result = parseConfigLine(line, line_num, true, &entry);
+        if (entry) entry->from_config = true;
+        if (result == CONFIG_ERROR) {
+            fclose(file);
+            return -1;  // Abort on directory access error
         }
+        if (result == CONFIG_PAIR) count++;
     }
 
     fclose(file);
@@ -89,74 +357,232 @@ int readConfig(const char* config_path) {
 }
 
 // Add <source, target> info to database
-void addSyncInfo(const char* source, const char* target) {
-    sync_info_entry info;
-    info.source_dir = strdup(source);
-    info.target_dir = strdup(target);
-    info.last_sync_time = strdup("Never");
-    info.wd = -1;
-    info.error_count = 0;
-    
-    // Check if memory allocation succeeded
-    if (!info.source_dir || !info.target_dir || !info.last_sync_time) {
-        freeSyncInfoEntry(&info);
+sync_info_entry* addSyncInfo(const char* source, const char* target) {
+    if (getSyncInfo(source)) return NULL;
+
+    // Reuse a removed entry or take the next one (a new chunk every ENTRY_CHUNK entries)
+    uint32_t index;
+    if (!free_entries.empty()) {
+        index = free_entries.back();
+        free_entries.pop_back();
+    } else {
+        if (entry_end % ENTRY_CHUNK == 0) {
+            sync_info_entry* chunk = (sync_info_entry*)malloc(ENTRY_CHUNK * sizeof(sync_info_entry));
+            if (!chunk) {
+                perror("Memory allocation failed in addSyncInfo");
+                return NULL;
+            }
+            for (int i = 0; i < ENTRY_CHUNK; i++) chunk[i].source_dir = NULL;
+            entry_chunks.push_back(chunk);
+        }
+        index = entry_end++;
+    }
+
+    // Paths into the arena, the source also becomes the key of the table
+    char* source_copy = internPath(source);
+    char* target_copy = source_copy ? internPath(target) : NULL;
+    if (!target_copy || !tableInsert(&source_table, hashPath(source), index)) {
         perror("Memory allocation failed in addSyncInfo");
-        return;
+        if (source_copy) releasePath(source_copy);
+        if (target_copy) releasePath(target_copy);
+        free_entries.push_back(index);
+        return NULL;
     }
-    
-    // Add to map
-    sync_info[std::string(source)] = info;
+
+    sync_info_entry* info = entryAt(index);
+    info->source_dir = source_copy;
+    info->target_dir = target_copy;
+    info->last_sync = 0;
+    info->index = index;
+    info->wd = -1;
+    info->from_config = false;
+    info->options_hash = 0;
+    info->error_count = 0;
+    info->queued_tasks = 0;
+    info->rescan_count = 0;
+    info->limit_bps = 0;
+    info->limit_fps = 0;
+    initTokenBucket(&info->fps_bucket, 0);
+    info->throttled_ms = 0;
+    info->collapse_task_id = 0;
+    info->bytes_copied = 0;
+    info->files_copied = 0;
+    info->tasks_completed = 0;
+    info->tasks_failed = 0;
+    info->latency = NULL;
+    info->usage = NULL;
+    info->priority = NULL;
+    info->progress = NULL;
+    entry_count++;
+    markStateDirty(info);
+    return info;
 }
 
 // Get directory info
 sync_info_entry* getSyncInfo(const char* directory) {
-    if (sync_info.find(directory) != sync_info.end()) {
-        return &(sync_info[directory]);
+    if (!source_table.slots) return NULL;
+
+    uint32_t hash = hashPath(directory);
+    for (uint32_t slot = hash & source_table.mask; source_table.slots[slot].index != EMPTY_INDEX;
+         slot = (slot + 1) & source_table.mask) {
+        if (source_table.slots[slot].hash != hash) continue;
+        sync_info_entry* info = entryAt(source_table.slots[slot].index);
+        if (strcmp(info->source_dir, directory) == 0) return info;
+    }
+    return NULL;
+}
+
+// Get the pair that owns an inotify watch
+sync_info_entry* getSyncInfoByWatch(int wd) {
+    if (wd < 0 || !watch_table.slots) return NULL;
+
+    uint32_t hash = hashWatch(wd);
+    for (uint32_t slot = hash & watch_table.mask; watch_table.slots[slot].index != EMPTY_INDEX;
+         slot = (slot + 1) & watch_table.mask) {
+        sync_info_entry* info = entryAt(watch_table.slots[slot].index);
+        if (info->wd == wd) return info;
     }
     return NULL;
 }
 
+// Get a pair by its index
+sync_info_entry* getSyncInfoById(uint32_t index) {
+    if (index >= entry_end) return NULL;
+    sync_info_entry* info = entryAt(index);
+    return info->source_dir ? info : NULL;
+}
+
+// Set the inotify watch of a pair (-1 = inactive)
+void setSyncWatch(sync_info_entry* entry, int wd) {
+    if (entry->wd >= 0) tableErase(&watch_table, hashWatch(entry->wd), entry->index);
+    entry->wd = wd;
+    if (wd >= 0 && !tableInsert(&watch_table, hashWatch(wd), entry->index)) {
+        perror("Memory allocation failed in setSyncWatch");
+    }
+    markStateDirty(entry);
+}
+
+// Change the target directory of a pair
+bool setSyncTarget(sync_info_entry* entry, const char* target) {
+    char* copy = internPath(target);
+    if (!copy) return false;
+    releasePath(entry->target_dir);
+    entry->target_dir = copy;
+    markStateDirty(entry);
+    return true;
+}
+
 // Remove directory from map
 void rmvSyncInfo(const char* directory) {
-    auto entry = sync_info.find(directory);
-    if (entry != sync_info.end()) {
-        freeSyncInfoEntry(&(entry->second));
-        sync_info.erase(entry);
-    }
+    sync_info_entry* entry = getSyncInfo(directory);
+    if (!entry) return;
+
+    markStateRemoved(entry);
+    if (entry->wd >= 0) tableErase(&watch_table, hashWatch(entry->wd), entry->index);
+    tableErase(&source_table, hashPath(entry->source_dir), entry->index);
+    freeSyncInfoEntry(entry);
 }
 
-// Pass information of a single entry into dynamically allocated buffer
-char* copySyncInfo(const char* directory) {
-    sync_info_entry* info = getSyncInfo(directory);
-    
-    if (info == NULL) {
-        return NULL;
+// Give back the arena space of removed and changed paths once it is more than the paths in use
+void compactSyncInfo() {
+    if (arena_garbage < ARENA_BLOCK || arena_garbage < arena_live) return;
+    if (arena_live == 0) {
+        for (arena_block& old_block : arena) free(old_block.data);
+        arena.clear();
+        arena_garbage = 0;
+        return;
     }
-    
-    size_t buffer_size = strlen(info->source_dir) + strlen(info->target_dir) + 
-                         strlen(info->last_sync_time) + 100;
-    
-    // Allocate the buffer dynamically
-    char* buffer = (char*)malloc(buffer_size);
-    if (!buffer) {
-        perror("Failed to allocate memory for sync info");
-        return NULL;
+
+    // One block for all paths in use, later paths start new blocks as usual
+    arena_block block;
+    block.size = arena_live;
+    block.used = 0;
+    block.data = (char*)malloc(block.size);
+    if (!block.data) return;    // Try again next time
+
+    for (sync_info_entry& info : sync_info) {
+        size_t source_length = strlen(info.source_dir) + 1;
+        size_t target_length = strlen(info.target_dir) + 1;
+        memcpy(block.data + block.used, info.source_dir, source_length);
+        info.source_dir = block.data + block.used;
+        block.used += source_length;
+        memcpy(block.data + block.used, info.target_dir, target_length);
+        info.target_dir = block.data + block.used;
+        block.used += target_length;
     }
+
+    for (arena_block& old_block : arena) free(old_block.data);
+    arena.clear();
+    arena.push_back(block);
+    arena_garbage = 0;
+}
+
+// Format a last sync time for output ("Never" if 0)
+void formatSyncTime(time_t when, char* buffer) {
+    if (!when) {
+        strcpy(buffer, "Never");
+        return;
+    }
+    struct tm tm_when;
+    localtime_r(&when, &tm_when);
+    strftime(buffer, TIMESTAMP_SIZE, "%Y-%m-%d %H:%M:%S", &tm_when);
+}
+
+// Registry iteration (skips removed entries)
+sync_info_entry& sync_registry::iterator::operator*() const {
+    return *entryAt(index);
+}
+
+sync_registry::iterator& sync_registry::iterator::operator++() {
+    do index++; while (index < entry_end && !entryAt(index)->source_dir);
+    return *this;
+}
+
+sync_registry::iterator sync_registry::begin() const {
+    iterator first = {0};
+    if (entry_end > 0 && !entryAt(0)->source_dir) ++first;
+    return first;
+}
+
+sync_registry::iterator sync_registry::end() const {
+    return iterator{entry_end};
+}
+
+size_t sync_registry::size() const {
+    return entry_count;
+}
+
+// Append the information of a single entry to a message
+void appendSyncInfo(str_builder* msg, const sync_info_entry* info) {
+    sbAppend(msg, "Source: ");
+    sbAppend(msg, info->source_dir);
+    sbAppend(msg, "\nTarget: ");
+    sbAppend(msg, info->target_dir);
+    char last_sync[TIMESTAMP_SIZE];
+    formatSyncTime(info->last_sync, last_sync);
+    sbAppend(msg, "\nLast Sync: ");
+    sbAppend(msg, last_sync);
+    sbAppend(msg, "\nError Count: ");
+    sbAppendInt(msg, info->error_count);
+    sbAppend(msg, "\nStatus: ");
+    sbAppend(msg, info->wd >= 0 ? "Active" : "Inactive");
+    sbAppend(msg, "\nLimits: ");
+    sbAppendInt(msg, info->limit_bps);
+    sbAppend(msg, " bytes/s, ");
+    sbAppendInt(msg, info->limit_fps);
+    sbAppend(msg, " files/s (0 = unlimited)\nThrottled: ");
+    sbAppendInt(msg, info->throttled_ms);
+    sbAppend(msg, " ms\nQueued Tasks: ");
+    sbAppendInt(msg, info->queued_tasks);
+    if (info->collapse_task_id) sbAppend(msg, " (collapsed into a full sync)");
+    sbAppend(msg, "\nRescans: ");
+    sbAppendInt(msg, info->rescan_count);
+    sbAppendChar(msg, '\n');
+    if (info->progress) appendSyncProgress(msg, info->progress);
     
-    // Format entry information into buffer
-    sprintf(buffer,
-        "Source: %s\n"
-        "Target: %s\n"
-        "Last Sync: %s\n"
-        "Error Count: %d\n"
-        "Status: %s\n",
-        info->source_dir, 
-        info->target_dir,
-        info->last_sync_time,
-        info->error_count,
-        info->wd >= 0 ? "Active" : "Inactive");
-    
-    return buffer;
+    // Resources and stage latencies of the finished tasks
+    appendPairUsage(msg, info);
+    appendPairLatency(msg, info);
 }
 
 // Print content of all entries in sync_info
@@ -167,14 +593,15 @@ void printAllSyncInfo() {
         printf("\nCurrent sync_info data:\n\n");
         
         // Iterate through all entries and print each one
-        for (const auto& pair : sync_info) {
-            char* buffer = copySyncInfo(pair.first.c_str());
-            if (buffer) {
-                printf("%s", buffer);
-                free(buffer);
-            }
+        str_builder buffer;
+        sbInit(&buffer);
+        for (const sync_info_entry& info : sync_info) {
+            sbReset(&buffer);
+            appendSyncInfo(&buffer, &info);
+            printf("%s", sbString(&buffer));
             printf("----------------------------------------\n");
         }
+        sbFree(&buffer);
         printf("\n");
     }
 }
@@ -182,10 +609,25 @@ void printAllSyncInfo() {
 // Clean up all memory used by sync_info
 void cleanupAllSyncInfo() {
     // Free memory for all entries
-    for (auto& pair : sync_info) {
-        freeSyncInfoEntry(&pair.second);
+    for (sync_info_entry& info : sync_info) {
+        free(info.latency);
+        free(info.usage);
+        free(info.priority);
+        free(info.progress);
     }
+    for (sync_info_entry* chunk : entry_chunks) free(chunk);
+    for (arena_block& block : arena) free(block.data);
+    free(source_table.slots);
+    free(watch_table.slots);
     
     // Clear the map
-    sync_info.clear();
+    entry_chunks.clear();
+    free_entries.clear();
+    arena.clear();
+    entry_end = 0;
+    entry_count = 0;
+    arena_live = 0;
+    arena_garbage = 0;
+    source_table = {NULL, 0, 0};
+    watch_table = {NULL, 0, 0};
 }
\ No newline at end of file
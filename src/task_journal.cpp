@@ -0,0 +1,339 @@
+#include "../header/task_journal.h"
+#include "../header/task_manager.h"
+#include "../header/sync_database.h"
+#include "../header/settings.h"
+#include "../header/message_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Task Journal: Append-only log of enqueued and completed tasks, used to rebuild the pending work after a crash
+
+// Default journal size after which it is compacted
+#define JOURNAL_COMPACT_SIZE (4 * 1024 * 1024)
+
+// Buffered records are committed early if they grow past this size
+#define JOURNAL_BUFFER_LIMIT (64 * 1024)
+
+// Failed commits in a row after which the journal is disabled (one commit per loop, about 5 s)
+#define JOURNAL_MAX_FAILURES 50
+
+// A task found in the journal of the previous run
+typedef struct {
+    uint64_t id;
+    std::string operation;
+    std::string source;
+    std::string filename;
+    bool done;
+} journal_record;
+
+static int journal_fd = -1;
+static char journal_path[PATH_MAX] = "";
+static std::string journal_buffer;     // Records waiting for the next commit
+static off_t journal_size = 0;         // Bytes committed to the journal file
+static int journal_failures = 0;       // Commits that failed in a row (their records are still buffered)
+static int journal_log_fd = -1;        // Log of the manager, for write errors
+
+///// HELPER FUNCTIONS /////
+
+// Append a field to a record, escaping the characters used as separators
+static void appendField(std::string& record, const char* field) {
+    record += '\t';
+    for (const char* c = field; *c; c++) {
+        if (*c == '\t') record += "\\t";
+        else if (*c == '\n') record += "\\n";
+        else if (*c == '\\') record += "\\\\";
+        else record += *c;
+    }
+}
+
+// Undo appendField() escaping in place
+static void unescapeField(char* field) {
+    char* out = field;
+    for (char* in = field; *in; in++) {
+        if (*in == '\\' && in[1]) {
+            in++;
+            *out++ = (*in == 't') ? '\t' : (*in == 'n') ? '\n' : *in;
+        } else {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+}
+
+// Add an "E" record for a task to a buffer
+static void appendTaskRecord(std::string& buffer, const task_t* task) {
+    const sync_info_entry* info = getSyncInfoById(task->pair);
+    if (!info) return;
+
+    char id[24];
+    sprintf(id, "%llu", (unsigned long long)task->id);
+    buffer += 'E';
+    appendField(buffer, id);
+    appendField(buffer, taskOpName(task->op));
+    appendField(buffer, info->source_dir);
+    appendField(buffer, info->target_dir);
+    appendField(buffer, task->filename);
+    buffer += '\n';
+}
+
+// forEachPendingTask() callback used when compacting
+static void appendPendingTask(const task_t* task, void* arg) {
+    appendTaskRecord(*(std::string*)arg, task);
+}
+
+// Write the whole buffer to a file descriptor
+static bool writeAll(int fd, const char* data, size_t length) {
+    size_t written = 0;
+    while (written < length) {
+        ssize_t result = write(fd, data + written, length - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+// Make a rename inside the journal's directory durable
+static void syncJournalDir() {
+    char dir_path[PATH_MAX];
+    strncpy(dir_path, journal_path, PATH_MAX - 1);
+    dir_path[PATH_MAX - 1] = '\0';
+
+    int dir_fd = open(dirname(dir_path), O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+}
+
+// Write records to "<journal>.tmp" and atomically replace the journal with it
+// Returns the new journal file descriptor or -1 on error
+static int replaceJournal(const std::string& records) {
+    char tmp_path[PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", journal_path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        perror("Error creating task journal");
+        return -1;
+    }
+
+    if (!writeAll(fd, records.data(), records.size()) || fdatasync(fd) < 0 ||
+        rename(tmp_path, journal_path) < 0) {
+        perror("Error writing task journal");
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    syncJournalDir();
+
+    journal_size = records.size();
+    return fd;
+}
+
+// Read the journal of the previous run and keep the tasks that were not completed
+static bool loadJournal(std::vector<journal_record>& records) {
+    FILE* file = fopen(journal_path, "r");
+    if (!file) return false;
+
+    std::unordered_map<uint64_t, size_t> index;  // task id -> position in records
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t length;
+    while ((length = getline(&line, &line_size, file)) > 0) {
+        if (line[length - 1] != '\n') break;  // Torn record written during a crash
+        line[length - 1] = '\0';
+
+        // Split record into its fields
+        char* fields[6];
+        int field_count = 0;
+        char* saveptr = NULL;
+        for (char* field = strtok_r(line, "\t", &saveptr); field && field_count < 6;
+             field = strtok_r(NULL, "\t", &saveptr)) {
+            fields[field_count++] = field;
+        }
+        if (field_count < 2) continue;
+
+        uint64_t id = strtoull(fields[1], NULL, 10);
+        if (fields[0][0] == 'E' && field_count >= 5) {
+            journal_record record;
+            for (int i = 2; i < field_count; i++) unescapeField(fields[i]);
+            record.id = id;
+            record.operation = fields[2];
+            record.source = fields[3];
+            record.filename = field_count == 6 ? fields[5] : "";
+            record.done = false;
+            index[id] = records.size();
+            records.push_back(record);
+        } else if (fields[0][0] == 'D') {
+            auto found = index.find(id);
+            if (found != index.end()) {
+                records[found->second].done = true;
+                index.erase(found);
+            }
+        }
+    }
+
+    free(line);
+    fclose(file);
+    return true;
+}
+
+// Write a message about the journal to the manager's log (and stdout)
+static void logJournalMessage(const char* text, const char* reason) {
+    str_builder msg;
+    startMessage(&msg);
+    sbAppendFormat(&msg, "%s %s: %s\n", text, journal_path, reason);
+    printf("%s", sbString(&msg));
+    forwardMessage(sbString(&msg), -1, journal_log_fd);
+    sbFree(&msg);
+}
+
+// A commit failed: cut the journal back to its last complete record and keep the records for the next commit
+// The journal is disabled if it cannot be cut back or keeps failing
+static void handleJournalFailure(const char* reason) {
+    journal_failures++;
+    bool truncated = ftruncate(journal_fd, journal_size) == 0;
+    if (truncated && journal_failures < JOURNAL_MAX_FAILURES) {
+        if (journal_failures == 1) logJournalMessage("Task journal write failed, retrying:", reason);
+        return;
+    }
+
+    logJournalMessage("Task journal disabled, pending tasks are no longer crash safe:",
+                      truncated ? reason : strerror(errno));
+    close(journal_fd);
+    journal_fd = -1;
+    journal_path[0] = '\0';
+    journal_buffer.clear();
+    journal_failures = 0;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Open the journal, re-enqueue the tasks that were still pending in it and compact it
+int openTaskJournal(const char* path, int log_fd) {
+    journal_log_fd = log_fd;
+    journal_failures = 0;
+    strncpy(journal_path, path, PATH_MAX - 1);
+    journal_path[PATH_MAX - 1] = '\0';
+
+    std::vector<journal_record> records;
+    loadJournal(records);   // No journal yet: nothing to replay
+
+    // Re-enqueue pending tasks (this fills journal_buffer with their new records)
+    journal_fd = -1;
+    journal_buffer.clear();
+    int replayed = 0;
+    for (const journal_record& record : records) {
+        if (record.done) continue;
+
+        // Use the current target of the pair, skip pairs no longer in the config
+        sync_info_entry* info = getSyncInfo(record.source.c_str());
+        if (!info) {
+            fprintf(stderr, "Journal: skipping task of unknown directory %s\n", record.source.c_str());
+            continue;
+        }
+
+        task_op op;
+        if (!parseTaskOp(record.operation.c_str(), &op)) {
+            fprintf(stderr, "Journal: skipping task with unknown operation %s\n", record.operation.c_str());
+            continue;
+        }
+        if (addTaskToQueue(info, record.filename.c_str(), op, false, 0)) {
+            replayed++;
+        }
+    }
+
+    // Start the new journal with the replayed tasks only
+    journal_fd = replaceJournal(journal_buffer);
+    journal_buffer.clear();
+    if (journal_fd < 0) {
+        journal_path[0] = '\0';  // Continue without journal
+        return -1;
+    }
+
+    return replayed;
+}
+
+// Returns true if the journal is open
+bool isTaskJournalOpen() {
+    return journal_fd >= 0;
+}
+
+// Record that a task was added to the queue
+void journalTaskAdded(const task_t* task) {
+    if (!journal_path[0]) return;  // Journal disabled
+
+    appendTaskRecord(journal_buffer, task);
+    if (journal_fd >= 0 && !journal_failures && journal_buffer.size() > JOURNAL_BUFFER_LIMIT) flushTaskJournal();
+}
+
+// Record that a task was completed or dropped
+void journalTaskDone(uint64_t task_id) {
+    if (journal_fd < 0) return;
+
+    char record[32];
+    sprintf(record, "D\t%llu\n", (unsigned long long)task_id);
+    journal_buffer += record;
+    if (!journal_failures && journal_buffer.size() > JOURNAL_BUFFER_LIMIT) flushTaskJournal();
+}
+
+// Commit buffered records to disk and compact the journal if it grew too big
+void flushTaskJournal() {
+    if (journal_fd < 0 || journal_buffer.empty()) return;
+
+    // Group commit: one write and one fdatasync for all records since the last flush
+    // A failed commit may have written part of the records, they are cut off and written again next time
+    if (!writeAll(journal_fd, journal_buffer.data(), journal_buffer.size()) || fdatasync(journal_fd) < 0) {
+        handleJournalFailure(strerror(errno));
+        return;
+    }
+    journal_size += journal_buffer.size();
+    journal_buffer.clear();
+    if (journal_failures) {
+        journal_failures = 0;
+        logJournalMessage("Task journal writes recovered:", "all buffered records committed");
+    }
+
+    long long compact_size = settings.journal_compact_size > 0 ? settings.journal_compact_size : JOURNAL_COMPACT_SIZE;
+    if (journal_size > compact_size) {
+        compactTaskJournal();
+    }
+}
+
+// Rewrite the journal so that it only contains the tasks still pending
+void compactTaskJournal() {
+    if (journal_fd < 0) return;
+
+    // The queue and the active workers hold the pending tasks, so buffered records are not needed
+    std::string records;
+    forEachPendingTask(appendPendingTask, &records);
+
+    int new_fd = replaceJournal(records);
+    if (new_fd < 0) return;  // Keep appending to the old journal
+
+    close(journal_fd);
+    journal_fd = new_fd;
+    journal_buffer.clear();
+}
+
+// Commit, compact and close the journal
+void closeTaskJournal() {
+    if (journal_fd < 0) return;
+
+    compactTaskJournal();
+    close(journal_fd);
+    journal_fd = -1;
+}
\ No newline at end of file
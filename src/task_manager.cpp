@@ -4,24 +4,53 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <errno.h>
 #include <string.h>
 #include <signal.h>
-#include <queue>
+#include <deque>
+#include <vector>
+#include <algorithm>
 #include <string>
 #include "../header/task_manager.h"
 #include "../header/message_utils.h"
 #include "../header/sync_database.h"
+#include "../header/settings.h"
+#include "../header/throttle.h"
+#include "../header/task_journal.h"
+#include "../header/task_spill.h"
+#include "../header/task_pool.h"
+#include "../header/worker_launch.h"
+#include "../header/metrics.h"
+#include "../header/trace.h"
+#include "../header/log_index.h"
+#include "../header/state_export.h"
 
 // Task Manager: Functions related to managing the task queue and worker processes
 
+// How many queued tasks startWorker() looks at when the first ones are throttled
+#define DISPATCH_SCAN_LIMIT 256
+
+// Defaults for the queue limits (see settings.h)
+#define QUEUE_MEMORY_LIMIT (64 * 1024 * 1024)
+#define QUEUE_SPILL_FILE "fss_queue.spill"
+#define COLLAPSE_LIMIT 10000
+
 // Global variables
-std::queue<task_t> task_queue;
-worker_info_t* active_workers = NULL;
+std::deque<task_t> task_queue;
+worker_info_t* active_workers = NULL;   // Slots of the running workers (pid 0 = free)
+int* worker_order = NULL;   // Slot numbers, the first worker_count are running, the rest are free
 int worker_count = 0;
 int worker_limit = 5;  // Default value
 volatile sig_atomic_t worker_finished_flag = 0;
+const char* worker_path = NULL;    // Absolute path of the worker executable (resolved at startup)
+int manager_log_fd = -1;    // Log of the manager, for queue events
+token_bucket global_fps_bucket;  // Files/s limit for all pairs (rate 0 = unlimited)
+uint64_t next_task_id = 1;
+size_t queue_memory = 0;    // Estimated memory used by the tasks in task_queue
+std::deque<task_t> staggered_syncs;     // Initial full syncs not queued yet (already in the task journal)
+token_bucket stagger_bucket;
 
 ///// HELPER FUNCTIONS /////
 
@@ -45,323 +74,762 @@ static void setupSignalHandler() {
     }
 }
 
-// Process output from a worker
-static int processWorkerOutput(int pipe_fd, const char* source, const char* target, int fss_out, int log_fd, const char* custom_timestamp) {
-    char* buffer = (char*)malloc(4096);
-    char* log_buffer = NULL;
-    
-    if (!buffer) {
-        perror("Failed to allocate buffer");
-        return 0;
-    }
+// FULL and SYNC tasks copy many files, their files/s limit is applied inside the worker
+static bool isFullSyncTask(const task_t* task) {
+    return task->op == OP_FULL || task->op == OP_SYNC;
+}
 
-    // Get worker PID and index from active_workers
-    pid_t worker_pid = 0;
-    int worker_index = -1;
-    for (int i = 0; i < worker_count; i++) {
-        if (active_workers[i].pipe_fd == pipe_fd) {
-            worker_pid = active_workers[i].pid;
-            worker_index = i;  // Save the worker index
-            break;
+// Report of a worker, parsed as its output arrives (one per worker slot)
+struct worker_report {
+    bool in_report;
+    bool in_errors;
+    int error_count;
+    long long throttled_ms;
+    long long bytes_copied;
+    long long files_copied;
+    long long files_charged;    // Files of a full sync already taken from the files/s buckets
+    task_timing timing;
+    str_builder status;
+    str_builder details;
+    str_builder errors;     // One error per line
+    str_builder line;       // Line that continues in the next read
+};
+
+worker_report* worker_reports = NULL;   // Report of the worker in each slot of active_workers
+
+// Parse one line of a worker's output
+static void parseReportLine(const char* line, worker_report* report) {
+    // Check for report markers
+    if (strcmp(line, "EXEC_REPORT_START") == 0) {
+        report->in_report = true;
+    } else if (strcmp(line, "EXEC_REPORT_END") == 0) {
+        report->in_report = false;
+        report->in_errors = false;
+    } else if (report->in_report) {
+        if (strncmp(line, "STATUS: ", 8) == 0) {
+            sbReset(&report->status);
+            sbAppend(&report->status, line + 8);
+        } else if (strncmp(line, "DETAILS: ", 9) == 0) {
+            sbReset(&report->details);
+            sbAppend(&report->details, line + 9);
+        } else if (strncmp(line, "THROTTLED: ", 11) == 0) {
+            report->throttled_ms = atoll(line + 11);
+        } else if (strncmp(line, "BYTES: ", 7) == 0) {
+            report->bytes_copied = atoll(line + 7);
+        } else if (strncmp(line, "COPIED: ", 8) == 0) {
+            report->files_copied = atoll(line + 8);
+        } else if (strncmp(line, "COPY_START_NS: ", 15) == 0) {
+            report->timing.copy_start_ns = strtoull(line + 15, NULL, 10);
+        } else if (strncmp(line, "COPY_END_NS: ", 13) == 0) {
+            report->timing.copy_end_ns = strtoull(line + 13, NULL, 10);
+        } else if (strcmp(line, "ERRORS:") == 0) {
+            report->in_errors = true;
+        } else if (report->in_errors) {
+            // Count and collect each error line
+            report->error_count++;
+            sbAppend(&report->errors, line);
+            sbAppendChar(&report->errors, '\n');
         }
     }
-    
-    // Make pipe non-blocking for reading
-    int flags = fcntl(pipe_fd, F_GETFL, 0);
-    fcntl(pipe_fd, F_SETFL, flags | O_NONBLOCK);
-    
-    ///// Process report /////
-    char* status = NULL;
-    char* details = NULL;
-    char* error_list = NULL;
-    size_t error_list_length = 0;
+}
+
+// Take the files a full sync worker handled since the last call from the global and pair files/s buckets
+// The worker throttles itself with its share, this puts its files in debt of the buckets single file tasks use
+static void chargeSyncFiles(sync_info_entry* info, worker_report* report, long long files) {
+    if (files <= report->files_charged) return;
+    chargeTokens(&global_fps_bucket, files - report->files_charged);
+    if (info) chargeTokens(&info->fps_bucket, files - report->files_charged);
+    report->files_charged = files;
+}
+
+// Keep the progress a full sync worker reported on its pair
+// "PROGRESS: <files done> <files total> <bytes done> <bytes total>" (totals are the worker's estimate)
+static void updateSyncProgress(const worker_info_t* worker, worker_report* report, const char* values) {
+    sync_info_entry* info = getSyncInfoById(worker->task.pair);
+    if (!info) return;
+    if (!info->progress) {
+        info->progress = (sync_progress*)calloc(1, sizeof(sync_progress));
+        if (!info->progress) return;
+    }
+
+    sync_progress* progress = info->progress;
+    if (sscanf(values, "%lld %lld %lld %lld", &progress->files_done, &progress->files_total,
+               &progress->bytes_done, &progress->bytes_total) != 4) return;
+    progress->pid = worker->pid;
+    progress->started_ns = worker->dispatched_ns;
+    progress->updated_ns = getMonotonicNs();
+    chargeSyncFiles(info, report, progress->files_done);
+}
 
+// Read what a worker wrote so far (without blocking) and parse it line by line, a line may continue in the next read
+static void readWorkerPipe(const worker_info_t* worker, worker_report* report) {
+    char buffer[4096];
     ssize_t bytes_read;
-    bool in_report = false;
-    bool in_errors = false;
-    int error_count = 0;
-    while ((bytes_read = read(pipe_fd, buffer, 4095)) > 0) {
-        buffer[bytes_read] = '\0';
-        
-        // Process it line by line
-        char *line = buffer;
-        char *next_line;
-        
-        while ((next_line = strchr(line, '\n')) != NULL) {
-            *next_line = '\0';
-            
-            // Check for report markers
-            if (strcmp(line, "EXEC_REPORT_START") == 0) {
-                in_report = true;
-            } else if (strcmp(line, "EXEC_REPORT_END") == 0) {
-                in_report = false;
-                in_errors = false;
-            } else if (in_report) {
-                if (strncmp(line, "STATUS: ", 8) == 0) {
-                    status = strdup(line + 8);
-                } else if (strncmp(line, "DETAILS: ", 9) == 0) {
-                    details = strdup(line + 9);
-                } else if (strcmp(line, "ERRORS:") == 0) {
-                    in_errors = true;
-                } else if (in_errors) {
-                    // Count each error line
-                    error_count++;
-                    
-                    // Collect error messages
-                    char* temp = (char*)malloc(error_list_length + strlen(line) + 2);
-                    if (temp) {
-                        if (error_list) {
-                            memcpy(temp, error_list, error_list_length);
-                            free(error_list);
-                        }
-                        strcpy(temp + error_list_length, line);
-                        error_list_length += strlen(line);
-                        temp[error_list_length++] = '\n';
-                        temp[error_list_length] = '\0';
-                        error_list = temp;
-                    }
-                }
+    while ((bytes_read = read(worker->pipe_fd, buffer, sizeof(buffer))) > 0) {
+        const char* chunk = buffer;
+        const char* chunk_end = buffer + bytes_read;
+        while (chunk < chunk_end) {
+            const char* newline = (const char*)memchr(chunk, '\n', chunk_end - chunk);
+            if (!newline) {
+                sbAppendLength(&report->line, chunk, chunk_end - chunk);
+                break;
             }
-            
-            line = next_line + 1;
+            sbAppendLength(&report->line, chunk, newline - chunk);
+            const char* line = sbString(&report->line);
+            if (strncmp(line, "PROGRESS: ", 10) == 0) {
+                updateSyncProgress(worker, report, line + 10);
+            } else {
+                parseReportLine(line, report);
+            }
+            sbReset(&report->line);
+            chunk = newline + 1;
         }
     }
+}
+
+// Process output from a worker
+static int processWorkerOutput(const worker_info_t* worker, sync_info_entry* info, const struct rusage* rusage,
+                               int fss_out, int log_fd, const char* custom_timestamp) {
+    uint64_t parse_start_ns = trace_enabled ? getMonotonicNs() : 0;
+    pid_t worker_pid = worker->pid;
+    const char* source = info ? info->source_dir : "";
+    const char* target = worker->target_dir ? worker->target_dir : info ? info->target_dir : "";
+    
+    ///// Process report /////
+    // The rest of the output (most of it was read while the worker ran)
+    worker_report& report = worker_reports[worker - active_workers];
+    task_timing& timing = report.timing;
+    readWorkerPipe(worker, &report);
+
+    // The full sync is over, its progress is no longer shown
+    if (info && info->progress && info->progress->pid == worker_pid) {
+        free(info->progress);
+        info->progress = NULL;
+    }
     
+    // Files of a full sync that were not charged while it ran
+    if (isFullSyncTask(&worker->task)) chargeSyncFiles(info, &report, report.files_copied);
+
+    // Time the worker spent sleeping because of bytes/s or files/s limits
+    if (info) info->throttled_ms += report.throttled_ms;
+
+    // Update metrics (a worker that died without a report counts as failed)
+    const char* status = sbString(&report.status);
+    bool failed = strcmp(status, "SUCCESS") != 0;
+    metrics.tasks_completed++;
+    if (failed) metrics.tasks_failed++;
+    if (info) {
+        info->bytes_copied += report.bytes_copied;
+        info->files_copied += report.files_copied;
+        info->tasks_completed++;
+        if (failed) info->tasks_failed++;
+    }
+    const task_t* task = &worker->task;
+    timing.event_ns = task->event_ns;
+    timing.enqueued_ns = task->enqueued_ns;
+    timing.dispatched_ns = worker->dispatched_ns;
+    timing.parsed_ns = getMonotonicNs();
+    observeLatency(&metrics.completion_latency, (timing.parsed_ns - timing.enqueued_ns) / 1e9);
+    if (info) recordTaskLatency(info, &timing);
+    task_usage usage;
+    recordTaskUsage(info, task->op, rusage, &usage);
+
     ///// Generate completion message for sync command operation /////
-    const char* operation = active_workers[worker_index].task.operation;
-    if (strcmp(operation, "SYNC") == 0) {
-        char* sync_msg = (char*)malloc(strlen(source) + strlen(target) + 50);
-        if (sync_msg) {
-            sprintf(sync_msg, "Sync completed %s -> %s Errors:%d\n", source, target, error_count);
-            sync_msg = addTimestampToMessage(sync_msg, custom_timestamp);
-            if (sync_msg) {
-                // Send console message with new function
-                forwardMessage(sync_msg, fss_out, log_fd);
-                free(sync_msg);
-            }
-        }
+    const char* op = taskOpName(task->op);
+    str_builder msg;
+    sbInit(&msg);
+    if (task->op == OP_SYNC) {
+        appendTimestamp(&msg, custom_timestamp);
+        sbAppend(&msg, "Sync completed ");
+        sbAppend(&msg, source);
+        sbAppend(&msg, " -> ");
+        sbAppend(&msg, target);
+        sbAppend(&msg, " Errors:");
+        sbAppendInt(&msg, report.error_count);
+        sbAppendChar(&msg, '\n');
+        forwardMessage(sbString(&msg), fss_out, log_fd);
+        sbReset(&msg);
     }
     
     ///// For log file - structured format /////
     // [TIMESTAMP] [SOURCE_DIR] [TARGET_DIR] [WORKER_PID] [OPERATION] [RESULT] [DETAILS]
     
-    // Extract timestamp without brackets
-    char* clean_timestamp = NULL;
-    if (custom_timestamp) {
-        size_t ts_len = strlen(custom_timestamp);
-        if (ts_len > 3) {
-            clean_timestamp = (char*)malloc(ts_len - 1);
-            if (clean_timestamp) {
-                strncpy(clean_timestamp, custom_timestamp + 1, ts_len - 3);
-                clean_timestamp[ts_len - 3] = '\0';
-            }
-        }
-    }
-    if (!clean_timestamp) clean_timestamp = strdup("timestamp-error");
-    
     // Choose appropriate details based on operation type
-    const char* log_details = "";
-    const char* op = active_workers[worker_index].task.operation;
-    
-    // Safety checks for NULL pointers
-    if (!status) status = strdup("");
-    if (!details) details = strdup("");
-    if (!error_list) error_list = strdup("");
+    const char* log_details = sbString(&report.details);
+    size_t log_details_length = sbLength(&report.details);
     
     // For FULL or SYNC operations, use the details field from the report
-    if (op && (strcmp(op, "FULL") == 0 || strcmp(op, "SYNC") == 0)) {
-        if (details && strlen(details) > 0) {
-            log_details = details;
-        }
+    // Otherwise use the first error if there is one (or the filename from the details)
+    if (task->op != OP_FULL && task->op != OP_SYNC && report.error_count > 0) {
+        log_details = sbString(&report.errors);
+        log_details_length = strcspn(log_details, "\n");
+    }
+    
+    // Timestamp without the trailing space: "[2025-01-01 12:30:45] " -> "[2025-01-01 12:30:45]"
+    size_t timestamp_length = custom_timestamp ? strlen(custom_timestamp) : 0;
+    if (timestamp_length > 3) {
+        sbAppendLength(&msg, custom_timestamp, timestamp_length - 1);
     } else {
-        if (error_count > 0 && error_list && strlen(error_list) > 0) {
-            // Use the first line of error_list for details
-            char* newline = strchr(error_list, '\n');
-            if (newline) *newline = '\0';
-            log_details = error_list;
-        } else {
-            // No errors, just use the filename if available
-            log_details = details ? details : "";
-        }
+        sbAppend(&msg, "[timestamp-error]");
     }
+    sbAppend(&msg, " [");
+    sbAppend(&msg, source);
+    sbAppend(&msg, "] [");
+    sbAppend(&msg, target);
+    sbAppend(&msg, "] [");
+    sbAppendInt(&msg, worker_pid);
+    sbAppend(&msg, "] [");
+    sbAppend(&msg, op);
+    sbAppend(&msg, "] [");
+    sbAppend(&msg, status);
+    sbAppend(&msg, "] [");
+    sbAppendLength(&msg, log_details, log_details_length);
     
-    // Format log entry with
-    log_buffer = (char*)malloc(strlen(clean_timestamp) + 
-                               strlen(source ? source : "") + 
-                               strlen(target ? target : "") + 
-                               strlen(op ? op : "") + 
-                               strlen(status ? status : "") + 
-                               strlen(log_details ? log_details : "") + 100);
-    if (log_buffer) {
-        sprintf(log_buffer, "[%s] [%s] [%s] [%d] [%s] [%s] [%s]\n", 
-                clean_timestamp, 
-                source ? source : "", 
-                target ? target : "", 
-                (int)worker_pid,
-                op ? op : "", 
-                status ? status : "", 
-                log_details ? log_details : "");
-        
-        // Send log message
-        forwardMessage(log_buffer, -1, log_fd);
+    // Mention throttling so it can be told apart from slow storage
+    if (report.throttled_ms > 0) {
+        sbAppend(&msg, " (throttled ");
+        sbAppendInt(&msg, report.throttled_ms);
+        sbAppend(&msg, " ms)");
+    }
+    appendTaskUsage(&msg, &usage);  // What the worker cost
+    sbAppend(&msg, "]\n");
+    
+    // Send log message
+    forwardMessage(sbString(&msg), -1, log_fd);
+    
+    // Same result in the log index (as fss_script would read it: only these statuses count as a sync)
+    if (timestamp_length > 3 && (!strcmp(status, "SUCCESS") || !strcmp(status, "PARTIAL") || !strcmp(status, "ERROR"))) {
+        char sync_time[TIMESTAMP_SIZE];
+        memcpy(sync_time, custom_timestamp + 1, timestamp_length - 3);
+        sync_time[timestamp_length - 3] = '\0';
+        indexSyncResult(source, target, sync_time, status);
+    }
+    
+    // Spans of the task on the worker's track
+    if (trace_enabled) {
+        int tid = (int)worker_pid;
+        const char* file = task->filename;
+        traceSpan("queued", op, tid, timing.enqueued_ns, timing.dispatched_ns, "file", file);
+        if (timing.copy_start_ns && timing.copy_end_ns) {
+            traceSpan("fork/exec", op, tid, timing.dispatched_ns, timing.copy_start_ns, NULL, NULL);
+            traceSpan("worker run", op, tid, timing.copy_start_ns, timing.copy_end_ns, "status", status);
+        }
+        traceSpan("report parsing", op, tid, parse_start_ns, getMonotonicNs(), NULL, NULL);
     }
     
     // Cleanup
-    free(buffer);
-    if (log_buffer) free(log_buffer);
-    if (status) free(status);
-    if (details) free(details);
-    if (error_list) free(error_list);
-    if (clean_timestamp) free(clean_timestamp);
+    sbFree(&msg);
+    sbFree(&report.status);
+    sbFree(&report.details);
+    sbFree(&report.errors);
+    sbFree(&report.line);
     
-    return error_count;
+    return report.error_count;
 }
 
-// Initialize a task
-void initTask(task_t* task, const char* source, const char* target, 
-            const char* filename, const char* operation) {
-    // Allocate and copy source/target paths, filename and operation
-    task->source = strdup(source);
-    task->target = strdup(target);    
-    task->filename = strdup(filename);
-    task->operation = strdup(operation);
+// Initialize a task of a pair (the filename is copied into the task pool)
+static bool initTask(task_t* task, const sync_info_entry* info, const char* filename, task_op op) {
+    task->filename = NULL;
+    if (!setTaskFilename(task, filename, strlen(filename))) {
+        perror("Memory allocation failed in initTask");
+        return false;
+    }
+    task->id = next_task_id++;
+    task->pair = info->index;
+    task->op = op;
+    task->throttled_since = 0;
+    task->enqueued_ns = getMonotonicNs();
+    task->event_ns = task->enqueued_ns;
+    return true;
 }
 
-// Free all memory allocated for a task
-void freeTaskMemory(task_t* task) {
-    if (task->source) free(task->source);
-    if (task->target) free(task->target);
-    if (task->filename) free(task->filename);
-    if (task->operation) free(task->operation);
-    
-    // Reset pointers to avoid double-free issues
-    task->source = NULL;
-    task->target = NULL;
-    task->filename = NULL;
-    task->operation = NULL;
+// Estimated heap memory used by a queued task (the struct and its pooled filename)
+static size_t taskMemorySize(const task_t* task) {
+    return sizeof(task_t) + taskNameSize(task->filename, task->name_class);
 }
 
-// Copy task data from source to destination
-void copyTask(task_t* dest, const task_t* src) {
-    // First free any existing memory in destination
-    freeTaskMemory(dest);
-    
-    // Then copy all fields with new memory allocation
-    dest->source = strdup(src->source);
-    dest->target = strdup(src->target);
-    dest->filename = strdup(src->filename);
-    dest->operation = strdup(src->operation);
+// Memory cap of the in-memory queue
+static size_t queueMemoryLimit() {
+    return settings.queue_memory > 0 ? (size_t)settings.queue_memory : QUEUE_MEMORY_LIMIT;
+}
+
+// Append a task to the queue, or to the spill file if the queue is full (or already spilling, to keep the order)
+static void pushQueuedTask(task_t* task) {
+    size_t size = taskMemorySize(task);
+    if (getSpilledTaskCount() > 0 || queue_memory + size > queueMemoryLimit()) {
+        if (spillTask(task, settings.queue_spill_path[0] ? settings.queue_spill_path : QUEUE_SPILL_FILE)) {
+            freeTaskMemory(task);
+            return;
+        }
+        // If spilling fails, keep the task in memory rather than losing it
+    }
+
+    task_queue.push_back(*task);
+    queue_memory += size;
+}
+
+// Remove the task at index from the queue and return it
+static task_t takeQueuedTask(size_t index) {
+    task_t task = task_queue[index];
+    task_queue.erase(task_queue.begin() + index);
+    queue_memory -= taskMemorySize(&task);
+
+    sync_info_entry* info = getSyncInfoById(task.pair);
+    if (info) {
+        info->queued_tasks--;
+        markStateDirty(info);
+    }
+    return task;
+}
+
+// Move spilled tasks back to memory once the queue has drained below 3/4 of its cap
+static void refillQueueFromSpill() {
+    size_t low_watermark = queueMemoryLimit() / 4 * 3;
+    task_t task;
+    while (getSpilledTaskCount() > 0 && queue_memory < low_watermark && readSpilledTask(&task)) {
+        task_queue.push_back(task);
+        queue_memory += taskMemorySize(&task);
+    }
+}
+
+// Find the first queued task that the files/s limits allow to start now
+// Tasks of a throttled pair are skipped, so the order of tasks within each pair is kept
+// Returns index in task_queue or -1 if every task looked at is throttled
+static int findDispatchableTask() {
+    static std::vector<sync_info_entry*> blocked_pairs;
+    blocked_pairs.clear();
+    bool global_blocked = false;
+    uint64_t now = getMonotonicNs();
+
+    size_t i = 0;
+    while (i < std::min(task_queue.size(), (size_t)DISPATCH_SCAN_LIMIT)) {
+        task_t* task = &task_queue[i];
+        sync_info_entry* info = getSyncInfoById(task->pair);
+
+        // The backlog of this pair was collapsed into a full sync, which covers this task
+        if (info && info->collapse_task_id && !isFullSyncTask(task)) {
+            task_t dropped = takeQueuedTask(i);
+            journalTaskDone(dropped.id);
+            freeTaskMemory(&dropped);
+            continue;
+        }
+
+        // An earlier task of this pair is waiting, this one has to wait too
+        if (info && std::find(blocked_pairs.begin(), blocked_pairs.end(), info) != blocked_pairs.end()) {
+            i++;
+            continue;
+        }
+
+        if (isFullSyncTask(task)) return (int)i;
+
+        // Single file task: take one token from both the global and the pair bucket
+        bool allowed = false;
+        if (!global_blocked) {
+            if (tryConsumeTokens(&global_fps_bucket, 1)) {
+                if (!info || tryConsumeTokens(&info->fps_bucket, 1)) {
+                    allowed = true;
+                } else {
+                    global_fps_bucket.tokens += 1;  // Give back the global token
+                }
+            } else {
+                global_blocked = true;
+            }
+        }
+        if (allowed) return (int)i;
+
+        if (task->throttled_since == 0) task->throttled_since = now;
+        if (info) blocked_pairs.push_back(info);
+        i++;
+    }
+
+    return -1;
+}
+
+// Share of a limit each of the workers using it gets (0 = unlimited, may be a fraction)
+static double shareLimit(long long limit, int workers) {
+    if (limit <= 0) return 0;
+    return (double)limit / std::max(workers, 1);
+}
+
+// Running workers of a pair (or of all pairs if pair is -1), only those with full syncs if full_sync is set
+static int countWorkers(int64_t pair, bool full_sync) {
+    int count = 0;
+    for (int i = 0; i < worker_count; i++) {
+        const task_t* task = &active_workers[worker_order[i]].task;
+        if ((pair < 0 || task->pair == pair) && (!full_sync || isFullSyncTask(task))) count++;
+    }
+    return count;
+}
+
+// Calculate the bytes/s and files/s limits of a worker running task, the limits are split evenly among the running
+// workers they apply to (extra counts workers not started yet), so together they never go over them
+// Only FULL/SYNC workers use files/s limits, single file tasks take their file from the buckets at dispatch
+static void getWorkerLimits(const sync_info_entry* info, const task_t* task, int extra, double* bps, double* fps) {
+    double pair_bps = info ? shareLimit(info->limit_bps, countWorkers(info->index, false) + extra) : 0;
+    double global_bps = shareLimit(settings.global_bps, worker_count + extra);
+    double pair_fps = 0, global_fps = 0;
+    if (isFullSyncTask(task)) {
+        pair_fps = info ? shareLimit(info->limit_fps, countWorkers(info->index, true) + extra) : 0;
+        global_fps = shareLimit(settings.global_fps, countWorkers(-1, true) + extra);
+    }
+
+    // Use the strictest limit that is set
+    *bps = (pair_bps && global_bps) ? std::min(pair_bps, global_bps) : (pair_bps ? pair_bps : global_bps);
+    *fps = (pair_fps && global_fps) ? std::min(pair_fps, global_fps) : (pair_fps ? pair_fps : global_fps);
+}
+
+// Send every running worker whose share changed its new limits (after workers started or stopped, or limits changed)
+static void rebalanceWorkerLimits() {
+    for (int i = 0; i < worker_count; i++) {
+        worker_info_t* worker = &active_workers[worker_order[i]];
+        double bps, fps;
+        getWorkerLimits(getSyncInfoById(worker->task.pair), &worker->task, 0, &bps, &fps);
+        if (bps == worker->bps && fps == worker->fps) continue;
+
+        // A few bytes into an almost empty pipe, a worker that already exited is reaped soon (SIGPIPE is ignored)
+        char line[96];
+        int length = snprintf(line, sizeof(line), "LIMITS: %.3f %.3f\n", bps, fps);
+        if (write(worker->limits_fd, line, length) == length) {
+            worker->bps = bps;
+            worker->fps = fps;
+        }
+    }
+}
+
+// Priority of a task's worker, each value from the most specific place that sets it
+static void getWorkerPriority(const task_t* task, const sync_info_entry* info, worker_priority* priority) {
+    priority_class priority_class = (task->op == OP_FULL || task->op == OP_SYNC) ? PRIORITY_BULK : PRIORITY_EVENT;
+    memset(priority, 0, sizeof(*priority));
+    if (info->priority) {
+        mergePriority(priority, &info->priority[priority_class]);
+        mergePriority(priority, &info->priority[PRIORITY_ALL]);
+    }
+    mergePriority(priority, &settings.priority[priority_class]);
+    mergePriority(priority, &settings.priority[PRIORITY_ALL]);
+}
+
+// Queue the staggered full syncs whose turn came (all of them if all is set)
+static void releaseStaggeredSyncs(bool all) {
+    while (!staggered_syncs.empty() && (all || tryConsumeTokens(&stagger_bucket, 1))) {
+        task_t task = staggered_syncs.front();
+        staggered_syncs.pop_front();
+
+        // The pair was deleted meanwhile
+        if (!getSyncInfoById(task.pair)) {
+            journalTaskDone(task.id);
+            freeTaskMemory(&task);
+            continue;
+        }
+
+        // Its journal record stays valid, the wait for its turn is not counted as queue time
+        task.enqueued_ns = getMonotonicNs();
+        task.event_ns = task.enqueued_ns;
+        pushQueuedTask(&task);
+    }
+}
+
+// Take a free worker slot (worker_count < worker_limit), O(1)
+static worker_info_t* acquireWorkerSlot() {
+    worker_info_t* worker = &active_workers[worker_order[worker_count]];
+    worker->position = worker_count++;
+    return worker;
+}
+
+// Give a worker slot back, O(1): the last running slot takes its place in worker_order
+static void releaseWorkerSlot(worker_info_t* worker) {
+    int slot = worker - active_workers;
+    int last = worker_order[--worker_count];
+    worker_order[worker->position] = last;
+    active_workers[last].position = worker->position;
+    worker_order[worker_count] = slot;
+    worker->pid = 0;
+}
+
+// Running worker with this pid (NULL if none)
+static worker_info_t* findWorker(pid_t pid) {
+    for (int i = 0; i < worker_count; i++) {
+        if (active_workers[worker_order[i]].pid == pid) return &active_workers[worker_order[i]];
+    }
+    return NULL;
 }
 
 ///// MAIN FUNCTIONS /////
 
 // Initialize worker management system
-void initWorkerManager(int max_workers) {
+void initWorkerManager(int max_workers, int log_fd) {
     worker_limit = max_workers;
+    manager_log_fd = log_fd;
     worker_count = 0;
+    initTokenBucket(&stagger_bucket, STAGGER_RATE);
     
-    // Allocate memory for the active_workers array based on worker_limit
-    active_workers = (worker_info_t*)malloc(sizeof(worker_info_t) * worker_limit);
-    if (!active_workers) {
+    // Allocate the worker slots based on worker_limit
+    active_workers = (worker_info_t*)calloc(worker_limit, sizeof(worker_info_t));
+    worker_reports = (worker_report*)calloc(worker_limit, sizeof(worker_report));
+    worker_order = (int*)malloc(sizeof(int) * worker_limit);
+    if (!active_workers || !worker_reports || !worker_order) {
         perror("Failed to allocate memory for worker array");
         exit(1);
     }
+    for (int i = 0; i < worker_limit; i++) worker_order[i] = i;
+    worker_path = resolveWorkerPath();
     
     setupSignalHandler();
 }
 
-// Add a new task to the queue
-bool addTaskToQueue(const char* source, const char* target, const char* filename,
-                    const char* operation, bool checkExistingTask) {
+// Name of an operation
+const char* taskOpName(task_op op) {
+    static const char* names[TASK_OPS] = {"ADDED", "MODIFIED", "DELETED", "FULL", "SYNC"};
+    return op < TASK_OPS ? names[op] : "";
+}
+
+// Operation of a name
+bool parseTaskOp(const char* name, task_op* op) {
+    for (int candidate = 0; candidate < TASK_OPS; candidate++) {
+        if (strcmp(name, taskOpName((task_op)candidate)) == 0) {
+            *op = (task_op)candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Add a new task for a pair to the queue
+bool addTaskToQueue(sync_info_entry* info, const char* filename, task_op op, bool checkExistingTask, uint64_t event_ns) {
+    if (!info) return false;
+
     // For sync command: check if the task is already queued
     if (checkExistingTask)
-        if (isTaskQueued(source))
+        if (isTaskQueued(info))
             return false;
     
+    bool collapse = false;
+    if (op != OP_FULL && op != OP_SYNC) {
+        // A full sync of this pair is already pending, it will pick up this change too
+        if (info->collapse_task_id) return true;
+        
+        // Too many tasks for this pair, replace the rest of its backlog with one full sync
+        int collapse_limit = settings.collapse_limit > 0 ? settings.collapse_limit : COLLAPSE_LIMIT;
+        if (info->queued_tasks >= collapse_limit) {
+            str_builder msg;
+            startMessage(&msg);
+            sbAppendFormat(&msg, "Too many queued tasks (%d) for %s, collapsing them into a full sync\n",
+                           info->queued_tasks, info->source_dir);
+            forwardMessage(sbString(&msg), -1, manager_log_fd);
+            sbFree(&msg);
+            metrics.queue_collapses++;
+            filename = "ALL";
+            op = OP_FULL;
+            collapse = true;
+        }
+    }
+    
     // Copy task details to the task structure
     task_t task;
-    initTask(&task, source, target, filename ? filename : "", operation);
+    if (!initTask(&task, info, filename ? filename : "", op)) return false;
+    if (event_ns) task.event_ns = event_ns;
+    if (collapse) info->collapse_task_id = task.id;
+    info->queued_tasks++;
+    markStateDirty(info);
     
-    task_queue.push(task);  // Add task to the queue
+    metrics.tasks_enqueued++;
+    journalTaskAdded(&task);
+    pushQueuedTask(&task);  // Add task to the queue
     return true; // Task was added successfully
 }
 
-// Check if any task is already queued or in progress for this directory
-bool isTaskQueued(const char* directory) {
-    // Check active workers for any task with this directory
-    for (int i = 0; i < worker_count; i++) {
-        if (strcmp(active_workers[i].task.source, directory) == 0) {
-            return true;  // A worker is already processing this directory
-        }
+// Set the filename of a task
+bool setTaskFilename(task_t* task, const char* filename, size_t length) {
+    task->filename = allocTaskName(filename, length, &task->name_class);
+    return task->filename != NULL;
+}
+
+// Free all memory allocated for a task
+void freeTaskMemory(task_t* task) {
+    freeTaskName(task->filename, task->name_class);
+    task->filename = NULL;     // Avoid double-free issues
+}
+
+// Queue a full sync that replaces the queued tasks of this pair (used when events were lost)
+bool queueRescan(sync_info_entry* info) {
+    if (!info || info->collapse_task_id) return false;
+    
+    task_t task;
+    if (!initTask(&task, info, "ALL", OP_FULL)) return false;
+    info->collapse_task_id = task.id;  // Queued tasks of the pair are dropped, the full sync covers them
+    info->queued_tasks++;
+    info->rescan_count++;
+    markStateDirty(info);
+    
+    metrics.tasks_enqueued++;
+    journalTaskAdded(&task);
+    pushQueuedTask(&task);
+    return true;
+}
+
+// Queue the initial full sync of a pair once the stagger rate allows it
+void scheduleFullSync(sync_info_entry* info) {
+    if (staggered_syncs.empty()) {
+        setTokenBucketRate(&stagger_bucket, settings.stagger > 0 ? settings.stagger : STAGGER_RATE);
+    }
+
+    // Journaled now, so a crash before its turn does not lose it
+    task_t task;
+    if (!initTask(&task, info, "ALL", OP_FULL)) return;
+    info->queued_tasks++;   // Pending like a queued task (cancel waits for it, status shows it)
+    markStateDirty(info);
+
+    metrics.tasks_enqueued++;
+    journalTaskAdded(&task);
+    staggered_syncs.push_back(task);
+}
+
+// Check if any task is already queued or in progress for this pair
+bool isTaskQueued(const sync_info_entry* info) {
+    // Check queue (and spill file) for any task of this pair
+    if (info->queued_tasks > 0) {
+        return true;  // A task for this directory is already queued
     }
     
-    // Check queue for any task with this directory
-    std::queue<task_t> temp_queue = task_queue;
-    while (!temp_queue.empty()) {
-        task_t task = temp_queue.front();
-        temp_queue.pop();
-        
-        if (strcmp(task.source, directory) == 0) {
-            return true;  // A task for this directory is already queued
+    // Check active workers for any task of this pair
+    for (int i = 0; i < worker_count; i++) {
+        if (active_workers[worker_order[i]].task.pair == info->index) {
+            return true;  // A worker is already processing this directory
         }
     }
-    
     return false;  // No task found for this directory
 }
 
 // Start worker processes to handle tasks in the queue
 void startWorker() {
-    while (!task_queue.empty() && worker_count < worker_limit) {    // As long as there are tasks or workers available
-        task_t task = task_queue.front();
-        task_queue.pop();
+    releaseStaggeredSyncs(false);
+    int running = worker_count;
+    while (worker_count < worker_limit) {    // As long as there are tasks or workers available
+        refillQueueFromSpill();
+        if (task_queue.empty()) break;
         
-        // Create pipe for worker output
-        int pipe_fds[2];
-        if (pipe(pipe_fds) == -1) {
-            perror("pipe");
-            task_queue.push(task);
+        int task_index = findDispatchableTask();
+        if (task_index < 0) break;  // Everything is throttled for now
+
+        task_t task = takeQueuedTask(task_index);
+
+        // Pairs with pending tasks are not removed, but never start a task without its pair
+        sync_info_entry* info = getSyncInfoById(task.pair);
+        if (!info) {
+            journalTaskDone(task.id);
+            freeTaskMemory(&task);
             continue;
         }
+
+        // The full sync that replaced the backlog of this pair is starting, queue new changes again
+        if (info->collapse_task_id == task.id) {
+            info->collapse_task_id = 0;
+        }
+
+        // Account the time the task was held back by files/s limits
+        if (task.throttled_since) {
+            info->throttled_ms += (long long)((getMonotonicNs() - task.throttled_since) / 1000000);
+            task.throttled_since = 0;
+        }
+
+        // Limits given to the worker for its copy loop (its share, counting itself)
+        double bps, fps;
+        getWorkerLimits(info, &task, 1, &bps, &fps);
+        char bps_arg[48], fps_arg[48];
+        sprintf(bps_arg, "bps=%.3f", bps);
+        sprintf(fps_arg, "fps=%.3f", fps);
+
+        // CPU and I/O priority, applied by the worker itself (posix_spawn runs no code in the child before exec)
+        worker_priority priority;
+        getWorkerPriority(&task, info, &priority);
+        char priority_args[PRIORITY_ARGS][PRIORITY_ARG_MAX];
+        int priority_count = formatPriorityArgs(&priority, priority_args);
         
-        // Create child process
-        pid_t pid = fork();
+        // Create pipes for worker output and new limits (close-on-exec, so workers do not inherit each other's pipes)
+        uint64_t spawn_start = getMonotonicNs();
+        int pipe_fds[2], limits_fds[2];
+        bool piped = pipe2(pipe_fds, O_CLOEXEC) == 0;
+        if (piped && pipe2(limits_fds, O_CLOEXEC) == -1) {
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            piped = false;
+        }
+        if (!piped) {
+            perror("pipe");
+            task_queue.push_front(task);  // Try again in the next loop
+            queue_memory += taskMemorySize(&task);
+            info->queued_tasks++;
+            markStateDirty(info);
+            break;
+        }
+        
+        // Prepare arguments for the worker executable
+        char limits_arg[] = "limits_fd=0";     // New limits arrive on its stdin
+        char *args[9 + PRIORITY_ARGS];
+        args[0] = (char*)worker_path;
+        args[1] = info->source_dir;
+        args[2] = info->target_dir;
+        args[3] = task.filename;
+        args[4] = (char*)taskOpName(task.op);
+        args[5] = bps_arg;
+        args[6] = fps_arg;
+        args[7] = limits_arg;
+        for (int i = 0; i < priority_count; i++) args[8 + i] = priority_args[i];
+        args[8 + priority_count] = NULL;
+
+        // Start the worker with its stdout on the output pipe and its stdin on the limits pipe
+        spawn_method method = settings.spawn_fork ? SPAWN_FORK : SPAWN_POSIX;
+        pid_t pid = launchWorker(worker_path, args, limits_fds[0], pipe_fds[1], method);
+        close(pipe_fds[1]);  // Close write end
+        close(limits_fds[0]);   // Close read end
         
         if (pid < 0) {
-            perror("fork");
-            close(pipe_fds[0]); 
-            close(pipe_fds[1]);
+            perror("Error starting worker");
+            close(pipe_fds[0]);
+            close(limits_fds[1]);
+            journalTaskDone(task.id);
             freeTaskMemory(&task);
             break;
-        } else if (pid == 0) {    // Child process - worker
-            close(pipe_fds[0]);  // Close read end
-            
-            // Redirect stdout to the pipe
-            dup2(pipe_fds[1], STDOUT_FILENO);
-            close(pipe_fds[1]);
-            
-            // Prepare arguments for the worker executable
-            char *args[6];
-            args[0] = (char*)"./bin/worker";  // Worker path
-            args[1] = task.source;
-            args[2] = task.target;
-            args[3] = task.filename;
-            args[4] = task.operation;
-            args[5] = NULL;
-
-            // Execute the worker
-            execv(args[0], args);
-            
-            perror("execv");    // If execv fails, print error and exit
-            exit(1);
-        } else {  // Parent process - manager
-            close(pipe_fds[1]);  // Close write end
-            
-            // Only now update the active_workers array
-            active_workers[worker_count].pid = pid;
-            active_workers[worker_count].pipe_fd = pipe_fds[0];
-            active_workers[worker_count].task = task;
-            worker_count++;
         }
+
+        observeLatency(&metrics.spawn_latency, (getMonotonicNs() - spawn_start) / 1e9);
+        metrics.tasks_dispatched++;
+        
+        // Only now take a worker slot
+        worker_info_t* worker = acquireWorkerSlot();
+        worker->pid = pid;
+        worker->pipe_fd = pipe_fds[0];
+        worker->limits_fd = limits_fds[1];
+        worker->bps = bps;
+        worker->fps = fps;
+        worker->task = task;
+        worker->dispatched_ns = spawn_start;
+        worker->target_dir = allocTaskName(info->target_dir, strlen(info->target_dir), &worker->target_class);
+
+        // Its output is read while it runs and its limits are sent, both without blocking the loop
+        fcntl(pipe_fds[0], F_SETFL, fcntl(pipe_fds[0], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(limits_fds[1], F_SETFL, fcntl(limits_fds[1], F_GETFL, 0) | O_NONBLOCK);
+        worker_report* report = &worker_reports[worker - active_workers];
+        *report = {};
+        sbInit(&report->status);
+        sbInit(&report->details);
+        sbInit(&report->errors);
+        sbInit(&report->line);
+        if (trace_enabled) {
+            char track_name[32];
+            sprintf(track_name, "worker %d", (int)pid);
+            traceTrackName((int)pid, track_name);
+        }
+    }
+
+    // The workers that were already running get a smaller share now
+    if (worker_count != running) rebalanceWorkerLimits();
+}
+
+// Read the output of the running workers (progress lines and the start of their reports)
+void readWorkerOutput() {
+    for (int i = 0; i < worker_count; i++) {
+        int slot = worker_order[i];
+        readWorkerPipe(&active_workers[slot], &worker_reports[slot]);
     }
 }
 
@@ -371,94 +839,74 @@ void processFinishedWorker(int fss_out, int log_fd) {
     worker_finished_flag = 0;
     
     int status;
+    struct rusage rusage;
     pid_t pid;
+    int running = worker_count;
     
-    // Wait for all terminated children
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    // Wait for all terminated children (with the resources each one used)
+    while ((pid = wait4(-1, &status, WNOHANG, &rusage)) > 0) {
         // Find which worker terminated
-        int worker_index = -1;
-        for (int i = 0; i < worker_count; i++) {
-            if (active_workers[i].pid == pid) {
-                worker_index = i;
-                break;
-            }
-        }
-        
-        if (worker_index >= 0) {
-            int pipe_fd = active_workers[worker_index].pipe_fd;
-            
-            // Access source and target directly - no need for local copies
-            const char* source = active_workers[worker_index].task.source;
-            const char* target = active_workers[worker_index].task.target;
-            
-            // Generate timestamp once for both uses
-            char* timestamp = getTimestamp();
-            if (!timestamp) {
-                // Handle allocation failure
-                timestamp = strdup("[error] ");
-                if (!timestamp) {
-                    // Critical failure, continue with next worker
-                    continue;
-                }
-            }
+        worker_info_t* worker = findWorker(pid);
+        if (worker) {
+            // Take timestamp once for both uses
+            char timestamp[TIMESTAMP_SIZE];
+            time_t sync_time = time(NULL);
+            strcpy(timestamp, currentTimestamp());
             
             // Process output using our timestamp
-            int errors_num = processWorkerOutput(pipe_fd, source, target, fss_out, log_fd, timestamp);
+            sync_info_entry* info = getSyncInfoById(worker->task.pair);
+            int errors_num = processWorkerOutput(worker, info, &rusage, fss_out, log_fd, timestamp);
             
-            // Update the source directory's last_sync_time with the same timestamp, but without brackets
-            sync_info_entry* info = getSyncInfo(source);
+            // Update the source directory's last sync time (formatted only when shown)
             if (info) {
-                // Remove the brackets and trailing space: "[2025-01-01 12:30:45] " -> "2025-01-01 12:30:45"
-                char* clean_timestamp = NULL;
-                size_t ts_len = strlen(timestamp);
-                if (ts_len > 3) {
-                    clean_timestamp = (char*)malloc(ts_len);
-                    if (clean_timestamp) {
-                        strncpy(clean_timestamp, timestamp + 1, ts_len - 3);
-                        clean_timestamp[ts_len - 3] = '\0';
-                        
-                        // Free old timestamp and set new one
-                        free(info->last_sync_time);
-                        info->last_sync_time = clean_timestamp;
-                    }
-                }
-                
+                info->last_sync = sync_time;
                 info->error_count += errors_num;
+                markStateDirty(info);
             }
             
-            // Free timestamp
-            free(timestamp);
-            
-            // Close the pipe
-            close(active_workers[worker_index].pipe_fd);
+            // Close the pipes
+            close(worker->pipe_fd);
+            close(worker->limits_fd);
+            journalTaskDone(worker->task.id);
             
-            // Remove this worker by shifting the array
-            for (int j = worker_index; j < worker_count - 1; j++) {
-                // Copy task data with proper memory allocation
-                copyTask(&active_workers[j].task, &active_workers[j+1].task);
-                active_workers[j].pid = active_workers[j + 1].pid;
-                active_workers[j].pipe_fd = active_workers[j + 1].pipe_fd;
-            }
-
-            freeTaskMemory(&active_workers[worker_count - 1].task);      
-            worker_count--;
+            // Free the slot (the last running worker takes its place in the order)
+            freeTaskMemory(&worker->task);
+            if (worker->target_dir) freeTaskName(worker->target_dir, worker->target_class);
+            releaseWorkerSlot(worker);
         }
     }
+
+    // The workers still running get the share of those that finished
+    if (worker_count != running) rebalanceWorkerLimits();
 }
 
-// Wait for all active and queued sync tasks to finish
-void finishTasks(int fss_out, int log_fd) {
-    char* temp_msg = strdup("Waiting for all active workers to finish.\n");
-    if (temp_msg) {
-        temp_msg = addTimestampToMessage(temp_msg, NULL);
-        if (temp_msg) {
-            forwardMessage(temp_msg, fss_out, log_fd);
-        }
-        free(temp_msg);
+// Set bytes/s and files/s limits of a pair (or global limits if entry is NULL), 0 = unlimited
+void setThrottleLimits(sync_info_entry* entry, long long bps, long long fps) {
+    if (entry) {
+        entry->limit_bps = bps;
+        entry->limit_fps = fps;
+        setTokenBucketRate(&entry->fps_bucket, fps);
+    } else {
+        settings.global_bps = bps;
+        settings.global_fps = fps;
+        setTokenBucketRate(&global_fps_bucket, fps);
     }
+    rebalanceWorkerLimits();    // Running workers get their share of the new limits
+}
+
+// Wait for the active workers to terminate (queued tasks are not started)
+void finishActiveTasks(int fss_out, int log_fd) {
+    releaseStaggeredSyncs(true);    // Into the queue like every other task
+
+    str_builder msg;
+    startMessage(&msg);
+    sbAppend(&msg, "Waiting for all active workers to finish.\n");
+    forwardMessage(sbString(&msg), fss_out, log_fd);
+    sbFree(&msg);
     
-    // Finish active tasks
+    // Finish active tasks (reading their output, so none blocks on a full pipe)
     while (worker_count > 0) {
+        readWorkerOutput();
         processFinishedWorker(fss_out, log_fd);
         
         // If there are still workers, wait a bit
@@ -466,23 +914,31 @@ void finishTasks(int fss_out, int log_fd) {
             usleep(100000);  // 100ms
         }
     }
+}
+
+// Wait for all active and queued sync tasks to finish
+void finishTasks(int fss_out, int log_fd) {
+    finishActiveTasks(fss_out, log_fd);
     
-    temp_msg = strdup("Processing remaining queued tasks.\n");
-    if (temp_msg) {
-        temp_msg = addTimestampToMessage(temp_msg, NULL);
-        if (temp_msg) {
-            forwardMessage(temp_msg, fss_out, log_fd);
-            free(temp_msg);
-        }
-    }
+    str_builder msg;
+    startMessage(&msg);
+    sbAppend(&msg, "Processing remaining queued tasks.\n");
+    forwardMessage(sbString(&msg), fss_out, log_fd);
+    sbFree(&msg);
     
     // Process remaining tasks in the queue
-    while (!task_queue.empty() || worker_count > 0) {
+    while (getQueuedTaskCount() > 0 || worker_count > 0) {
         // Start workers to process queued tasks
         startWorker();
         
-        // Wait for workers to finish their tasks
+        // Everything left is throttled, wait for the files/s limits to allow more tasks
+        if (worker_count == 0 && getQueuedTaskCount() > 0) {
+            usleep(100000);  // 100ms
+        }
+        
+        // Wait for workers to finish their tasks (reading their output, so none blocks on a full pipe)
         while (worker_count > 0) {
+            readWorkerOutput();
             processFinishedWorker(fss_out, log_fd);
             
             if (worker_count > 0) {
@@ -492,21 +948,65 @@ void finishTasks(int fss_out, int log_fd) {
     }
 }
 
+// Returns number of tasks waiting in the queue (including the spilled and staggered ones)
+int getQueuedTaskCount() {
+    return (int)task_queue.size() + getSpilledTaskCount() + (int)staggered_syncs.size();
+}
+
+// Returns number of running workers
+int getActiveWorkerCount() {
+    return worker_count;
+}
+
+// Call callback for every task that is running or queued (running first, then the queue oldest first, then the staggered ones)
+void forEachPendingTask(void (*callback)(const task_t* task, void* arg), void* arg) {
+    for (int i = 0; i < worker_count; i++) {
+        callback(&active_workers[worker_order[i]].task, arg);
+    }
+    for (const task_t& task : task_queue) {
+        callback(&task, arg);
+    }
+    forEachSpilledTask(callback, arg);
+    for (const task_t& task : staggered_syncs) {
+        callback(&task, arg);
+    }
+}
+
 // Free allocated memory for active workers
 void shutdownWorkerManager() {
     if (active_workers) {
         // Free all task memory
         for (int i = 0; i < worker_count; i++) {
-            freeTaskMemory(&active_workers[i].task);
+            int slot = worker_order[i];
+            freeTaskMemory(&active_workers[slot].task);
+            if (active_workers[slot].target_dir) {
+                freeTaskName(active_workers[slot].target_dir, active_workers[slot].target_class);
+            }
+            sbFree(&worker_reports[slot].status);
+            sbFree(&worker_reports[slot].details);
+            sbFree(&worker_reports[slot].errors);
+            sbFree(&worker_reports[slot].line);
         }
         free(active_workers);
+        free(worker_reports);
+        free(worker_order);
         active_workers = NULL;
+        worker_reports = NULL;
+        worker_order = NULL;
+        worker_count = 0;
     }
     
     // Clear any tasks left in the queue
     while (!task_queue.empty()) {
         task_t task = task_queue.front();
         freeTaskMemory(&task);
-        task_queue.pop();
+        task_queue.pop_front();
+    }
+    queue_memory = 0;
+    closeTaskSpill();
+    for (task_t& task : staggered_syncs) {
+        freeTaskMemory(&task);
     }
+    staggered_syncs.clear();
+    releaseTaskPool();
 }
\ No newline at end of file
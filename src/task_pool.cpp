@@ -0,0 +1,83 @@
+#include "../header/task_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Task Pool: Storage for the filenames of queued and running tasks
+
+#define NAME_CLASSES 5              // 16, 32, 64, 128 and 256 byte blocks
+#define NAME_MIN_SHIFT 4            // log2 of the smallest block
+#define NAME_CHUNK (64 * 1024)      // Blocks are carved from chunks of this size
+#define ALLOC_OVERHEAD 16           // Bookkeeping bytes malloc adds to a heap name
+
+static char* free_names[NAME_CLASSES] = {NULL};     // Free blocks, linked through their first bytes
+static std::vector<char*> name_chunks;
+
+///// HELPER FUNCTIONS /////
+
+// Smallest class whose blocks hold size bytes, TASK_NAME_HEAP if none does
+static uint8_t sizeClass(size_t size) {
+    for (uint8_t size_class = 0; size_class < NAME_CLASSES; size_class++) {
+        if (size <= ((size_t)1 << (size_class + NAME_MIN_SHIFT))) return size_class;
+    }
+    return TASK_NAME_HEAP;
+}
+
+// Split a new chunk into free blocks of a class
+static bool growClass(uint8_t size_class) {
+    char* chunk = (char*)malloc(NAME_CHUNK);
+    if (!chunk) return false;
+    name_chunks.push_back(chunk);
+
+    size_t block = (size_t)1 << (size_class + NAME_MIN_SHIFT);
+    for (size_t offset = 0; offset + block <= NAME_CHUNK; offset += block) {
+        *(char**)(chunk + offset) = free_names[size_class];
+        free_names[size_class] = chunk + offset;
+    }
+    return true;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Copy name into a pooled block
+char* allocTaskName(const char* name, size_t length, uint8_t* size_class) {
+    *size_class = sizeClass(length + 1);
+
+    char* block;
+    if (*size_class == TASK_NAME_HEAP) {
+        block = (char*)malloc(length + 1);
+    } else {
+        if (!free_names[*size_class] && !growClass(*size_class)) return NULL;
+        block = free_names[*size_class];
+        free_names[*size_class] = *(char**)block;
+    }
+    if (!block) return NULL;
+
+    memcpy(block, name, length);
+    block[length] = '\0';
+    return block;
+}
+
+// Give a block back to its free list
+void freeTaskName(char* name, uint8_t size_class) {
+    if (!name) return;
+    if (size_class == TASK_NAME_HEAP) {
+        free(name);
+        return;
+    }
+    *(char**)name = free_names[size_class];
+    free_names[size_class] = name;
+}
+
+// Bytes used by a name of this class
+size_t taskNameSize(const char* name, uint8_t size_class) {
+    if (size_class == TASK_NAME_HEAP) return strlen(name) + 1 + ALLOC_OVERHEAD;
+    return (size_t)1 << (size_class + NAME_MIN_SHIFT);
+}
+
+// Free every chunk
+void releaseTaskPool() {
+    for (char* chunk : name_chunks) free(chunk);
+    name_chunks.clear();
+    for (int i = 0; i < NAME_CLASSES; i++) free_names[i] = NULL;
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "../header/task_spill.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+// Task Spill: On-disk segment that holds the tail of the task queue when the in-memory queue is full
+
+// Header of a spilled task, followed by the filename (without '\0')
+// The pair is kept by id, it is not removed while it has tasks (spilled ones included)
+typedef struct {
+    uint64_t id;
+    uint64_t event_ns;
+    uint64_t enqueued_ns;
+    uint32_t pair;
+    uint8_t op;
+    uint16_t name_length;
+} spill_record;
+
+static FILE* spill_writer = NULL;
+static FILE* spill_reader = NULL;
+static bool spill_unflushed = false;   // Writer has data the reader cannot see yet
+static int spilled_count = 0;
+static char spill_file_path[PATH_MAX] = "";
+
+///// HELPER FUNCTIONS /////
+
+// Read one record from a spill file, the filename goes to the task pool
+static bool readSpillRecord(FILE* file, task_t* task) {
+    static char name[UINT16_MAX + 1];
+    spill_record record;
+    if (fread(&record, sizeof(record), 1, file) != 1) return false;
+    if (fread(name, 1, record.name_length, file) != record.name_length) return false;    // File is truncated
+    if (!setTaskFilename(task, name, record.name_length)) return false;
+
+    task->id = record.id;
+    task->pair = record.pair;
+    task->op = (task_op)record.op;
+    task->throttled_since = 0;
+    task->event_ns = record.event_ns;
+    task->enqueued_ns = record.enqueued_ns;
+    return true;
+}
+
+// Make spilled records visible to the readers
+static void flushSpillWriter() {
+    if (spill_unflushed) {
+        fflush(spill_writer);
+        spill_unflushed = false;
+    }
+}
+
+///// MAIN FUNCTIONS /////
+
+// Append a task to the spill file
+bool spillTask(const task_t* task, const char* spill_path) {
+    if (!spill_writer) {
+        strncpy(spill_file_path, spill_path, PATH_MAX - 1);
+        spill_file_path[PATH_MAX - 1] = '\0';
+
+        spill_writer = fopen(spill_file_path, "wb");
+        spill_reader = spill_writer ? fopen(spill_file_path, "rb") : NULL;
+        if (!spill_reader) {
+            perror("Error creating task spill file");
+            closeTaskSpill();
+            return false;
+        }
+    }
+
+    size_t length = strlen(task->filename);
+    if (length > UINT16_MAX) return false;
+
+    spill_record record;
+    memset(&record, 0, sizeof(record));     // No uninitialized padding in the file
+    record.id = task->id;
+    record.event_ns = task->event_ns;
+    record.enqueued_ns = task->enqueued_ns;
+    record.pair = task->pair;
+    record.op = task->op;
+    record.name_length = (uint16_t)length;
+
+    if (fwrite(&record, sizeof(record), 1, spill_writer) != 1) {
+        perror("Error writing task spill file");
+        return false;
+    }
+    fwrite(task->filename, 1, length, spill_writer);
+
+    spill_unflushed = true;
+    spilled_count++;
+    return true;
+}
+
+// Read the oldest spilled task into task
+bool readSpilledTask(task_t* task) {
+    if (spilled_count == 0) return false;
+
+    flushSpillWriter();
+    if (!readSpillRecord(spill_reader, task)) {
+        fprintf(stderr, "Error reading task spill file, dropping %d spilled tasks\n", spilled_count);
+        closeTaskSpill();
+        return false;
+    }
+
+    // Remove the file once it is drained, the next spill starts a new one
+    if (--spilled_count == 0) {
+        closeTaskSpill();
+    }
+    return true;
+}
+
+// Returns number of tasks in the spill file
+int getSpilledTaskCount() {
+    return spilled_count;
+}
+
+// Call callback for every spilled task (oldest first)
+void forEachSpilledTask(void (*callback)(const task_t* task, void* arg), void* arg) {
+    if (spilled_count == 0) return;
+
+    flushSpillWriter();
+    FILE* file = fopen(spill_file_path, "rb");
+    if (!file) return;
+    fseek(file, ftell(spill_reader), SEEK_SET);
+
+    task_t task;
+    for (int i = 0; i < spilled_count && readSpillRecord(file, &task); i++) {
+        callback(&task, arg);
+        freeTaskMemory(&task);
+    }
+    fclose(file);
+}
+
+// Close and remove the spill file
+void closeTaskSpill() {
+    if (spill_writer) fclose(spill_writer);
+    if (spill_reader) fclose(spill_reader);
+    if (spill_file_path[0]) unlink(spill_file_path);
+
+    spill_writer = NULL;
+    spill_reader = NULL;
+    spill_unflushed = false;
+    spilled_count = 0;
+    spill_file_path[0] = '\0';
+}
\ No newline at end of file
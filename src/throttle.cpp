@@ -0,0 +1,85 @@
+#include "../header/throttle.h"
+#include <time.h>
+#include <poll.h>
+
+// Throttle: Token buckets used to limit bytes/s and files/s (shared by the manager and the worker)
+
+///// HELPER FUNCTIONS /////
+
+// Add the tokens produced since the last refill
+static void refillTokenBucket(token_bucket* bucket) {
+    uint64_t now = getMonotonicNs();
+    if (bucket->rate > 0 && now > bucket->last_refill) {
+        bucket->tokens += bucket->rate * (double)(now - bucket->last_refill) / 1e9;
+        if (bucket->tokens > bucket->burst) bucket->tokens = bucket->burst;
+    }
+    bucket->last_refill = now;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Returns monotonic clock time in nanoseconds
+uint64_t getMonotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Initialize bucket with a rate (tokens/s), burst is one second worth of tokens
+void initTokenBucket(token_bucket* bucket, double rate) {
+    bucket->rate = rate > 0 ? rate : 0;
+    bucket->burst = bucket->rate;
+    bucket->tokens = bucket->burst;
+    bucket->last_refill = getMonotonicNs();
+}
+
+// Change rate of an existing bucket (keeps the tokens already stored)
+void setTokenBucketRate(token_bucket* bucket, double rate) {
+    refillTokenBucket(bucket);
+    bucket->rate = rate > 0 ? rate : 0;
+    bucket->burst = bucket->rate;
+    if (bucket->tokens > bucket->burst) bucket->tokens = bucket->burst;
+}
+
+// Take n tokens only if they are available right now
+bool tryConsumeTokens(token_bucket* bucket, double n) {
+    if (bucket->rate <= 0) return true;  // Unlimited
+
+    refillTokenBucket(bucket);
+    if (bucket->tokens < n && bucket->tokens < bucket->burst) return false;
+
+    bucket->tokens -= n;
+    return true;
+}
+
+// Take n tokens without waiting
+void chargeTokens(token_bucket* bucket, double n) {
+    if (bucket->rate <= 0) return;  // Unlimited
+
+    refillTokenBucket(bucket);
+    bucket->tokens -= n;
+}
+
+// Take n tokens and sleep until the debt is paid back, or until wake_fd is readable
+uint64_t consumeTokens(token_bucket* bucket, double n, int wake_fd) {
+    if (bucket->rate <= 0) return 0;  // Unlimited
+
+    refillTokenBucket(bucket);
+    bucket->tokens -= n;
+    if (bucket->tokens >= 0) return 0;
+
+    // Sleep for as long as it takes to produce the missing tokens (a signal only shortens one round)
+    uint64_t start = getMonotonicNs();
+    struct pollfd wake = {wake_fd, POLLIN, 0};     // Ignored by ppoll() if wake_fd is -1
+    while (bucket->tokens < 0) {
+        uint64_t wait_ns = (uint64_t)(-bucket->tokens / bucket->rate * 1e9) + 1;
+        struct timespec timeout;
+        timeout.tv_sec = wait_ns / 1000000000ULL;
+        timeout.tv_nsec = wait_ns % 1000000000ULL;
+        bool woken = ppoll(&wake, 1, &timeout, NULL) > 0;
+        refillTokenBucket(bucket);
+        if (woken) break;
+    }
+
+    return getMonotonicNs() - start;
+}
\ No newline at end of file
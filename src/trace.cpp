@@ -0,0 +1,96 @@
+#include "../header/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Trace: Optional Chrome/Perfetto trace-event JSON of the manager's loop and task lifecycle (@trace_file)
+
+// Buffer of the trace file, spans are written with one fwrite per buffer
+#define TRACE_BUFFER_SIZE (256 * 1024)
+
+bool trace_enabled = false;
+static FILE* trace_file = NULL;
+static int manager_pid = 0;
+static bool first_event = true;
+
+///// HELPER FUNCTIONS /////
+
+// Write a string as a JSON string (with quotes)
+static void writeJsonString(const char* value) {
+    fputc('"', trace_file);
+    for (const unsigned char* c = (const unsigned char*)value; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', trace_file);
+            fputc(*c, trace_file);
+        } else if (*c < 0x20) {
+            fprintf(trace_file, "\\u%04x", *c);
+        } else {
+            fputc(*c, trace_file);
+        }
+    }
+    fputc('"', trace_file);
+}
+
+// Separate events in the JSON array
+static void beginEvent() {
+    if (!first_event) fputs(",\n", trace_file);
+    first_event = false;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Open the trace file and enable tracing
+bool openTrace(const char* path) {
+    trace_file = fopen(path, "w");
+    if (!trace_file) {
+        perror("Error opening trace file");
+        return false;
+    }
+    setvbuf(trace_file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+
+    manager_pid = (int)getpid();
+    first_event = true;
+    trace_enabled = true;
+
+    fputs("[\n", trace_file);
+    traceTrackName(0, "fss_manager");
+    return true;
+}
+
+// Write a complete span (timestamps from getMonotonicNs()), tid 0 = manager track
+void traceSpan(const char* name, const char* category, int tid, uint64_t start_ns, uint64_t end_ns,
+               const char* arg_name, const char* arg_value) {
+    if (!trace_enabled) return;
+
+    beginEvent();
+    fprintf(trace_file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d",
+            name, category, start_ns / 1000.0, end_ns > start_ns ? (end_ns - start_ns) / 1000.0 : 0.0,
+            manager_pid, tid ? tid : manager_pid);
+    if (arg_name) {
+        fprintf(trace_file, ",\"args\":{\"%s\":", arg_name);
+        writeJsonString(arg_value ? arg_value : "");
+        fputc('}', trace_file);
+    }
+    fputc('}', trace_file);
+}
+
+// Name the track of a worker
+void traceTrackName(int tid, const char* name) {
+    if (!trace_enabled) return;
+
+    beginEvent();
+    fprintf(trace_file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+            manager_pid, tid ? tid : manager_pid);
+    writeJsonString(name);
+    fputs("}}", trace_file);
+}
+
+// Finish the JSON array and close the trace file
+void closeTrace() {
+    if (!trace_enabled) return;
+
+    fputs("\n]\n", trace_file);
+    fclose(trace_file);
+    trace_file = NULL;
+    trace_enabled = false;
+}
\ No newline at end of file
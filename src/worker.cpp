@@ -9,9 +9,13 @@
 #include <string.h>
 #include <time.h>
 #include <limits.h>
+#include "../header/throttle.h"
+#include "../header/priority.h"
 
 #define BUFFER_SIZE 4096
 #define ERROR_BUFFER_SIZE 8192
+#define PROGRESS_INTERVAL_NS 1000000000ULL     // Time between PROGRESS lines (1s)
+#define LIMITS_CHECK_INTERVAL_NS 100000000ULL   // Time between checks for new limits while not throttled (100ms)
 
 // Define operation status codes
 #define STATUS_SUCCESS 0
@@ -26,8 +30,106 @@ typedef struct {
     int status;     // Operation status (SUCCESS, PARTIAL, ERROR)
 } operation_stats;
 
+// Limits given by the manager (rate 0 = unlimited)
+token_bucket bytes_bucket;      // Bytes/s limit of the copy loop
+token_bucket files_bucket;      // Files/s limit of FULL/SYNC operations
+uint64_t throttled_ns = 0;      // Time spent sleeping because of the limits
+int limits_fd = -1;             // New limits from the manager, "LIMITS: <bps> <fps>" per line (-1 = fixed limits)
+char limits_line[64];           // Line that continues in the next read
+size_t limits_length = 0;
+uint64_t last_limits_ns = 0;
+long long bytes_copied = 0;     // Bytes written to the target directory
+uint64_t copy_start_ns = 0;     // When the operation started (monotonic clock, compared with the manager's timestamps)
+uint64_t copy_end_ns = 0;       // When the operation finished
+
+// Progress of FULL/SYNC operations, printed as "PROGRESS: <files done> <files total> <bytes done> <bytes total>"
+// while the operation runs, so the manager can show it before the report
+bool progress_enabled = false;
+long long files_done = 0;       // Files copied or skipped
+long long files_total = 0;      // Files in the source directory when the operation started
+long long bytes_total = 0;      // Their size
+uint64_t last_progress_ns = 0;
+
 ///// HELPER FUNCTIONS /////
 
+// Print a progress line if the last one is older than PROGRESS_INTERVAL_NS (or if force is set)
+void reportProgress(bool force) {
+    if (!progress_enabled) return;
+    uint64_t now = getMonotonicNs();
+    if (!force && now - last_progress_ns < PROGRESS_INTERVAL_NS) return;
+    last_progress_ns = now;
+    
+    // stdout is a pipe (fully buffered), the line must reach the manager now
+    printf("PROGRESS: %lld %lld %lld %lld\n", files_done, files_total, bytes_copied, bytes_total);
+    fflush(stdout);
+}
+
+// Apply the limits the manager sent since the last call (without blocking)
+// The manager sends new limits when its workers start and stop, as each worker gets a share of the pair and global limits
+// Returns false if there was nothing to read
+bool readLimitUpdates() {
+    if (limits_fd < 0) return false;
+    
+    char buffer[256];
+    ssize_t bytes_read = read(limits_fd, buffer, sizeof(buffer));
+    if (bytes_read < 0) return false;   // EAGAIN: nothing new
+    if (bytes_read == 0) {
+        limits_fd = -1;     // The manager is gone, keep the last limits
+        return true;
+    }
+    
+    for (ssize_t i = 0; i < bytes_read; i++) {
+        if (buffer[i] != '\n') {
+            if (limits_length < sizeof(limits_line) - 1) limits_line[limits_length++] = buffer[i];
+            continue;
+        }
+        limits_line[limits_length] = '\0';
+        limits_length = 0;
+        double bps, fps;
+        if (sscanf(limits_line, "LIMITS: %lf %lf", &bps, &fps) == 2) {
+            setTokenBucketRate(&bytes_bucket, bps);
+            setTokenBucketRate(&files_bucket, fps);
+        }
+    }
+    return true;
+}
+
+// Take n tokens from a bucket, sleeping while it is in debt (new limits from the manager end the sleep early)
+// Returns the time spent sleeping in nanoseconds
+uint64_t throttle(token_bucket* bucket, double n) {
+    uint64_t now = getMonotonicNs();
+    if (now - last_limits_ns >= LIMITS_CHECK_INTERVAL_NS) {
+        last_limits_ns = now;
+        readLimitUpdates();
+    }
+    
+    uint64_t slept = consumeTokens(bucket, n, limits_fd);
+    while (bucket->rate > 0 && bucket->tokens < 0 && readLimitUpdates()) {
+        slept += consumeTokens(bucket, 0, limits_fd);   // The rest of the debt at the new rate
+    }
+    return slept;
+}
+
+// Count the entries of the source directory and their size (the totals of the progress lines)
+// One stat per entry, cheap next to copying them
+void estimateFullSync(const char* source) {
+    DIR* source_dir = opendir(source);
+    if (source_dir == NULL) return;
+    
+    struct dirent* entry;
+    struct stat file_stat;
+    while ((entry = readdir(source_dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        files_total++;
+        if (fstatat(dirfd(source_dir), entry->d_name, &file_stat, 0) == 0 && S_ISREG(file_stat.st_mode)) {
+            bytes_total += file_stat.st_size;
+        }
+    }
+    
+    closedir(source_dir);
+}
+
 // Function to copy a file from source to target directory
 int copyFile(const char* source, const char* target) {
     int source_fd, target_fd;
@@ -49,12 +151,15 @@ int copyFile(const char* source, const char* target) {
     
     // Copy data
     while ((bytes_read = read(source_fd, buffer, BUFFER_SIZE)) > 0) {
+        throttled_ns += throttle(&bytes_bucket, bytes_read);
         bytes_written = write(target_fd, buffer, bytes_read);
         if (bytes_written != bytes_read) {  // if error
             close(source_fd);
             close(target_fd);
             return -1;
         }
+        bytes_copied += bytes_written;
+        reportProgress(false);  // Large files take long too
     }
     
     // Close file descriptors
@@ -140,6 +245,17 @@ void printReport(operation_stats stats, const char* error_buffer, const char* op
     
     printf("\n");
     
+    // Print time spent throttled (in ms)
+    printf("THROTTLED: %llu\n", (unsigned long long)(throttled_ns / 1000000));
+    
+    // Print amount of data copied (used for the manager's metrics)
+    printf("COPIED: %d\n", stats.copied);
+    printf("BYTES: %lld\n", bytes_copied);
+    
+    // Print start and end of the operation (used for the manager's latency histograms)
+    printf("COPY_START_NS: %llu\n", (unsigned long long)copy_start_ns);
+    printf("COPY_END_NS: %llu\n", (unsigned long long)copy_end_ns);
+    
     // Print errors if any
     if (strlen(error_buffer) > 0) {
         printf("ERRORS:\n%s", error_buffer);
@@ -168,6 +284,11 @@ operation_stats operationFullSync(const char* source, const char* target, char*
     }
     closedir(target_dir);  // Close immediately since we just needed to check existence
 
+    // Totals for the progress lines, then a first line so the manager knows them right away
+    estimateFullSync(source);
+    progress_enabled = true;
+    reportProgress(true);
+
     // Open source directory
     source_dir = opendir(source);
     if (source_dir == NULL) {
@@ -188,6 +309,7 @@ operation_stats operationFullSync(const char* source, const char* target, char*
         snprintf(file_trg_path, PATH_MAX, "%s/%s", target, entry->d_name);
         
         // Copy the file
+        throttled_ns += throttle(&files_bucket, 1);
         if (copyFile(file_src_path, file_trg_path) == 0) {
             stats.copied++;
         } else {
@@ -195,6 +317,8 @@ operation_stats operationFullSync(const char* source, const char* target, char*
             sprintf(error_buffer + strlen(error_buffer), 
                     "- File: %s - %s\n", entry->d_name, strerror(errno));
         }
+        files_done++;
+        reportProgress(false);
     }
     
     closedir(source_dir);
@@ -294,7 +418,7 @@ operation_stats operationDelete(const char* target, const char* filename, char*
 
 int main(int argc, char* argv[]) {
     if (argc < 5) {
-        fprintf(stderr, "Usage: %s <source_dir> <target_dir> <filename> <operation>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <source_dir> <target_dir> <filename> <operation> [bps=N] [fps=N] [limits_fd=N] [nice=N] [ioprio=C:L] [cpus=L]\n", argv[0]);
         return 1;
     }
     
@@ -303,12 +427,32 @@ int main(int argc, char* argv[]) {
     char* filename = argv[3];
     char* operation = argv[4];
     
+    // Optional limits and priority
+    double bps = 0, fps = 0;
+    worker_priority priority = {};
+    for (int i = 5; i < argc; i++) {
+        if (strncmp(argv[i], "bps=", 4) == 0) {
+            bps = atof(argv[i] + 4);
+        } else if (strncmp(argv[i], "fps=", 4) == 0) {
+            fps = atof(argv[i] + 4);
+        } else if (strncmp(argv[i], "limits_fd=", 10) == 0) {
+            limits_fd = atoi(argv[i] + 10);
+            fcntl(limits_fd, F_SETFL, fcntl(limits_fd, F_GETFL, 0) | O_NONBLOCK);
+        } else if (!parsePriorityArg(&priority, argv[i])) {
+            fprintf(stderr, "Worker: ignoring invalid argument %s\n", argv[i]);
+        }
+    }
+    initTokenBucket(&bytes_bucket, bps);
+    initTokenBucket(&files_bucket, fps);
+    applyPriority(&priority);
+    
     // Buffer to store error messages
     char error_buffer[ERROR_BUFFER_SIZE] = "";
     
     operation_stats stats;
     
     // Perform operation
+    copy_start_ns = getMonotonicNs();
     if (strcmp(operation, "FULL") == 0 || strcmp(operation, "SYNC") == 0) {
         stats = operationFullSync(source_dir, target_dir, error_buffer);
     } else if (strcmp(operation, "ADDED") == 0 || strcmp(operation, "MODIFIED") == 0) {
@@ -320,6 +464,8 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    copy_end_ns = getMonotonicNs();
+    
     // Generate and send report
     printReport(stats, error_buffer, operation, filename);
     
@@ -0,0 +1,85 @@
+#include "../header/worker_launch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <spawn.h>
+
+// Worker Launch: Starts worker processes with their stdin and stdout connected to pipes
+
+#define FALLBACK_WORKER_PATH "./bin/worker"
+
+extern char** environ;
+
+static char worker_path[PATH_MAX] = "";
+
+///// HELPER FUNCTIONS /////
+
+// Path of the worker in the directory of the running binary, false if it is not executable
+static bool workerNextToExe(char* path) {
+    ssize_t length = readlink("/proc/self/exe", path, PATH_MAX - 1);
+    if (length <= 0) return false;
+    path[length] = '\0';
+
+    char* slash = strrchr(path, '/');
+    if (!slash || (slash - path) + sizeof("/worker") > PATH_MAX) return false;
+    strcpy(slash + 1, "worker");
+    return access(path, X_OK) == 0;
+}
+
+// posix_spawn with stdin_fd as stdin and stdout_fd as stdout
+static pid_t spawnWorker(const char* path, char* const args[], int stdin_fd, int stdout_fd) {
+    posix_spawn_file_actions_t actions;
+    int result = posix_spawn_file_actions_init(&actions);
+    if (result == 0) {
+        result = posix_spawn_file_actions_adddup2(&actions, stdin_fd, STDIN_FILENO);
+        if (result == 0) result = posix_spawn_file_actions_adddup2(&actions, stdout_fd, STDOUT_FILENO);
+        pid_t pid;
+        if (result == 0) result = posix_spawn(&pid, path, &actions, NULL, args, environ);
+        posix_spawn_file_actions_destroy(&actions);
+        if (result == 0) return pid;
+    }
+    errno = result;     // posix_spawn returns the error instead of setting errno
+    return -1;
+}
+
+// fork + execv with stdin_fd as stdin and stdout_fd as stdout
+static pid_t forkWorker(const char* path, char* const args[], int stdin_fd, int stdout_fd) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(stdin_fd, STDIN_FILENO);
+        dup2(stdout_fd, STDOUT_FILENO);
+        execv(path, args);
+        
+        // If execv fails, report it and exit. The manager has threads (log flusher), so only async-signal-safe
+        // calls are allowed here: write() instead of stdio, _exit() so its buffers are not flushed a second time
+        static const char message[] = "execv failed: ";
+        ssize_t ignored = write(STDERR_FILENO, message, sizeof(message) - 1);
+        ignored = write(STDERR_FILENO, path, strlen(path));
+        ignored = write(STDERR_FILENO, "\n", 1);
+        (void)ignored;
+        _exit(1);
+    }
+    return pid;
+}
+
+///// MAIN FUNCTIONS /////
+
+// Absolute path of the worker executable
+const char* resolveWorkerPath() {
+    if (worker_path[0]) return worker_path;
+
+    if (!workerNextToExe(worker_path) && !realpath(FALLBACK_WORKER_PATH, worker_path)) {
+        strcpy(worker_path, FALLBACK_WORKER_PATH);
+        fprintf(stderr, "Worker executable not found next to the manager, using %s\n", worker_path);
+    }
+    return worker_path;
+}
+
+// Start path with args, stdin_fd becomes the child's stdin and stdout_fd its stdout
+pid_t launchWorker(const char* path, char* const args[], int stdin_fd, int stdout_fd, spawn_method method) {
+    if (method == SPAWN_FORK) return forkWorker(path, args, stdin_fd, stdout_fd);
+    return spawnWorker(path, args, stdin_fd, stdout_fd);
+}
\ No newline at end of file